@@ -11,6 +11,11 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec3 aTangent;
 
+// Packed format (TerrainVertexFormat::Packed): grid coordinate, 16-bit height, octahedral normal
+layout (location = 4) in vec2 aGridPos;
+layout (location = 5) in float aGridHeight;
+layout (location = 6) in vec2 aOctNormal;
+
 out vec3 vViewPos;
 out vec3 vViewNormal;
 
@@ -18,13 +23,39 @@ uniform mat4 uModel;
 uniform mat4 uView;
 uniform mat4 uProjection;
 
+uniform bool uPackedVertices;
+uniform vec2 uPackedOrigin;
+uniform float uPackedCellSize;
+uniform float uPackedHeightScale;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if (n.y < 0.0)
+    {
+        n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
 void main()
 {
-    vec4 viewPos = uView * uModel * vec4(aPos, 1.0);
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    if (uPackedVertices)
+    {
+        position = vec3(uPackedOrigin.x + aGridPos.x * uPackedCellSize,
+                        aGridHeight * uPackedHeightScale,
+                        uPackedOrigin.y + aGridPos.y * uPackedCellSize);
+        normal = decodeOctahedral(aOctNormal);
+    }
+    
+    vec4 viewPos = uView * uModel * vec4(position, 1.0);
     vViewPos = viewPos.xyz;
     
     mat3 normalMatrix = transpose(inverse(mat3(uView * uModel)));
-    vViewNormal = normalize(normalMatrix * aNormal);
+    vViewNormal = normalize(normalMatrix * normal);
     
     gl_Position = uProjection * viewPos;
 }
@@ -11,6 +11,11 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec3 aTangent;
 
+// Packed format (TerrainVertexFormat::Packed): grid coordinate, 16-bit height, octahedral normal
+layout (location = 4) in vec2 aGridPos;
+layout (location = 5) in float aGridHeight;
+layout (location = 6) in vec2 aOctNormal;
+
 out vec3 vWorldPos;
 out vec3 vNormal;
 out vec2 vTexCoord;
@@ -22,14 +27,45 @@ uniform mat4 uView;
 uniform mat4 uProjection;
 uniform vec4 uClipPlane;
 
+uniform bool uPackedVertices;
+uniform vec2 uPackedOrigin;
+uniform float uPackedCellSize;
+uniform float uPackedHeightScale;
+uniform vec2 uPackedUVScale;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if (n.y < 0.0)
+    {
+        n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
 void main()
 {
-    vec4 worldPos = uModel * vec4(aPos, 1.0);
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    vec2 texCoord = aTexCoord;
+    vec3 tangent = aTangent;
+    if (uPackedVertices)
+    {
+        position = vec3(uPackedOrigin.x + aGridPos.x * uPackedCellSize,
+                        aGridHeight * uPackedHeightScale,
+                        uPackedOrigin.y + aGridPos.y * uPackedCellSize);
+        normal = decodeOctahedral(aOctNormal);
+        texCoord = aGridPos * uPackedUVScale;
+        tangent = vec3(1.0, 0.0, 0.0); // orthogonalized against N below
+    }
+    
+    vec4 worldPos = uModel * vec4(position, 1.0);
     vWorldPos = worldPos.xyz;
     
     mat3 normalMatrix = mat3(transpose(inverse(uModel)));
-    vec3 N = normalize(normalMatrix * aNormal);
-    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 N = normalize(normalMatrix * normal);
+    vec3 T = normalize(normalMatrix * tangent);
     
     // Re-orthogonalize T with respect to N (Gram-Schmidt)
     T = normalize(T - dot(T, N) * N);
@@ -39,8 +75,8 @@ void main()
     
     vTBN = mat3(T, B, N);
     vNormal = N;
-    vTexCoord = aTexCoord;
-    vHeight = aPos.y;
+    vTexCoord = texCoord;
+    vHeight = position.y;
     
     // Clip plane for water reflection/refraction
     gl_ClipDistance[0] = dot(worldPos, uClipPlane);
@@ -1,6 +1,9 @@
 #include "RoamingApp.h"
 #include "imgui.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <fstream>
+#include <string>
 
 RoamingApp::RoamingApp()
     : Application(1920, 1080, "OpenGL Terrain Roaming System")
@@ -21,6 +24,8 @@ RoamingApp::RoamingApp()
     , m_time(0.0f)
     , m_groundWalkMode(false)
     , m_playerHeight(1.8f)
+    , m_sculptEnabled(false)
+    , m_sculpting(false)
     , m_enableFog(true)
     , m_fogDensity(0.003f)
     , m_enableSSAO(true)
@@ -45,8 +50,10 @@ void RoamingApp::onInit()
     // Load terrain shader
     m_terrainShader.load("shaders/terrain.vert", "shaders/terrain.frag");
 
-    // Generate terrain from heightmap
-    if (!m_terrain.generate("assets/heightmaps/heightmap.png", m_terrainSize, m_terrainMaxHeight))
+    // Generate terrain from heightmap, preferring a converted tiled file (mapped, no decode)
+    std::string heightmapPath = std::ifstream("assets/heightmaps/heightmap.rhm").good()
+        ? "assets/heightmaps/heightmap.rhm" : "assets/heightmaps/heightmap.png";
+    if (!m_terrain.generate(heightmapPath, m_terrainSize, m_terrainMaxHeight))
     {
         std::cout << "Heightmap not found, trying smaller test heightmap..." << std::endl;
         if (!m_terrain.generate("assets/heightmaps/test.png", m_terrainSize, m_terrainMaxHeight))
@@ -145,6 +152,27 @@ void RoamingApp::onUpdate(float deltaTime)
     // Update light direction from lighting system
     m_lightDir = -m_lighting.getSunDirection();
     
+    // Background rebuilds and streamed chunks finished on worker threads are uploaded here
+    m_terrain.update();
+    
+    // Sculpt at the crosshair while the left mouse button is held (camera mode only)
+    bool sculpting = m_sculptEnabled && !isCursorEnabled() && !m_terrain.isRebuilding() &&
+                     isMouseButtonPressed(GLFW_MOUSE_BUTTON_LEFT);
+    if (sculpting && m_terrain.isGenerated())
+    {
+        TerrainRayHit hit;
+        if (m_terrain.raycast(m_camera.Position, m_camera.Front, 10000.0f, hit))
+        {
+            // Flatten levels towards the height under the crosshair when the stroke started
+            if (!m_sculpting)
+            {
+                m_brush.targetHeight = hit.position.y;
+            }
+            m_terrain.sculpt(hit.position, m_brush, deltaTime);
+        }
+    }
+    m_sculpting = sculpting;
+    
     // Ground walk mode: constrain camera to terrain surface
     if (m_groundWalkMode && m_terrain.isGenerated())
     {
@@ -251,7 +279,7 @@ void RoamingApp::renderScene(const glm::mat4& view, const glm::mat4& projection,
         m_terrainShader.setVec4("uClipPlane", clipPlane);
         
         // Terrain parameters
-        m_terrainShader.setFloat("uMaxHeight", m_terrainMaxHeight);
+        m_terrainShader.setFloat("uMaxHeight", m_terrain.getMaxHeight());
         m_terrainShader.setFloat("uTextureTiling", m_textureTiling);
         m_terrainShader.setVec3("uLightDir", m_lightDir);
         m_terrainShader.setFloat("uGrassMaxHeight", m_grassMaxHeight);
@@ -309,8 +337,9 @@ void RoamingApp::renderScene(const glm::mat4& view, const glm::mat4& projection,
         }
         
         glm::mat4 vp = projection * view;
+        m_terrain.setClipPlane(clipPlane);
         m_terrain.render(m_terrainShader, m_camera.Position, vp);
-        m_drawCalls += m_terrain.getVisibleChunks();
+        m_drawCalls += m_terrain.getDrawCalls();
     }
 
     // Render reference cube
@@ -322,7 +351,7 @@ void RoamingApp::renderScene(const glm::mat4& view, const glm::mat4& projection,
         m_cubeShader.setMat4("uProjection", projection);
         m_cubeShader.setMat4("uView", view);
         
-        glm::mat4 cubeModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, m_terrainMaxHeight + 5.0f, 0.0f));
+        glm::mat4 cubeModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, m_terrain.getMaxHeight() + 5.0f, 0.0f));
         cubeModel = glm::scale(cubeModel, glm::vec3(5.0f));
         m_cubeShader.setMat4("uModel", cubeModel);
         m_cubeShader.setBool("uUseTexture", false);
@@ -347,6 +376,7 @@ void RoamingApp::onRender()
         1000.0f
     );
     glm::mat4 view = m_camera.GetViewMatrix();
+    m_terrain.setViewParameters(glm::radians(m_camera.Zoom), getHeight());
 
     // SSAO Pass: Render G-Buffer and calculate SSAO
     if (m_enableSSAO && m_ssao.isInitialized())
@@ -372,6 +402,7 @@ void RoamingApp::onRender()
             m_gbufferShader.setMat4("uModel", model);
             
             glm::mat4 vp = projection * view;
+            m_terrain.setClipPlane(glm::vec4(0.0f));
             m_terrain.render(m_gbufferShader, m_camera.Position, vp);
         }
         
@@ -403,17 +434,20 @@ void RoamingApp::onRender()
         glm::mat4 reflectedView = reflectedCamera.GetViewMatrix();
         
         // Clip everything below water surface
+        m_terrain.setViewParameters(glm::radians(m_camera.Zoom), m_waterFBOs.getReflectionHeight());
         renderScene(reflectedView, projection, glm::vec4(0.0f, 1.0f, 0.0f, -m_waterHeight + 0.1f));
 
         // 2. Render refraction (normal view, clip above water)
         m_waterFBOs.bindRefractionFBO();
         
         // Clip everything above water surface
+        m_terrain.setViewParameters(glm::radians(m_camera.Zoom), m_waterFBOs.getRefractionHeight());
         renderScene(view, projection, glm::vec4(0.0f, -1.0f, 0.0f, m_waterHeight + 0.1f));
 
         // 3. Unbind FBOs and render normal scene
         m_waterFBOs.unbind(getWidth(), getHeight());
         glDisable(GL_CLIP_DISTANCE0);
+        m_terrain.setViewParameters(glm::radians(m_camera.Zoom), getHeight());
     }
 
     // Clear the default framebuffer
@@ -447,9 +481,30 @@ void RoamingApp::onImGui()
     if (m_terrain.isGenerated())
     {
         ImGui::Text("Chunks: %d / %d visible", m_terrain.getVisibleChunks(), m_terrain.getTotalChunks());
-        ImGui::Text("Culled: %d (%.1f%%)", m_terrain.getCulledChunks(), 
-            m_terrain.getTotalChunks() > 0 ? 100.0f * m_terrain.getCulledChunks() / m_terrain.getTotalChunks() : 0.0f);
+        // getCulledChunks() also counts the occluded chunks; the GPU path's counters may lag a frame
+        int frustumCulled = std::max(0, m_terrain.getCulledChunks() - m_terrain.getOccludedChunks());
+        ImGui::Text("Frustum Culled: %d (%.1f%%)", frustumCulled, 
+            m_terrain.getTotalChunks() > 0 ? 100.0f * frustumCulled / m_terrain.getTotalChunks() : 0.0f);
+        ImGui::Text("Occluded: %d", m_terrain.getOccludedChunks());
         ImGui::Text("Triangles: %d", m_terrain.getTriangleCount());
+        ImGui::Text("Nodes Tested: %d (%d plane tests)", m_terrain.getTestedNodes(), m_terrain.getPlaneTests());
+        if (m_terrain.getChunkedTerrain().isStreaming())
+        {
+            const TerrainStreamer& streamer = m_terrain.getChunkedTerrain().getStreamer();
+            ImGui::Text("Streamed: %d chunks, %.1f MB", streamer.getResidentCount(),
+                streamer.getResidentBytes() / (1024.0f * 1024.0f));
+            ImGui::Text("Building: %d, Evicted: %d", streamer.getBuildingCount(), streamer.getEvictionCount());
+        }
+        ImGui::Text("Normals: per chunk (%s)", m_terrain.getNormalPathName());
+        ImGui::Text("Mesh Build: %.1f ms, Upload: %.1f ms%s",
+            m_terrain.getBuildTimeMs(), m_terrain.getUploadTimeMs(),
+            m_terrain.getChunkedTerrain().isMeshCacheHit() ? " (cached)" : "");
+        ImGui::Text("Vertex Memory: %.1f KB", m_terrain.getVertexMemoryBytes() / 1024.0f);
+        ImGui::Text("Index Memory: %.1f KB", m_terrain.getIndexMemoryBytes() / 1024.0f);
+        ImGui::Text("Vertex Cache ACMR: %.2f -> %.2f", m_terrain.getChunkedTerrain().getUnoptimizedACMR(),
+            m_terrain.getChunkedTerrain().getACMR());
+        ImGui::Text("Heightmap Memory: %.1f KB (%s)", m_terrain.getHeightmapMemoryBytes() / 1024.0f,
+            m_terrain.getChunkedTerrain().getHeightStorageName());
     }
     ImGui::Text("Draw Calls: %d", m_drawCalls);
     
@@ -472,6 +527,13 @@ void RoamingApp::onImGui()
             float terrainHeight = m_terrain.getHeightAt(m_camera.Position.x, m_camera.Position.z);
             ImGui::Text("Terrain Height: %.2f", terrainHeight);
             ImGui::Text("Height Above Terrain: %.2f", m_camera.Position.y - terrainHeight);
+            
+            TerrainRayHit hit;
+            if (m_terrain.raycast(m_camera.Position, m_camera.Front, 10000.0f, hit))
+            {
+                ImGui::Text("Looking At: (%.1f, %.1f, %.1f), %.1f m",
+                    hit.position.x, hit.position.y, hit.position.z, hit.distance);
+            }
         }
         
         ImGui::Checkbox("Ground Walk Mode", &m_groundWalkMode);
@@ -491,8 +553,78 @@ void RoamingApp::onImGui()
             ImGui::Text("Grid: %dx%d", m_terrain.getGridWidth(), m_terrain.getGridHeight());
             ImGui::Text("World Size: %.0f x %.0f", m_terrain.getSize(), m_terrain.getSize());
             
+            // Rebuilt in the background; the current terrain renders until the new one is uploaded
+            ImGui::SliderFloat("Terrain Size", &m_terrainSize, 64.0f, 4096.0f);
+            ImGui::SliderFloat("Terrain Max Height", &m_terrainMaxHeight, 5.0f, 500.0f);
+            if (ImGui::Button("Rebuild Terrain"))
+            {
+                m_terrain.generateAsync(m_terrain.getChunkedTerrain().getHeightmapPath(), m_terrainSize, m_terrainMaxHeight);
+            }
+            if (m_terrain.isRebuilding())
+            {
+                ImGui::SameLine();
+                ImGui::Text("Rebuilding... %.0f%%", m_terrain.getRebuildProgress() * 100.0f);
+            }
+            
             ImGui::Checkbox("Wireframe Mode", &m_wireframeMode);
             ImGui::Checkbox("Show Reference Cube", &m_showCube);
+            if (ImGui::Checkbox("Packed Vertex Format", &m_terrain.getChunkedTerrain().m_usePackedVertices))
+            {
+                m_terrain.regenerateAsync();
+            }
+            if (ImGui::Checkbox("SIMD Normals", &m_terrain.getChunkedTerrain().m_enableSIMD))
+            {
+                m_terrain.regenerateAsync();
+            }
+            const char* heightStorages[] = { "8-bit", "16-bit", "Float" };
+            int heightStorage = static_cast<int>(m_terrain.getChunkedTerrain().m_heightStorage);
+            if (ImGui::Combo("Height Storage", &heightStorage, heightStorages, IM_ARRAYSIZE(heightStorages)))
+            {
+                m_terrain.getChunkedTerrain().m_heightStorage = static_cast<HeightStorage>(heightStorage);
+                m_terrain.regenerateAsync();
+            }
+            if (ImGui::Checkbox("Quadtree", &m_terrain.getChunkedTerrain().m_useQuadtree))
+            {
+                m_terrain.regenerateAsync();
+            }
+            if (ImGui::Checkbox("Optimize Vertex Cache", &m_terrain.getChunkedTerrain().m_optimizeVertexCache))
+            {
+                m_terrain.regenerateAsync();
+            }
+            ImGui::Checkbox("Mesh Cache", &m_terrain.getChunkedTerrain().m_enableMeshCache);
+            if (ImGui::Checkbox("Multi-Draw Indirect", &m_terrain.getChunkedTerrain().m_useMultiDrawIndirect))
+            {
+                m_terrain.regenerateAsync();
+            }
+            if (ImGui::Checkbox("Streaming", &m_terrain.getChunkedTerrain().m_enableStreaming))
+            {
+                m_terrain.regenerateAsync();
+            }
+            if (m_terrain.getChunkedTerrain().m_enableStreaming)
+            {
+                ImGui::SliderInt("Memory Budget (MB)", &m_terrain.getChunkedTerrain().m_streamingBudgetMB, 16, 2048);
+            }
+            
+            ImGui::Separator();
+            ImGui::Text("Sculpt");
+            ImGui::Checkbox("Enable Sculpting", &m_sculptEnabled);
+            if (m_sculptEnabled)
+            {
+                const char* brushModes[] = { "Raise", "Lower", "Smooth", "Flatten" };
+                int brushMode = static_cast<int>(m_brush.mode);
+                if (ImGui::Combo("Brush", &brushMode, brushModes, IM_ARRAYSIZE(brushModes)))
+                {
+                    m_brush.mode = static_cast<TerrainBrushMode>(brushMode);
+                }
+                ImGui::SliderFloat("Brush Radius", &m_brush.radius, 1.0f, 128.0f);
+                ImGui::SliderFloat("Brush Strength", &m_brush.strength, 0.1f, 50.0f);
+                ImGui::SliderFloat("Brush Falloff", &m_brush.falloff, 0.0f, 1.0f);
+                ImGui::Text("Hold LMB in camera mode to sculpt");
+                ImGui::TextDisabled("Edits are kept in memory only; regenerating discards them");
+                ImGui::Text("Last Stroke: %.2f ms, %d meshes",
+                    m_terrain.getChunkedTerrain().getSculptTimeMs(),
+                    m_terrain.getChunkedTerrain().getSculptedMeshes());
+            }
             
             ImGui::Separator();
             ImGui::Text("Texturing");
@@ -517,13 +649,55 @@ void RoamingApp::onImGui()
             ImGui::Text("LOD & Culling");
             auto& ct = m_terrain.getChunkedTerrain();
             ImGui::Checkbox("Enable Frustum Culling", &ct.m_enableFrustumCulling);
+            ImGui::Checkbox("Horizon Culling", &ct.m_enableHorizonCulling);
+            if (ct.m_enableHorizonCulling && (ct.m_useQuadtree || ct.isGPUCulling()))
+            {
+                ImGui::TextDisabled("CPU chunk path only, no Quadtree or GPU Culling");
+            }
+            ImGui::Checkbox("GPU Culling", &ct.m_enableGPUCulling);
+            if (ct.m_enableGPUCulling)
+            {
+                ImGui::Checkbox("Verify Against CPU", &ct.m_verifyGPUCulling);
+                ImGui::Checkbox("Hi-Z Occlusion", &ct.m_enableHiZCulling);
+                if (ct.m_enableHiZCulling)
+                {
+                    ImGui::SliderFloat("Occluder Distance (chunks)", &ct.m_occluderDistance, 0.5f, 8.0f, "%.1f");
+                }
+                if (!ct.isGPUCulling())
+                {
+                    ImGui::TextDisabled("Needs Multi-Draw Indirect, no Quadtree or Streaming");
+                }
+                else if (ct.m_verifyGPUCulling)
+                {
+                    ImGui::Text("Mismatched Passes: %d", ct.getGPUCullingMismatches());
+                }
+            }
             ImGui::Checkbox("Enable LOD", &ct.m_enableLOD);
             if (ct.m_enableLOD)
             {
-                ImGui::SliderFloat("LOD0 Distance", &ct.m_lodDistances[0], 50.0f, 200.0f);
-                ImGui::SliderFloat("LOD1 Distance", &ct.m_lodDistances[1], 100.0f, 400.0f);
-                ImGui::SliderFloat("LOD2 Distance", &ct.m_lodDistances[2], 200.0f, 600.0f);
-                ImGui::SliderFloat("LOD3 Distance", &ct.m_lodDistances[3], 400.0f, 1000.0f);
+                const char* seamModes[] = { "None", "Stitch", "Skirt" };
+                int seamMode = static_cast<int>(ct.m_seamMode);
+                if (ImGui::Combo("LOD Seams", &seamMode, seamModes, IM_ARRAYSIZE(seamModes)))
+                {
+                    ct.m_seamMode = static_cast<TerrainSeamMode>(seamMode);
+                    // Other modes leave skirt vertices out of the meshes
+                    if (ct.m_seamMode == TerrainSeamMode::Skirt && !ct.hasSkirts())
+                    {
+                        m_terrain.regenerateAsync();
+                    }
+                }
+                ImGui::Checkbox("Screen-Space Error", &ct.m_useScreenSpaceError);
+                if (ct.m_useScreenSpaceError)
+                {
+                    ImGui::SliderFloat("Pixel Error", &ct.m_pixelErrorThreshold, 0.5f, 16.0f);
+                }
+                else
+                {
+                    ImGui::SliderFloat("LOD0 Distance", &ct.m_lodDistances[0], 10.0f, 200.0f);
+                    ImGui::SliderFloat("LOD1 Distance", &ct.m_lodDistances[1], 20.0f, 400.0f);
+                    ImGui::SliderFloat("LOD2 Distance", &ct.m_lodDistances[2], 40.0f, 600.0f);
+                    ImGui::SliderFloat("LOD3 Distance", &ct.m_lodDistances[3], 80.0f, 1000.0f);
+                }
             }
         }
         else
@@ -531,6 +705,7 @@ void RoamingApp::onImGui()
             ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "No terrain loaded!");
             ImGui::Text("Add heightmap to:");
             ImGui::BulletText("assets/heightmaps/heightmap.png");
+            ImGui::BulletText("or heightmap.rhm (HeightmapConverter)");
         }
     }
     
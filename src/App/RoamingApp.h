@@ -77,6 +77,10 @@ private:
     bool m_groundWalkMode;
     float m_playerHeight;
     
+    bool m_sculptEnabled;
+    bool m_sculpting;
+    TerrainBrush m_brush;
+    
     bool m_enableFog;
     float m_fogDensity;
     
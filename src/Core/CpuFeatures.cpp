@@ -0,0 +1,69 @@
+/**
+ * @file CpuFeatures.cpp
+ * @brief Runtime CPU instruction set detection
+ * @author LuNingfang
+ */
+
+#include "CpuFeatures.h"
+
+#if defined(ROAMING_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    CpuFeatures detect()
+    {
+        CpuFeatures features = { false, false };
+
+#if defined(ROAMING_SIMD_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        features.sse2 = (info[3] & (1 << 26)) != 0;
+        bool fma = (info[2] & (1 << 12)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+
+        if (maxLeaf >= 7 && osxsave && avx && fma)
+        {
+            // XMM and YMM state must be enabled by the OS
+            bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            features.avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+        }
+#elif defined(ROAMING_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        features.sse2 = __builtin_cpu_supports("sse2") != 0;
+        features.avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+
+        return features;
+    }
+}
+
+const CpuFeatures& CpuFeatures::get()
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+SimdPath CpuFeatures::getBestPath() const
+{
+    if (avx2) return SimdPath::AVX2;
+    if (sse2) return SimdPath::SSE2;
+    return SimdPath::Scalar;
+}
+
+const char* CpuFeatures::getPathName(SimdPath path)
+{
+    switch (path)
+    {
+    case SimdPath::AVX2: return "AVX2";
+    case SimdPath::SSE2: return "SSE2";
+    default:             return "Scalar";
+    }
+}
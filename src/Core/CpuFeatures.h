@@ -0,0 +1,43 @@
+/**
+ * @file CpuFeatures.h
+ * @brief Runtime CPU instruction set detection for SIMD code paths
+ * @author LuNingfang
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ROAMING_SIMD_X86 1
+#endif
+
+// Functions using AVX2/FMA intrinsics are compiled for that target on GCC/Clang;
+// MSVC accepts the intrinsics without a per-function attribute
+#if defined(ROAMING_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ROAMING_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define ROAMING_TARGET_AVX2
+#endif
+
+// SIMD code paths, ordered by width
+enum class SimdPath
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+struct CpuFeatures
+{
+    bool sse2;
+    bool avx2;   // AVX2 + FMA with OS support for YMM state
+
+    static const CpuFeatures& get();
+
+    // Widest SIMD path available
+    SimdPath getBestPath() const;
+    // "AVX2", "SSE2" or "Scalar"
+    static const char* getPathName(SimdPath path);
+};
+
+#endif
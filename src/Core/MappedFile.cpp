@@ -0,0 +1,103 @@
+/**
+ * @file MappedFile.cpp
+ * @brief Memory-mapped file implementation (Win32 file mappings / POSIX mmap)
+ * @author LuNingfang
+ */
+
+#include "MappedFile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+#else
+    , m_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    LARGE_INTEGER size;
+    if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+    {
+        std::cerr << "ERROR::MAPPED_FILE::FAILED_TO_OPEN: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        std::cerr << "ERROR::MAPPED_FILE::FAILED_TO_MAP: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (m_fd < 0 || fstat(m_fd, &info) != 0 || info.st_size == 0)
+    {
+        std::cerr << "ERROR::MAPPED_FILE::FAILED_TO_OPEN: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (view == MAP_FAILED)
+    {
+        std::cerr << "ERROR::MAPPED_FILE::FAILED_TO_MAP: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>(info.st_size);
+#endif
+
+    m_data = static_cast<const uint8_t*>(view);
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file MappedFile.h
+ * @brief Read-only memory-mapped file
+ * @author LuNingfang
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Map the whole file read-only; pages are loaded by the OS on first access
+     */
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* getData() const { return m_data; }
+    size_t getSize() const { return m_size; }
+    bool isOpen() const { return m_data != nullptr; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+
+#ifdef _WIN32
+    void* m_file;       // HANDLE
+    void* m_mapping;    // HANDLE
+#else
+    int m_fd;
+#endif
+};
+
+#endif
@@ -5,6 +5,8 @@
  */
 
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
 
 size_t VertexLayout::getTypeSize(VertexAttribType type)
 {
@@ -13,6 +15,8 @@ size_t VertexLayout::getTypeSize(VertexAttribType type)
     case VertexAttribType::Float:       return sizeof(float);
     case VertexAttribType::Int:         return sizeof(int);
     case VertexAttribType::UnsignedInt: return sizeof(unsigned int);
+    case VertexAttribType::Short:       return sizeof(short);
+    case VertexAttribType::UnsignedShort:return sizeof(unsigned short);
     case VertexAttribType::Byte:        return sizeof(char);
     case VertexAttribType::UnsignedByte:return sizeof(unsigned char);
     default:                            return sizeof(float);
@@ -32,6 +36,34 @@ void VertexLayout::add(unsigned int index, int size, VertexAttribType type, bool
     m_stride += size * getTypeSize(type);
 }
 
+void VertexLayout::setAttribPointers() const
+{
+    for (const auto& attrib : m_attribs)
+    {
+        GLenum glType = GL_FLOAT;
+        switch (attrib.type)
+        {
+        case VertexAttribType::Float:       glType = GL_FLOAT; break;
+        case VertexAttribType::Int:         glType = GL_INT; break;
+        case VertexAttribType::UnsignedInt: glType = GL_UNSIGNED_INT; break;
+        case VertexAttribType::Short:       glType = GL_SHORT; break;
+        case VertexAttribType::UnsignedShort:glType = GL_UNSIGNED_SHORT; break;
+        case VertexAttribType::Byte:        glType = GL_BYTE; break;
+        case VertexAttribType::UnsignedByte:glType = GL_UNSIGNED_BYTE; break;
+        }
+
+        glVertexAttribPointer(
+            attrib.index,
+            attrib.size,
+            glType,
+            attrib.normalized ? GL_TRUE : GL_FALSE,
+            static_cast<GLsizei>(m_stride),
+            reinterpret_cast<void*>(attrib.offset)
+        );
+        glEnableVertexAttribArray(attrib.index);
+    }
+}
+
 VertexLayout VertexLayout::positionOnly()
 {
     VertexLayout layout;
@@ -83,12 +115,24 @@ VertexLayout VertexLayout::positionNormalTextureTangent()
     return layout;
 }
 
+VertexLayout VertexLayout::packedGridHeightNormal()
+{
+    // 8 bytes: grid XZ (ushort2), normalized height (ushort), octahedral normal (unorm8 x2)
+    VertexLayout layout;
+    layout.add(4, 2, VertexAttribType::UnsignedShort);
+    layout.add(5, 1, VertexAttribType::UnsignedShort, true);
+    layout.add(6, 2, VertexAttribType::UnsignedByte, true);
+    return layout;
+}
+
 Mesh::Mesh()
     : m_vao(0)
     , m_vbo(0)
     , m_ebo(0)
     , m_vertexCount(0)
     , m_indexCount(0)
+    , m_indexType(GL_UNSIGNED_INT)
+    , m_ownsIndices(true)
 {
 }
 
@@ -103,6 +147,8 @@ Mesh::Mesh(Mesh&& other) noexcept
     , m_ebo(other.m_ebo)
     , m_vertexCount(other.m_vertexCount)
     , m_indexCount(other.m_indexCount)
+    , m_indexType(other.m_indexType)
+    , m_ownsIndices(other.m_ownsIndices)
 {
     other.m_vao = 0;
     other.m_vbo = 0;
@@ -122,6 +168,8 @@ Mesh& Mesh::operator=(Mesh&& other) noexcept
         m_ebo = other.m_ebo;
         m_vertexCount = other.m_vertexCount;
         m_indexCount = other.m_indexCount;
+        m_indexType = other.m_indexType;
+        m_ownsIndices = other.m_ownsIndices;
 
         other.m_vao = 0;
         other.m_vbo = 0;
@@ -144,28 +192,7 @@ void Mesh::setVertices(const void* data, size_t size, const VertexLayout& layout
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
 
-    for (const auto& attrib : layout.getAttribs())
-    {
-        GLenum glType = GL_FLOAT;
-        switch (attrib.type)
-        {
-        case VertexAttribType::Float:       glType = GL_FLOAT; break;
-        case VertexAttribType::Int:         glType = GL_INT; break;
-        case VertexAttribType::UnsignedInt: glType = GL_UNSIGNED_INT; break;
-        case VertexAttribType::Byte:        glType = GL_BYTE; break;
-        case VertexAttribType::UnsignedByte:glType = GL_UNSIGNED_BYTE; break;
-        }
-
-        glVertexAttribPointer(
-            attrib.index,
-            attrib.size,
-            glType,
-            attrib.normalized ? GL_TRUE : GL_FALSE,
-            static_cast<GLsizei>(layout.getStride()),
-            reinterpret_cast<void*>(attrib.offset)
-        );
-        glEnableVertexAttribArray(attrib.index);
-    }
+    layout.setAttribPointers();
 
     if (layout.getStride() > 0)
     {
@@ -175,28 +202,85 @@ void Mesh::setVertices(const void* data, size_t size, const VertexLayout& layout
     glBindVertexArray(0);
 }
 
-void Mesh::setIndices(const unsigned int* data, size_t count)
+void Mesh::updateVertices(const void* data, size_t offset, size_t size)
+{
+    if (m_vbo == 0 || size == 0)
+    {
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::setIndices(const unsigned int* data, size_t count, bool optimizeVertexCache)
 {
     if (m_vao == 0)
     {
         return;
     }
 
+    // The indices bound the vertices they address; the vertex buffer may hold more (or be replaced)
+    size_t vertexCount = count > 0 ? static_cast<size_t>(*std::max_element(data, data + count)) + 1 : 0;
+
+    std::vector<unsigned int> optimized;
+    if (optimizeVertexCache)
+    {
+        optimized.assign(data, data + count);
+        MeshOptimizer::optimizeVertexCache(optimized.data(), count, vertexCount);
+        data = optimized.data();
+    }
+
     glBindVertexArray(m_vao);
 
-    if (m_ebo == 0)
+    if (m_ebo == 0 || !m_ownsIndices)
     {
         glGenBuffers(1, &m_ebo);
+        m_ownsIndices = true;
     }
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), data, GL_STATIC_DRAW);
+    if (vertexCount <= 65536)
+    {
+        // Half the index memory and fetch bandwidth
+        std::vector<unsigned short> shortIndices(data, data + count);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+        m_indexType = GL_UNSIGNED_SHORT;
+    }
+    else
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), data, GL_STATIC_DRAW);
+        m_indexType = GL_UNSIGNED_INT;
+    }
 
     m_indexCount = static_cast<unsigned int>(count);
 
     glBindVertexArray(0);
 }
 
+void Mesh::setSharedIndices(unsigned int ebo, size_t count, GLenum indexType)
+{
+    if (m_vao == 0)
+    {
+        return;
+    }
+
+    if (m_ebo != 0 && m_ownsIndices)
+    {
+        glDeleteBuffers(1, &m_ebo);
+    }
+
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBindVertexArray(0);
+
+    m_ebo = ebo;
+    m_ownsIndices = false;
+    m_indexCount = static_cast<unsigned int>(count);
+    m_indexType = indexType;
+}
+
 void Mesh::draw(GLenum mode) const
 {
     if (m_vao == 0)
@@ -208,7 +292,7 @@ void Mesh::draw(GLenum mode) const
 
     if (hasIndices())
     {
-        glDrawElements(mode, m_indexCount, GL_UNSIGNED_INT, 0);
+        glDrawElements(mode, m_indexCount, m_indexType, 0);
     }
     else
     {
@@ -218,6 +302,19 @@ void Mesh::draw(GLenum mode) const
     glBindVertexArray(0);
 }
 
+void Mesh::drawRange(unsigned int firstIndex, unsigned int indexCount, GLenum mode) const
+{
+    if (m_vao == 0 || !hasIndices() || indexCount == 0)
+    {
+        return;
+    }
+
+    glBindVertexArray(m_vao);
+    glDrawElements(mode, indexCount, m_indexType,
+                   reinterpret_cast<const void*>(static_cast<size_t>(firstIndex) * getIndexSize(m_indexType)));
+    glBindVertexArray(0);
+}
+
 void Mesh::drawInstanced(unsigned int instanceCount, GLenum mode) const
 {
     if (m_vao == 0)
@@ -229,7 +326,7 @@ void Mesh::drawInstanced(unsigned int instanceCount, GLenum mode) const
 
     if (hasIndices())
     {
-        glDrawElementsInstanced(mode, m_indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+        glDrawElementsInstanced(mode, m_indexCount, m_indexType, 0, instanceCount);
     }
     else
     {
@@ -243,9 +340,13 @@ void Mesh::release()
 {
     if (m_ebo != 0)
     {
-        glDeleteBuffers(1, &m_ebo);
+        if (m_ownsIndices)
+        {
+            glDeleteBuffers(1, &m_ebo);
+        }
         m_ebo = 0;
     }
+    m_ownsIndices = true;
     if (m_vbo != 0)
     {
         glDeleteBuffers(1, &m_vbo);
@@ -258,4 +359,5 @@ void Mesh::release()
     }
     m_vertexCount = 0;
     m_indexCount = 0;
+    m_indexType = GL_UNSIGNED_INT;
 }
@@ -16,6 +16,8 @@ enum class VertexAttribType
     Float,
     Int,
     UnsignedInt,
+    Short,
+    UnsignedShort,
     Byte,
     UnsignedByte
 };
@@ -37,6 +39,8 @@ public:
     void add(unsigned int index, int size, VertexAttribType type, bool normalized = false);
     const std::vector<VertexAttrib>& getAttribs() const { return m_attribs; }
     size_t getStride() const { return m_stride; }
+    // Point the bound VAO's attributes at the bound GL_ARRAY_BUFFER
+    void setAttribPointers() const;
 
     static VertexLayout positionOnly();
     static VertexLayout positionColor();
@@ -44,6 +48,7 @@ public:
     static VertexLayout positionColorTexture();
     static VertexLayout positionNormalTexture();
     static VertexLayout positionNormalTextureTangent();
+    static VertexLayout packedGridHeightNormal();
 
 private:
     std::vector<VertexAttrib> m_attribs;
@@ -65,13 +70,23 @@ public:
     Mesh& operator=(Mesh&& other) noexcept;
 
     void setVertices(const void* data, size_t size, const VertexLayout& layout);
-    void setIndices(const unsigned int* data, size_t count);
+    // Overwrite size bytes of the vertex buffer at offset (glBufferSubData)
+    void updateVertices(const void* data, size_t offset, size_t size);
+    // Stored as 16-bit when the largest index fits. optimizeVertexCache reorders the
+    // triangles (MeshOptimizer) before upload.
+    void setIndices(const unsigned int* data, size_t count, bool optimizeVertexCache = false);
+    // Reference an index buffer owned elsewhere (not deleted with this mesh)
+    void setSharedIndices(unsigned int ebo, size_t count, GLenum indexType = GL_UNSIGNED_INT);
     void draw(GLenum mode = GL_TRIANGLES) const;
+    // Draw a sub-range of the index buffer
+    void drawRange(unsigned int firstIndex, unsigned int indexCount, GLenum mode = GL_TRIANGLES) const;
     void drawInstanced(unsigned int instanceCount, GLenum mode = GL_TRIANGLES) const;
 
     unsigned int getVAO() const { return m_vao; }
     unsigned int getVertexCount() const { return m_vertexCount; }
     unsigned int getIndexCount() const { return m_indexCount; }
+    GLenum getIndexType() const { return m_indexType; }
+    static size_t getIndexSize(GLenum indexType) { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
     bool hasIndices() const { return m_ebo != 0; }
     bool isValid() const { return m_vao != 0; }
 
@@ -81,6 +96,8 @@ private:
     unsigned int m_ebo;
     unsigned int m_vertexCount;
     unsigned int m_indexCount;
+    GLenum m_indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    bool m_ownsIndices;
 
     void release();
 };
@@ -0,0 +1,216 @@
+/**
+ * @file MeshOptimizer.cpp
+ * @brief Mesh optimizer implementation
+ * @author LuNingfang
+ */
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+    // Tuning from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+    const int CACHE_SIZE = 32;              // LRU cache the scores model, larger than real FIFOs on purpose
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+    const unsigned int MAX_SCORED_VALENCE = 32;
+
+    struct ScoreTables
+    {
+        float cache[CACHE_SIZE];
+        float valence[MAX_SCORED_VALENCE + 1];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < CACHE_SIZE; i++)
+            {
+                // The three vertices of the last triangle score the same, so it is not reused right away
+                cache[i] = i < 3 ? LAST_TRIANGLE_SCORE
+                                 : std::pow(1.0f - static_cast<float>(i - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            valence[0] = 0.0f;
+            for (unsigned int i = 1; i <= MAX_SCORED_VALENCE; i++)
+            {
+                // Boost vertices with few triangles left, so lone triangles are not left behind
+                valence[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+            }
+        }
+    };
+
+    float getVertexScore(const ScoreTables& tables, int cachePosition, unsigned int remainingTriangles)
+    {
+        if (remainingTriangles == 0) return -1.0f;
+
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+        return score + tables.valence[std::min(remainingTriangles, MAX_SCORED_VALENCE)];
+    }
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2 || vertexCount == 0) return;
+
+    static const ScoreTables tables;
+
+    // Triangles using each vertex; the first remaining[v] entries are the ones not yet emitted
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        remaining[indices[i]]++;
+    }
+    std::vector<size_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    }
+    std::vector<unsigned int> triangles(triangleCount * 3);
+    {
+        std::vector<size_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+        {
+            triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScore[v] = getVertexScore(tables, -1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    size_t best = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const unsigned int* tri = &indices[t * 3];
+        triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if (triangleScore[t] > triangleScore[best]) best = t;
+    }
+
+    std::vector<unsigned int> output(triangleCount * 3);
+    unsigned int cache[CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t inputCursor = 0;
+
+    for (size_t out = 0; out < triangleCount; out++)
+    {
+        // Nothing cached has triangles left: continue with the next unused one in input order
+        if (best == SIZE_MAX)
+        {
+            while (emitted[inputCursor]) inputCursor++;
+            best = inputCursor;
+        }
+
+        const unsigned int* tri = &indices[best * 3];
+        std::memcpy(&output[out * 3], tri, 3 * sizeof(unsigned int));
+        emitted[best] = 1;
+
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = tri[k];
+            unsigned int* list = &triangles[firstTriangle[v]];
+            unsigned int* last = list + remaining[v] - 1;
+            *std::find(list, last, static_cast<unsigned int>(best)) = *last;
+            remaining[v]--;
+        }
+
+        // The triangle's vertices move to the front; the rest keep their order behind them
+        unsigned int newCache[CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (std::find(newCache, newCache + newCount, tri[k]) == newCache + newCount) newCache[newCount++] = tri[k];
+        }
+        for (int i = 0; i < cacheCount; i++)
+        {
+            if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2]) newCache[newCount++] = cache[i];
+        }
+
+        // Rescore everything that moved (evicted vertices included), then pick the best
+        // triangle touching the cache
+        best = SIZE_MAX;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newCount; i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < CACHE_SIZE ? i : -1;
+            float score = getVertexScore(tables, cachePosition[v], remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const unsigned int* list = &triangles[firstTriangle[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++)
+            {
+                unsigned int t = list[j];
+                triangleScore[t] += delta;
+                if (i < CACHE_SIZE && triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(void* vertices, size_t vertexCount, size_t stride,
+                                          unsigned int* indices, size_t indexCount)
+{
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertexCount, UNUSED);
+    unsigned int next = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int& target = remap[indices[i]];
+        if (target == UNUSED) target = next++;
+        indices[i] = target;
+    }
+    size_t referenced = next;
+
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        if (remap[v] == UNUSED) remap[v] = next++;
+    }
+
+    uint8_t* data = static_cast<uint8_t*>(vertices);
+    std::vector<uint8_t> reordered(vertexCount * stride);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        std::memcpy(&reordered[remap[v] * stride], data + v * stride, stride);
+    }
+    std::memcpy(data, reordered.data(), reordered.size());
+    return referenced;
+}
+
+float MeshOptimizer::computeACMR(const unsigned int* indices, size_t indexCount, size_t vertexCount, int cacheSize)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return 0.0f;
+
+    // A vertex is cached while fewer than cacheSize misses happened since it was loaded
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        size_t& loaded = loadedAt[indices[i]];
+        if (loaded == 0 || misses - loaded >= static_cast<size_t>(cacheSize))
+        {
+            misses++;
+            loaded = misses;
+        }
+    }
+    return static_cast<float>(misses) / static_cast<float>(triangleCount);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file MeshOptimizer.h
+ * @brief Triangle and vertex reordering for the GPU post-transform cache and vertex fetch
+ * @author LuNingfang
+ */
+
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+
+class MeshOptimizer
+{
+public:
+    // FIFO size computeACMR() simulates unless told otherwise
+    static const int DEFAULT_CACHE_SIZE = 16;
+
+    /**
+     * @brief Reorder triangles in place so consecutive ones reuse recently transformed vertices
+     *
+     * Tom Forsyth's linear-speed vertex cache optimisation. Triangles keep their winding;
+     * only their order changes, so any index sub-range can be optimised on its own.
+     * @param vertexCount One past the largest index
+     */
+    static void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+    /**
+     * @brief Renumber vertices in first-use order so fetches walk the vertex buffer forward
+     *
+     * Run after optimizeVertexCache(). Vertices no triangle references are moved to the end.
+     * @return Number of referenced vertices
+     */
+    static size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t stride,
+                                      unsigned int* indices, size_t indexCount);
+
+    /**
+     * @brief Average cache miss ratio: vertices transformed per triangle with a FIFO cache
+     *
+     * 3.0 means no reuse at all; a regular grid cannot go below about 0.5.
+     */
+    static float computeACMR(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+                             int cacheSize = DEFAULT_CACHE_SIZE);
+};
+
+#endif
@@ -91,6 +91,51 @@ bool Shader::load(const char* vertexPath, const char* fragmentPath)
     return true;
 }
 
+bool Shader::loadCompute(const char* computePath)
+{
+    release();
+
+    std::string computeCode;
+    std::ifstream cShaderFile;
+    cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try
+    {
+        cShaderFile.open(computePath);
+        std::stringstream cShaderStream;
+        cShaderStream << cShaderFile.rdbuf();
+        cShaderFile.close();
+        computeCode = cShaderStream.str();
+    }
+    catch (std::ifstream::failure& e)
+    {
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << computePath << " " << e.what() << std::endl;
+        return false;
+    }
+
+    const char* cShaderCode = computeCode.c_str();
+
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+    bool compiled = checkCompileErrors(compute, "COMPUTE");
+
+    // Callers fall back to a CPU path, so a broken program is not kept around
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glLinkProgram(ID);
+    bool linked = compiled && checkCompileErrors(ID, "PROGRAM");
+
+    glDeleteShader(compute);
+
+    if (!linked)
+    {
+        release();
+        return false;
+    }
+    return true;
+}
+
 void Shader::use() const
 {
     glUseProgram(ID);
@@ -106,6 +151,11 @@ void Shader::setInt(const std::string& name, int value) const
     glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
 }
 
+void Shader::setUInt(const std::string& name, unsigned int value) const
+{
+    glUniform1ui(glGetUniformLocation(ID, name.c_str()), value);
+}
+
 void Shader::setFloat(const std::string& name, float value) const
 {
     glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
@@ -131,7 +181,7 @@ void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
     glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
 
-void Shader::checkCompileErrors(unsigned int shader, const std::string& type)
+bool Shader::checkCompileErrors(unsigned int shader, const std::string& type)
 {
     int success;
     char infoLog[1024];
@@ -156,4 +206,5 @@ void Shader::checkCompileErrors(unsigned int shader, const std::string& type)
                       << infoLog << std::endl;
         }
     }
+    return success != 0;
 }
@@ -21,11 +21,16 @@ public:
     ~Shader();
 
     bool load(const char* vertexPath, const char* fragmentPath);
+
+    // Compile and link a compute shader program; false (and no program) if either step fails
+    bool loadCompute(const char* computePath);
+
     void use() const;
 
     // Uniform setters
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
+    void setUInt(const std::string& name, unsigned int value) const;
     void setFloat(const std::string& name, float value) const;
     void setVec2(const std::string& name, const glm::vec2& value) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
@@ -35,7 +40,7 @@ public:
     bool isValid() const { return ID != 0; }
 
 private:
-    void checkCompileErrors(unsigned int shader, const std::string& type);
+    bool checkCompileErrors(unsigned int shader, const std::string& type);
     void release();
 };
 
@@ -0,0 +1,126 @@
+/**
+ * @file ThreadPool.cpp
+ * @brief Worker thread pool implementation
+ * @author LuNingfang
+ */
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : m_stopping(false)
+{
+    if (threadCount == 0)
+    {
+        unsigned int hw = std::thread::hardware_concurrency();
+        threadCount = hw > 1 ? hw - 1 : 1;
+    }
+
+    m_workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+    if (count == 0) return;
+
+    // Shared by the helper tasks, which may still be queued after we return
+    // if the caller finished every index before a worker picked them up
+    struct Job
+    {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;   // first exception thrown by func, written under mutex
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto job = std::make_shared<Job>();
+
+    auto run = [job, count, &func]()
+    {
+        size_t processed = 0;
+        for (size_t i = job->next++; i < count; i = job->next++)
+        {
+            // After a failure the remaining indices are only counted, so the caller still wakes
+            if (!job->failed)
+            {
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    if (!job->error) job->error = std::current_exception();
+                    job->failed = true;
+                }
+            }
+            processed++;
+        }
+        if (processed > 0 && job->done.fetch_add(processed) + processed == count)
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->finished.notify_all();
+        }
+    };
+
+    size_t helpers = std::min(m_workers.size(), count - 1);
+    for (size_t i = 0; i < helpers; i++)
+    {
+        // Helpers only touch func while indices remain, which the caller
+        // waits for, so capturing it by reference is safe
+        submit(run);
+    }
+
+    run();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job, count]() { return job->done.load() == count; });
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty()) return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
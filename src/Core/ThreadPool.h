@@ -0,0 +1,59 @@
+/**
+ * @file ThreadPool.h
+ * @brief Fixed-size worker thread pool
+ * @author LuNingfang
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    /**
+     * @param threadCount Number of workers (0 = hardware concurrency - 1)
+     */
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queue a task to run on a worker thread
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Run func(i) for i in [0, count) across the workers and the
+     *        calling thread, returning once every index has been processed
+     *
+     * If func throws, indices not yet started are skipped and the first
+     * exception is rethrown here, on the calling thread.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+    /**
+     * @brief Number of threads parallelFor can use (workers + caller)
+     */
+    size_t getConcurrency() const { return m_workers.size() + 1; }
+
+private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping;
+
+    void workerLoop();
+};
+
+#endif
@@ -1,118 +1,1115 @@
 #include "ChunkedTerrain.h"
 #include <iostream>
 #include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <tuple>
+
+namespace {
+    // Chunks built per batch; bounds the CPU-side mesh data held before upload
+    const size_t BUILD_BATCH_SIZE = 256;
+    
+    // Streaming fallback meshes sample every 8th texel, the density of LOD 3
+    const int FALLBACK_SAMPLE_LEVEL = TerrainIndexCache::LOD_LEVELS - 1;
+    
+    double elapsedMs(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+}
 
 ChunkedTerrain::ChunkedTerrain()
-    : m_size(100.0f)
+    : m_vertexFormat(TerrainVertexFormat::Standard)
+    , m_normalPath(SimdPath::Scalar)
+    , m_size(100.0f)
     , m_maxHeight(20.0f)
     , m_chunkSize(64)
     , m_chunksPerRow(0)
+    , m_chunksPerCol(0)
+    , m_leafCount(0)
+    , m_pixelsPerRadian(0.0f)
+    , m_clipPlane(0.0f)
     , m_generated(false)
+    , m_streaming(false)
+    , m_skirts(false)
+    , m_meshCacheHit(false)
+    , m_multiDraw(false)
+    , m_gpuChunksDirty(false)
+    , m_chunkBoundsDirty(false)
+    , m_gpuCulled(false)
+    , m_gpuCullPass(0)
+    , m_cullPass(0)
+    , m_gpuCullingMismatches(0)
     , m_visibleChunks(0)
+    , m_occludedChunks(0)
     , m_renderedTriangles(0)
     , m_totalVertices(0)
+    , m_testedNodes(0)
+    , m_planeTests(0)
+    , m_drawCalls(0)
+    , m_buildTimeMs(0.0)
+    , m_uploadTimeMs(0.0)
+    , m_sculptTimeMs(0.0)
+    , m_sculptedMeshes(0)
+    , m_vertexMemoryBytes(0)
+    , m_uploadedMeshes(0)
+    , m_pendingMeshes(0)
+    , m_buildFinished(false)
+    , m_buildFailed(false)
+    , m_cancelGenerate(false)
 {
 }
 
 ChunkedTerrain::~ChunkedTerrain()
 {
+    // Background and streaming builds read m_heightmap and run on m_workers; finish them first
+    cancelGenerate();
+    m_streamer.clear();
+}
+
+void ChunkedTerrain::setViewParameters(float fovYRadians, int viewportHeight)
+{
+    m_pixelsPerRadian = static_cast<float>(viewportHeight) / (2.0f * std::tan(fovYRadians * 0.5f));
 }
 
 bool ChunkedTerrain::generate(const std::string& heightmapPath, float size, float maxHeight, int chunkSize)
 {
+    cancelGenerate();
+    releaseMeshes();
+    m_buildTimeMs = 0.0;
+    m_uploadTimeMs = 0.0;
+    
+    if (!prepareGenerate(heightmapPath, size, maxHeight, chunkSize))
+    {
+        return false;
+    }
+    
+    // Build CPU meshes in parallel, then upload each batch on this (GL) thread
+    ThreadPool* workers = getWorkers();
+    std::vector<TerrainChunkData> batch;
+    
+    if (m_meshCacheHit)
+    {
+        auto uploadStart = std::chrono::steady_clock::now();
+        uploadCachedMeshes(0, m_regions.size());
+        m_uploadTimeMs += elapsedMs(uploadStart);
+    }
+    
+    for (size_t first = 0; first < m_regions.size() && !m_meshCacheHit; first += BUILD_BATCH_SIZE)
+    {
+        batch.resize(std::min(BUILD_BATCH_SIZE, m_regions.size() - first));
+        buildMeshes(first, batch, workers);
+        
+        auto uploadStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            uploadMesh(first + i, batch[i]);
+        }
+        m_uploadTimeMs += elapsedMs(uploadStart);
+    }
+    
+    finishGenerate();
+    return true;
+}
+
+void ChunkedTerrain::generateAsync(const std::string& heightmapPath, float size, float maxHeight, int chunkSize)
+{
+    // GL objects are released here, on the calling (GL) thread
+    cancelGenerate();
+    releaseMeshes();
+    
+    m_buildTimeMs = 0.0;
+    m_uploadTimeMs = 0.0;
+    m_uploadedMeshes = 0;
+    m_pendingMeshes = 0;
+    m_buildFinished = false;
+    m_buildFailed = false;
+    
+    m_generateThread = std::thread([this, heightmapPath, size, maxHeight, chunkSize]()
+    {
+        bool prepared = prepareGenerate(heightmapPath, size, maxHeight, chunkSize);
+        if (prepared)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_generateMutex);
+                m_pendingMeshes = m_regions.size();
+            }
+            
+            // On a cache hit nothing is built; pumpGenerate() uploads straight from the mapping
+            ThreadPool* workers = getWorkers();
+            std::vector<TerrainChunkData> batch;
+            for (size_t first = 0; first < m_regions.size() && !m_cancelGenerate && !m_meshCacheHit;
+                 first += BUILD_BATCH_SIZE)
+            {
+                batch.resize(std::min(BUILD_BATCH_SIZE, m_regions.size() - first));
+                buildMeshes(first, batch, workers);
+                
+                // At most one batch waits for upload while the next one builds
+                std::unique_lock<std::mutex> lock(m_generateMutex);
+                m_generateCondition.wait(lock, [this]() { return m_cancelGenerate || m_readyMeshes.empty(); });
+                if (m_cancelGenerate) break;
+                for (size_t i = 0; i < batch.size(); i++)
+                {
+                    m_readyMeshes.emplace_back(first + i, std::move(batch[i]));
+                }
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(m_generateMutex);
+        m_buildFinished = true;
+        m_buildFailed = !prepared;
+    });
+}
+
+bool ChunkedTerrain::pumpGenerate()
+{
+    if (!m_generateThread.joinable()) return true;
+    
+    std::vector<std::pair<size_t, TerrainChunkData>> ready;
+    size_t cachedFirst = 0;
+    size_t cachedCount = 0;
+    bool finished;
+    {
+        std::lock_guard<std::mutex> lock(m_generateMutex);
+        size_t count = static_cast<size_t>(std::max(m_uploadsPerFrame, 1));
+        // m_meshCacheHit is settled once the build thread has finished
+        bool cached = m_buildFinished && m_meshCacheHit;
+        if (cached)
+        {
+            cachedFirst = m_uploadedMeshes;
+            cachedCount = std::min(count, m_pendingMeshes - m_uploadedMeshes);
+        }
+        count = std::min(m_readyMeshes.size(), count);
+        for (size_t i = 0; i < count; i++)
+        {
+            ready.push_back(std::move(m_readyMeshes.front()));
+            m_readyMeshes.pop_front();
+        }
+        finished = m_buildFinished && m_readyMeshes.empty() &&
+                   (!cached || cachedFirst + cachedCount == m_pendingMeshes);
+    }
+    m_generateCondition.notify_all();
+    
+    auto uploadStart = std::chrono::steady_clock::now();
+    for (const auto& mesh : ready)
+    {
+        uploadMesh(mesh.first, mesh.second);
+    }
+    uploadCachedMeshes(cachedFirst, cachedCount);
+    m_uploadTimeMs += elapsedMs(uploadStart);
+    
+    {
+        std::lock_guard<std::mutex> lock(m_generateMutex);
+        m_uploadedMeshes += ready.size() + cachedCount;
+    }
+    
+    if (!finished) return false;
+    
+    m_generateThread.join();
+    if (!m_buildFailed)
+    {
+        finishGenerate();
+    }
+    return true;
+}
+
+float ChunkedTerrain::getGenerateProgress() const
+{
+    std::lock_guard<std::mutex> lock(m_generateMutex);
+    if (m_pendingMeshes == 0) return 0.0f;
+    return static_cast<float>(m_uploadedMeshes) / static_cast<float>(m_pendingMeshes);
+}
+
+void ChunkedTerrain::cancelGenerate()
+{
+    if (!m_generateThread.joinable()) return;
+    
+    requestCancelGenerate();
+    m_generateThread.join();
+    endCancelGenerate();
+}
+
+void ChunkedTerrain::requestCancelGenerate()
+{
+    if (!m_generateThread.joinable()) return;
+    
+    // Checked between normal field rows, chunk builds and batches
+    m_cancelGenerate = true;
+    m_generateCondition.notify_all();
+}
+
+bool ChunkedTerrain::pollCancelGenerate()
+{
+    if (!m_generateThread.joinable()) return true;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_generateMutex);
+        if (!m_buildFinished) return false;
+    }
+    // Past its last lock, so this join does not wait on any work
+    m_generateThread.join();
+    endCancelGenerate();
+    return true;
+}
+
+void ChunkedTerrain::endCancelGenerate()
+{
+    m_cancelGenerate = false;
+    m_readyMeshes.clear();
+    
+    // Drops a half-written cache
+    m_meshCache.close();
+}
+
+void ChunkedTerrain::copyOptions(const ChunkedTerrain& other)
+{
+    std::copy(std::begin(other.m_lodDistances), std::end(other.m_lodDistances), m_lodDistances);
+    m_enableFrustumCulling = other.m_enableFrustumCulling;
+    m_enableLOD = other.m_enableLOD;
+    m_seamMode = other.m_seamMode;
+    m_useScreenSpaceError = other.m_useScreenSpaceError;
+    m_pixelErrorThreshold = other.m_pixelErrorThreshold;
+    m_enableParallelBuild = other.m_enableParallelBuild;
+    m_usePackedVertices = other.m_usePackedVertices;
+    m_heightStorage = other.m_heightStorage;
+    m_enableSIMD = other.m_enableSIMD;
+    m_useQuadtree = other.m_useQuadtree;
+    m_enableStreaming = other.m_enableStreaming;
+    m_streamingBudgetMB = other.m_streamingBudgetMB;
+    m_uploadsPerFrame = other.m_uploadsPerFrame;
+    m_optimizeVertexCache = other.m_optimizeVertexCache;
+    m_enableMeshCache = other.m_enableMeshCache;
+    m_useMultiDrawIndirect = other.m_useMultiDrawIndirect;
+    m_enableGPUCulling = other.m_enableGPUCulling;
+    m_verifyGPUCulling = other.m_verifyGPUCulling;
+    m_enableHiZCulling = other.m_enableHiZCulling;
+    m_occluderDistance = other.m_occluderDistance;
+    m_enableHorizonCulling = other.m_enableHorizonCulling;
+    m_pixelsPerRadian = other.m_pixelsPerRadian;
+}
+
+ThreadPool* ChunkedTerrain::getWorkers()
+{
+    if (m_enableParallelBuild && !m_workers)
+    {
+        m_workers = std::make_unique<ThreadPool>();
+    }
+    return m_enableParallelBuild ? m_workers.get() : nullptr;
+}
+
+void ChunkedTerrain::releaseMeshes()
+{
+    // In-flight streaming builds read the heightmap and normal field
+    m_streamer.clear();
+    
+    m_generated = false;
+    m_chunks.clear();
+    m_fallbackChunks.clear();
+    m_nodeMeshes.clear();
+    m_quadtree.clear();
+    m_indexCache.clear();
+    m_drawArena.clear();
+    m_gpuCuller.clear();
+    m_hiZ.clear();
+}
+
+bool ChunkedTerrain::prepareGenerate(const std::string& heightmapPath, float size, float maxHeight, int chunkSize)
+{
+    m_heightmapPath = heightmapPath;
     m_size = size;
     m_maxHeight = maxHeight;
     m_chunkSize = chunkSize;
-    m_generated = false;
-    m_chunks.clear();
+    m_vertexFormat = m_usePackedVertices ? TerrainVertexFormat::Packed : TerrainVertexFormat::Standard;
+    m_streaming = m_enableStreaming;
+    m_skirts = m_streaming || m_useQuadtree || m_seamMode == TerrainSeamMode::Skirt;
+    m_multiDraw = m_useMultiDrawIndirect;
+    m_meshCacheHit = false;
+    m_meshCache.close();
+    m_regions.clear();
     
+    m_heightmap.setStorage(m_heightStorage);
     if (!m_heightmap.load(heightmapPath))
     {
         std::cerr << "ERROR::CHUNKED_TERRAIN::FAILED_TO_LOAD_HEIGHTMAP" << std::endl;
         return false;
     }
+    if (m_cancelGenerate) return false;
     
     int width = m_heightmap.getWidth();
     int height = m_heightmap.getGridHeight();
     
+    // Packed grid coordinates would wrap past 65535; such maps keep the standard format
+    if (m_vertexFormat == TerrainVertexFormat::Packed &&
+        (width > TerrainChunk::PACKED_GRID_LIMIT || height > TerrainChunk::PACKED_GRID_LIMIT))
+    {
+        std::cout << "ChunkedTerrain: " << width << "x" << height << " exceeds the packed vertex grid limit of "
+                  << TerrainChunk::PACKED_GRID_LIMIT << ", using the standard vertex format" << std::endl;
+        m_vertexFormat = TerrainVertexFormat::Standard;
+    }
+    
     m_chunksPerRow = (width - 1) / m_chunkSize;
     if ((width - 1) % m_chunkSize != 0) m_chunksPerRow++;
     
-    int chunksPerCol = (height - 1) / m_chunkSize;
-    if ((height - 1) % m_chunkSize != 0) chunksPerCol++;
+    m_chunksPerCol = (height - 1) / m_chunkSize;
+    if ((height - 1) % m_chunkSize != 0) m_chunksPerCol++;
     
-    m_chunks.reserve(m_chunksPerRow * chunksPerCol);
+    m_regions.reserve(m_chunksPerRow * m_chunksPerCol);
     
-    for (int cz = 0; cz < chunksPerCol; cz++)
+    for (int cz = 0; cz < m_chunksPerCol; cz++)
     {
         for (int cx = 0; cx < m_chunksPerRow; cx++)
         {
             int startX = cx * m_chunkSize;
             int startZ = cz * m_chunkSize;
+            // Border chunks are clipped per axis so the last row/column is covered
             int actualChunkSizeX = std::min(m_chunkSize, width - 1 - startX);
             int actualChunkSizeZ = std::min(m_chunkSize, height - 1 - startZ);
-            int actualChunkSize = std::min(actualChunkSizeX, actualChunkSizeZ);
             
-            if (actualChunkSize <= 0) continue;
+            if (actualChunkSizeX <= 0 || actualChunkSizeZ <= 0) continue;
             
-            TerrainChunk chunk;
-            chunk.generate(m_heightmap, startX, startZ, actualChunkSize, size, size, maxHeight);
-            m_chunks.push_back(std::move(chunk));
+            m_regions.push_back({ startX, startZ, actualChunkSizeX, actualChunkSizeZ,
+                                  m_streaming ? FALLBACK_SAMPLE_LEVEL : 0 });
+        }
+    }
+    
+    // Chunks stay in row-major grid order; stitching looks neighbours up by index
+    m_leafCount = m_regions.size();
+    m_chunks.resize(m_leafCount);
+    m_chunkLODs.assign(m_leafCount, 0);
+    
+    // When streaming, only coarse fallbacks are built up front; full chunks are paged in later
+    if (m_streaming)
+    {
+        m_fallbackChunks.resize(m_leafCount);
+    }
+    
+    // Quadtree node meshes are built with the chunks, after them in the region list
+    if (m_useQuadtree)
+    {
+        for (int nodeIndex : m_quadtree.build(m_chunksPerRow, m_chunksPerCol, m_chunkSize, width, height))
+        {
+            const TerrainQuadtree::Node& node = m_quadtree.getNode(nodeIndex);
+            m_regions.push_back({ node.startX, node.startZ, node.sizeX, node.sizeZ, node.level });
+        }
+        m_nodeMeshes.resize(m_regions.size() - m_leafCount);
+    }
+    
+    // Multi-draw keeps every mesh in one arena, created large enough for the meshes built up
+    // front so it does not grow while they upload; streamed chunks grow it as they page in
+    if (m_multiDraw)
+    {
+        for (auto* meshes : { &m_chunks, &m_fallbackChunks, &m_nodeMeshes })
+        {
+            for (auto& mesh : *meshes) mesh.setDrawArena(&m_drawArena);
+        }
+        
+        size_t vertices = 0;
+        for (const ChunkRegion& r : m_regions)
+        {
+            int verticesX = TerrainIndexCache::getLODVertexCount(r.sizeX + 1, r.sampleLevel);
+            int verticesZ = TerrainIndexCache::getLODVertexCount(r.sizeZ + 1, r.sampleLevel);
+            vertices += static_cast<size_t>(verticesX) * verticesZ;
+            if (m_skirts) vertices += TerrainIndexCache::getSkirtVertexCount(verticesX, verticesZ);
+        }
+        m_drawArena.reserve(vertices * TerrainChunk::getVertexStride(m_vertexFormat));
+    }
+    
+    // Index buffers (vertex cache optimisation included) are built here, off the GL thread;
+    // uploads then only create the EBOs. Streamed full chunks use the level 0 shapes.
+    m_indexCache.setOptimizeVertexCache(m_optimizeVertexCache);
+    for (size_t i = 0; i < m_regions.size(); i++)
+    {
+        const ChunkRegion& r = m_regions[i];
+        m_indexCache.prepare(TerrainIndexCache::getLODVertexCount(r.sizeX + 1, r.sampleLevel),
+                             TerrainIndexCache::getLODVertexCount(r.sizeZ + 1, r.sampleLevel));
+        if (m_streaming && i < m_leafCount)
+        {
+            m_indexCache.prepare(r.sizeX + 1, r.sizeZ + 1);
+        }
+    }
+    if (m_cancelGenerate) return false;
+    
+    // Each chunk build computes the normals of its own region; nothing per texel stays resident
+    m_normalPath = TerrainNormalField::selectPath(m_enableSIMD);
+    
+    // Meshes saved by an earlier run with the same inputs are uploaded as they are; otherwise the
+    // build below saves them. Tiled maps are not hashed (that would page in the whole file).
+    if (m_enableMeshCache && m_heightmap.getSampleBytes() > 0)
+    {
+        std::string cachePath = heightmapPath + ".meshcache";
+        uint64_t key = computeMeshCacheKey();
+        m_meshCacheHit = m_meshCache.open(cachePath, key, m_regions.size(), m_vertexFormat);
+        if (!m_meshCacheHit)
+        {
+            m_meshCache.beginWrite(cachePath, key, m_regions.size(), m_vertexFormat);
         }
     }
     
-    // Calculate total vertices (at LOD 0)
+    return true;
+}
+
+uint64_t ChunkedTerrain::computeMeshCacheKey() const
+{
+    // Everything TerrainChunk::build() reads: the samples as stored, the world scale, the normal
+    // path (SIMD and scalar may round differently), the vertex format, skirts and the mesh regions
+    const int32_t options[] = {
+        m_heightmap.getWidth(), m_heightmap.getGridHeight(), static_cast<int32_t>(m_heightmap.getStorage()),
+        static_cast<int32_t>(m_normalPath), static_cast<int32_t>(m_vertexFormat), m_chunkSize,
+        m_skirts ? 1 : 0
+    };
+    const float scale[] = { m_size, m_maxHeight };
+    
+    uint64_t key = TerrainMeshCache::hash(m_heightmap.getSamples(), m_heightmap.getSampleBytes());
+    key = TerrainMeshCache::hash(options, sizeof(options), key);
+    key = TerrainMeshCache::hash(scale, sizeof(scale), key);
+    return TerrainMeshCache::hash(m_regions.data(), m_regions.size() * sizeof(ChunkRegion), key);
+}
+
+void ChunkedTerrain::buildMeshes(size_t first, std::vector<TerrainChunkData>& batch, ThreadPool* workers)
+{
+    auto buildStart = std::chrono::steady_clock::now();
+    auto buildOne = [&](size_t i)
+    {
+        // A cancelled batch is dropped whole, so its remaining chunks are skipped
+        if (m_cancelGenerate) return;
+        const ChunkRegion& r = m_regions[first + i];
+        TerrainChunk::build(m_heightmap, m_normalPath, r.startX, r.startZ, r.sizeX, r.sizeZ, m_size, m_maxHeight,
+                            m_vertexFormat, m_skirts, batch[i], r.sampleLevel);
+    };
+    if (workers)
+    {
+        workers->parallelFor(batch.size(), buildOne);
+    }
+    else
+    {
+        for (size_t i = 0; i < batch.size(); i++) buildOne(i);
+    }
+    
+    // Batches arrive in region order, the order the cache stores them in
+    if (m_meshCache.isWriting() && !m_cancelGenerate)
+    {
+        for (const auto& data : batch) m_meshCache.write(data);
+    }
+    m_buildTimeMs += elapsedMs(buildStart);
+}
+
+void ChunkedTerrain::uploadMesh(size_t index, const TerrainChunkData& data)
+{
+    std::vector<TerrainChunk>& leafTargets = m_streaming ? m_fallbackChunks : m_chunks;
+    TerrainChunk& target = index < m_leafCount ? leafTargets[index] : m_nodeMeshes[index - m_leafCount];
+    target.upload(data, m_indexCache);
+}
+
+void ChunkedTerrain::uploadCachedMeshes(size_t first, size_t count)
+{
+    std::vector<TerrainChunk>& leafTargets = m_streaming ? m_fallbackChunks : m_chunks;
+    TerrainChunkData data;
+    for (size_t index = first; index < first + count; index++)
+    {
+        size_t vertexBytes = 0;
+        const uint8_t* vertices = m_meshCache.getMesh(index, data, vertexBytes);
+        TerrainChunk& target = index < m_leafCount ? leafTargets[index] : m_nodeMeshes[index - m_leafCount];
+        target.upload(data, m_indexCache, vertices, vertexBytes);
+    }
+}
+
+void ChunkedTerrain::finishGenerate()
+{
+    std::vector<TerrainChunk>& leafTargets = m_streaming ? m_fallbackChunks : m_chunks;
+    ThreadPool* workers = getWorkers();
+    
+    // The GL buffers hold their own copy; keep neither the mapping nor the writer
+    const char* meshCacheState = m_meshCacheHit ? "loaded" : (m_meshCache.isWriting() ? "saved" : "off");
+    if (m_meshCache.isWriting() && !m_meshCache.endWrite())
+    {
+        meshCacheState = "failed";
+    }
+    size_t meshCacheBytes = m_meshCache.getFileBytes();
+    m_meshCache.close();
+    
+    if (m_useQuadtree)
+    {
+        m_quadtree.updateBounds(leafTargets, m_nodeMeshes);
+    }
+    m_gpuChunksDirty = true;
+    m_chunkBoundsDirty = true;
+    m_gpuCullingMismatches = 0;
+    
+    if (m_streaming)
+    {
+        std::vector<ChunkRegion> leafRegions(m_regions.begin(), m_regions.begin() + m_leafCount);
+        float size = m_size;
+        float maxHeight = m_maxHeight;
+        m_streamer.m_memoryBudgetBytes = static_cast<size_t>(m_streamingBudgetMB) << 20;
+        m_streamer.reset(static_cast<int>(m_leafCount), workers,
+            [this, leafRegions, size, maxHeight](int chunkIndex, TerrainChunkData& data)
+            {
+                const ChunkRegion& r = leafRegions[chunkIndex];
+                TerrainChunk::build(m_heightmap, m_normalPath, r.startX, r.startZ, r.sizeX, r.sizeZ,
+                                    size, maxHeight, m_vertexFormat, true, data);
+            });
+    }
+    
+    // Calculate total vertices (at LOD 0) and what per-chunk index buffers and
+    // per-LOD vertex buffers would have cost
     m_totalVertices = 0;
-    for (const auto& chunk : m_chunks)
+    m_vertexMemoryBytes = 0;
+    size_t perChunkIndexBytes = 0;
+    size_t perLODVertexBytes = 0;
+    size_t stride = TerrainChunk::getVertexStride(m_vertexFormat);
+    for (size_t r = 0; r < m_leafCount; r++)
+    {
+        for (int lod = 0; lod < TerrainChunk::LOD_LEVELS; lod++)
+        {
+            perLODVertexBytes += static_cast<size_t>(TerrainIndexCache::getLODVertexCount(m_regions[r].sizeX + 1, lod)) *
+                                 TerrainIndexCache::getLODVertexCount(m_regions[r].sizeZ + 1, lod) * stride;
+        }
+    }
+    for (size_t r = 0; r < m_leafCount; r++)
+    {
+        m_totalVertices += m_regions[r].sizeX * m_regions[r].sizeZ * 2 * 3;
+    }
+    for (const auto& chunk : leafTargets)
+    {
+        m_vertexMemoryBytes += chunk.getVertexMemoryBytes();
+        perChunkIndexBytes += chunk.getIndexCount() * sizeof(unsigned int);
+    }
+    size_t nodeMemoryBytes = 0;
+    for (const auto& node : m_nodeMeshes)
     {
-        m_totalVertices += chunk.getTriangleCount(0) * 3;
+        nodeMemoryBytes += node.getVertexMemoryBytes();
     }
+    m_vertexMemoryBytes += nodeMemoryBytes;
     
     m_generated = true;
     
     std::cout << "ChunkedTerrain generated: " << m_chunks.size() << " chunks ("
-              << m_chunksPerRow << "x" << chunksPerCol << "), chunk size: " << m_chunkSize << std::endl;
+              << m_chunksPerRow << "x" << m_chunksPerCol << "), chunk size: " << m_chunkSize << std::endl;
+    std::cout << "  Normals: per chunk (" << getNormalPathName() << ")" << std::endl;
+    std::cout << "  Mesh build: " << m_buildTimeMs << " ms ("
+              << (workers ? workers->getConcurrency() : 1) << " threads), upload: "
+              << m_uploadTimeMs << " ms" << std::endl;
+    std::cout << "  Mesh cache: " << meshCacheState;
+    if (m_meshCacheHit)
+    {
+        std::cout << " (" << meshCacheBytes / 1024 << " KB, mesh build skipped)";
+    }
+    std::cout << std::endl;
+    std::cout << "  Index buffers: " << m_indexCache.getBufferCount() << " shared, "
+              << m_indexCache.getMemoryBytes() / 1024 << " KB incl. stitch variants and skirts (per-chunk would be "
+              << perChunkIndexBytes / 1024 << " KB), ACMR " << m_indexCache.getUnoptimizedACMR() << " -> "
+              << m_indexCache.getACMR() << (m_optimizeVertexCache ? "" : " (not optimized)") << std::endl;
+    std::cout << "  Vertex buffers: " << m_chunks.size() << ", " << m_vertexMemoryBytes / 1024 << " KB ("
+              << stride << " bytes/vertex, "
+              << (m_vertexFormat == TerrainVertexFormat::Packed ? "packed" : "standard") << "; per-LOD would be "
+              << m_chunks.size() * TerrainChunk::LOD_LEVELS << ", " << perLODVertexBytes / 1024 << " KB)" << std::endl;
+    if (m_useQuadtree)
+    {
+        std::cout << "  Quadtree: " << m_quadtree.getNodeCount() << " nodes, " << m_nodeMeshes.size()
+                  << " coarse node meshes, " << nodeMemoryBytes / 1024 << " KB" << std::endl;
+    }
+    if (m_multiDraw)
+    {
+        std::cout << "  Draw arena: " << m_drawArena.getVertexUsedBytes() / 1024 << " / "
+                  << m_drawArena.getVertexCapacityBytes() / 1024 << " KB vertices, "
+                  << m_drawArena.getIndexMemoryBytes() / 1024 << " KB indices, one multi-draw per pass" << std::endl;
+    }
+    if (m_streaming)
+    {
+        std::cout << "  Streaming: vertex buffers above are LOD " << FALLBACK_SAMPLE_LEVEL
+                  << " fallbacks, full chunks paged in under a " << m_streamingBudgetMB << " MB budget" << std::endl;
+    }
     
-    return true;
+}
+
+bool ChunkedTerrain::regenerate()
+{
+    if (m_heightmapPath.empty()) return false;
+    return generate(m_heightmapPath, m_size, m_maxHeight, m_chunkSize);
+}
+
+void ChunkedTerrain::update()
+{
+    m_gpuCullPass = 0;
+    m_cullPass = 0;
+    if (!m_generated || !m_streaming) return;
+    
+    m_streamer.m_memoryBudgetBytes = static_cast<size_t>(m_streamingBudgetMB) << 20;
+    m_streamer.update(m_chunks, m_indexCache);
 }
 
 void ChunkedTerrain::render(Shader& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection)
 {
     if (!m_generated) return;
     
+    setPackedVertexUniforms(shader);
+    
     if (m_enableFrustumCulling)
     {
         m_frustum.update(viewProjection);
     }
     
     m_visibleChunks = 0;
+    m_occludedChunks = 0;
     m_renderedTriangles = 0;
+    m_testedNodes = 0;
+    m_planeTests = 0;
+    m_drawCalls = 0;
+    m_gpuCulled = false;
     
-    for (auto& chunk : m_chunks)
+    if (m_useQuadtree && m_quadtree.isBuilt())
     {
-        // Frustum culling
-        if (m_enableFrustumCulling)
+        std::vector<uint8_t>& rejectPlanes = m_rejectPlanes[std::min(m_cullPass, CULL_CACHE_PASSES - 1)];
+        if (rejectPlanes.size() != static_cast<size_t>(m_quadtree.getNodeCount()))
         {
-            if (!m_frustum.isBoxVisible(chunk.getMin(), chunk.getMax()))
+            rejectPlanes.assign(m_quadtree.getNodeCount(), Frustum::PLANE_COUNT);
+        }
+        renderNode(m_quadtree.getRoot(), cameraPos, Frustum::ALL_PLANES);
+    }
+    else if (!renderChunksGPU(shader, cameraPos, viewProjection))
+    {
+        renderChunks(cameraPos, m_enableHorizonCulling ? &viewProjection : nullptr);
+    }
+    
+    // Everything queued above goes out as one indirect draw per index type
+    if (m_multiDraw)
+    {
+        m_drawCalls += m_drawArena.flush();
+    }
+    m_cullPass++;
+}
+
+TerrainSeamMode ChunkedTerrain::getSeamMode() const
+{
+    // Skirt indices past the vertices would read other meshes' (or no) vertices; until the
+    // terrain is regenerated with skirts, stitching hides the seams instead
+    if (m_seamMode == TerrainSeamMode::Skirt && !m_skirts) return TerrainSeamMode::Stitch;
+    return m_seamMode;
+}
+
+void ChunkedTerrain::renderChunks(const glm::vec3& cameraPos, const glm::mat4* horizonViewProjection)
+{
+    if (!m_streaming)
+    {
+        selectLODs(cameraPos);
+    }
+    
+    TerrainSeamMode seamMode = getSeamMode();
+    bool skirts = seamMode == TerrainSeamMode::Skirt;
+    bool stitch = seamMode == TerrainSeamMode::Stitch;
+    
+    // Fallback bounds match the full chunk's, and stay resident
+    std::vector<TerrainChunk>& bounds = m_streaming ? m_fallbackChunks : m_chunks;
+    
+    // Frustum culling: one batch test over the SoA copy of the bounds
+    bool frustum = m_enableFrustumCulling;
+    if (frustum)
+    {
+        if (m_chunkBoundsDirty || m_chunkBounds.size() != bounds.size())
+        {
+            m_chunkBounds.resize(bounds.size(), m_chunksPerRow);
+            for (size_t i = 0; i < bounds.size(); i++)
             {
-                continue;
+                m_chunkBounds.set(i, bounds[i].getMin(), bounds[i].getMax());
             }
+            m_chunkBoundsDirty = false;
+        }
+        m_chunkBounds.cull(m_frustum, m_frustumMask, m_enableSIMD ? TerrainChunkBounds::Path::AVX2 : TerrainChunkBounds::Path::Scalar);
+        m_testedNodes += static_cast<int>(bounds.size());
+        m_planeTests += static_cast<int>(m_chunkBounds.getPlaneTests());
+    }
+    
+    // Horizon culling walks outward from the eye, so it takes the frustum results up front
+    TerrainHorizonCuller::View horizonView;
+    bool horizon = horizonViewProjection && getHorizonView(*horizonViewProjection, horizonView);
+    if (horizon)
+    {
+        m_chunkVisible.resize(bounds.size());
+        for (size_t i = 0; i < bounds.size(); i++)
+        {
+            m_chunkVisible[i] = !frustum || TerrainChunkBounds::isVisible(m_frustumMask, i) ? 1 : 0;
+        }
+        m_occludedChunks = m_horizonCuller.cull(bounds, m_chunksPerRow, m_chunksPerCol, horizonView, m_chunkVisible);
+    }
+    
+    for (size_t i = 0; i < m_chunks.size(); i++)
+    {
+        TerrainChunk& chunk = bounds[i];
+        
+        if (horizon ? !m_chunkVisible[i] : frustum && !TerrainChunkBounds::isVisible(m_frustumMask, i))
+        {
+            continue;
         }
         
-        // Calculate LOD based on distance
-        int lod = 0;
-        if (m_enableLOD)
+        if (m_streaming)
         {
-            float distance = glm::distance(cameraPos, chunk.getCenter());
-            lod = calculateLOD(distance);
+            renderStreamedChunk(static_cast<int>(i), cameraPos);
+            continue;
         }
         
-        chunk.render(lod);
+        int lod = m_chunkLODs[i];
+        unsigned int stitchMask = stitch ? getStitchMask(static_cast<int>(i)) : 0;
+        
+        drawMesh(chunk, lod, stitchMask, skirts);
         m_visibleChunks++;
-        m_renderedTriangles += chunk.getTriangleCount(lod);
     }
 }
 
+bool ChunkedTerrain::getHorizonView(const glm::mat4& viewProjection, TerrainHorizonCuller::View& view) const
+{
+    if (m_chunks.empty() || m_chunksPerRow <= 0) return false;
+    
+    // The eye of the pass itself (the water reflection mirrors it), from the projection's
+    // centre: the point every clip-space w = 0 plane passes through
+    glm::vec4 eye = glm::inverse(viewProjection) * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+    if (std::abs(eye.w) < 1e-12f) return false;     // orthographic
+    view.eye = glm::vec3(eye) / eye.w;
+    
+    const std::vector<TerrainChunk>& bounds = m_streaming ? m_fallbackChunks : m_chunks;
+    glm::vec3 gridMin = bounds.front().getMin();
+    glm::vec3 gridMax = bounds.back().getMax();
+    if (view.eye.x < gridMin.x || view.eye.x > gridMax.x || view.eye.z < gridMin.z || view.eye.z > gridMax.z)
+    {
+        return false;
+    }
+    
+    // Only a horizontal plane (water) keeps a half-space the walk can reason about
+    view.clipMode = TerrainHorizonCuller::CLIP_NONE;
+    view.clipHeight = 0.0f;
+    if (m_clipPlane != glm::vec4(0.0f))
+    {
+        if (m_clipPlane.x != 0.0f || m_clipPlane.z != 0.0f || m_clipPlane.y == 0.0f) return false;
+        view.clipMode = m_clipPlane.y > 0.0f ? TerrainHorizonCuller::CLIP_KEEP_ABOVE : TerrainHorizonCuller::CLIP_KEEP_BELOW;
+        view.clipHeight = -m_clipPlane.w / m_clipPlane.y;
+    }
+    
+    int width = m_heightmap.getWidth();
+    int height = m_heightmap.getGridHeight();
+    float cellSize = m_size / static_cast<float>(width - 1);
+    view.heightTolerance = m_maxHeight / 65535.0f;
+    // Streamed chunks draw skirts whatever the seam mode
+    bool skirts = m_streaming || getSeamMode() == TerrainSeamMode::Skirt;
+    view.skirtCellSize = !skirts ? 0.0f
+                       : cellSize * static_cast<float>(1 << (m_streaming ? FALLBACK_SAMPLE_LEVEL : 0));
+    
+    // Where the surface around the eye is drawn, the eye must be above it. The triangle under
+    // the eye spans at most one cell of the coarsest LOD drawn there (stitched edges take the
+    // neighbour's), so the texels within that distance bound it
+    bool eyeClipped = (view.clipMode == TerrainHorizonCuller::CLIP_KEEP_ABOVE && view.eye.y < view.clipHeight) ||
+                      (view.clipMode == TerrainHorizonCuller::CLIP_KEEP_BELOW && view.eye.y > view.clipHeight);
+    if (!eyeClipped)
+    {
+        int x = static_cast<int>((view.eye.x + m_size * 0.5f) / cellSize);
+        int z = static_cast<int>((view.eye.z + m_size * 0.5f) / cellSize);
+        int lod = TerrainChunk::LOD_LEVELS - 1;
+        if (!m_streaming)
+        {
+            int chunkX = std::min(x / m_chunkSize, m_chunksPerRow - 1);
+            int chunkZ = std::min(z / m_chunkSize, m_chunksPerCol - 1);
+            lod = 0;
+            for (int nz = std::max(chunkZ - 1, 0); nz <= std::min(chunkZ + 1, m_chunksPerCol - 1); nz++)
+            {
+                for (int nx = std::max(chunkX - 1, 0); nx <= std::min(chunkX + 1, m_chunksPerRow - 1); nx++)
+                {
+                    lod = std::max(lod, m_chunkLODs[nz * m_chunksPerRow + nx]);
+                }
+            }
+        }
+        int radius = 1 << lod;
+        float minHeight, maxHeight;
+        m_heightmap.getHeightRange(std::max(x - radius, 0), std::max(z - radius, 0),
+                                   std::min(x + radius + 1, width - 1), std::min(z + radius + 1, height - 1),
+                                   minHeight, maxHeight);
+        if (view.eye.y <= maxHeight * m_maxHeight + view.heightTolerance) return false;
+    }
+    return true;
+}
+
+bool ChunkedTerrain::renderChunksGPU(Shader& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection)
+{
+    // The commands index the arena, and only the plain chunk grid is culled on the GPU
+    if (!m_enableGPUCulling || !m_multiDraw || m_streaming || !m_gpuCuller.isAvailable()) return false;
+    
+    if (m_gpuChunksDirty)
+    {
+        if (!m_gpuCuller.setChunks(m_chunks, m_chunksPerRow, m_chunksPerCol)) return false;
+        m_gpuChunksDirty = false;
+    }
+    
+    TerrainGPUCuller::Params params;
+    params.cameraPos = cameraPos;
+    params.frustum = m_enableFrustumCulling ? &m_frustum : nullptr;
+    params.lodMode = !m_enableLOD ? TerrainGPUCuller::LOD_FIXED
+                   : (m_useScreenSpaceError && m_pixelsPerRadian > 0.0f) ? TerrainGPUCuller::LOD_SCREEN_SPACE
+                   : TerrainGPUCuller::LOD_DISTANCE;
+    params.pixelsPerRadian = m_pixelsPerRadian;
+    params.pixelErrorThreshold = m_pixelErrorThreshold;
+    params.lodDistances = m_lodDistances;
+    TerrainSeamMode seamMode = getSeamMode();
+    params.seamMode = seamMode == TerrainSeamMode::Stitch ? TerrainGPUCuller::SEAM_STITCH
+                    : seamMode == TerrainSeamMode::Skirt ? TerrainGPUCuller::SEAM_SKIRT
+                    : TerrainGPUCuller::SEAM_NONE;
+    params.viewProjection = viewProjection;
+    
+    // Occlusion would make the draws differ from the CPU path's, so verification goes without
+    bool occlusion = m_enableHiZCulling && !m_verifyGPUCulling && m_occluderDistance > 0.0f && !m_chunks.empty();
+    params.occluderDistance = 0.0f;
+    if (occlusion)
+    {
+        glm::vec3 chunkExtent = m_chunks[0].getMax() - m_chunks[0].getMin();
+        params.occluderDistance = m_occluderDistance * std::max(chunkExtent.x, chunkExtent.z);
+    }
+    
+    int pass = m_gpuCullPass++;
+    m_gpuCuller.beginCull(params);
+    
+    // The nearest chunks go into this view's depth pyramid first; the rest are tested against it
+    const TerrainHiZBuffer* hiZ = nullptr;
+    if (occlusion && m_hiZ.begin())
+    {
+        shader.use();
+        m_drawCalls += m_gpuCuller.drawOccluders(m_drawArena);
+        m_hiZ.end();
+        hiZ = &m_hiZ;
+    }
+    m_gpuCuller.finishCull(params, hiZ, pass);
+    shader.use();
+    
+    if (m_verifyGPUCulling)
+    {
+        verifyGPUCulling(cameraPos);
+    }
+    else
+    {
+        // Counters come back a frame or so late rather than stalling the pipeline
+        TerrainGPUCuller::Stats stats = m_gpuCuller.getStats(pass);
+        m_visibleChunks = stats.visibleChunks;
+        m_renderedTriangles = stats.triangles;
+        m_occludedChunks = stats.occludedChunks;
+        m_testedNodes = m_enableFrustumCulling ? static_cast<int>(m_chunks.size()) : 0;
+    }
+    
+    m_drawCalls += m_gpuCuller.draw(m_drawArena);
+    m_gpuCulled = true;
+    return true;
+}
+
+void ChunkedTerrain::verifyGPUCulling(const glm::vec3& cameraPos)
+{
+    std::vector<TerrainDrawArena::DrawCommand> gpuDraws[2];
+    std::vector<TerrainDrawArena::DrawCommand> cpuDraws[2];
+    TerrainGPUCuller::Stats gpuStats;
+    m_gpuCuller.readBack(gpuDraws[0], gpuDraws[1], gpuStats);
+    
+    // The CPU path queues the same chunks into the arena; they are taken back out, not drawn
+    renderChunks(cameraPos, nullptr);
+    m_drawArena.takeDraws(cpuDraws[0], cpuDraws[1]);
+    
+    // Append order on the GPU is arbitrary
+    auto less = [](const TerrainDrawArena::DrawCommand& a, const TerrainDrawArena::DrawCommand& b)
+    {
+        return std::tie(a.baseVertex, a.firstIndex, a.count) < std::tie(b.baseVertex, b.firstIndex, b.count);
+    };
+    auto equal = [](const TerrainDrawArena::DrawCommand& a, const TerrainDrawArena::DrawCommand& b)
+    {
+        return a.count == b.count && a.instanceCount == b.instanceCount && a.firstIndex == b.firstIndex &&
+               a.baseVertex == b.baseVertex && a.baseInstance == b.baseInstance;
+    };
+    bool match = gpuStats.visibleChunks == m_visibleChunks && gpuStats.triangles == m_renderedTriangles;
+    for (int type = 0; type < 2; type++)
+    {
+        std::sort(gpuDraws[type].begin(), gpuDraws[type].end(), less);
+        std::sort(cpuDraws[type].begin(), cpuDraws[type].end(), less);
+        match = match && std::equal(gpuDraws[type].begin(), gpuDraws[type].end(),
+                                    cpuDraws[type].begin(), cpuDraws[type].end(), equal);
+    }
+    if (match) return;
+    
+    // Logged once per build; the count keeps going
+    if (m_gpuCullingMismatches++ == 0)
+    {
+        std::cerr << "ERROR::CHUNKED_TERRAIN::GPU_CULLING_MISMATCH: GPU " << gpuDraws[0].size() + gpuDraws[1].size()
+                  << " draws, " << gpuStats.visibleChunks << " chunks, " << gpuStats.triangles << " triangles; CPU "
+                  << cpuDraws[0].size() + cpuDraws[1].size() << " draws, " << m_visibleChunks << " chunks, "
+                  << m_renderedTriangles << " triangles" << std::endl;
+    }
+}
+
+void ChunkedTerrain::renderNode(int nodeIndex, const glm::vec3& cameraPos, unsigned int planeMask)
+{
+    const TerrainQuadtree::Node& node = m_quadtree.getNode(nodeIndex);
+    
+    // A node outside the frustum rejects its whole subtree; planes a node is inside are dropped
+    // for its children, and below a node inside all six nothing is tested at all
+    if (m_enableFrustumCulling && planeMask != 0)
+    {
+        m_testedNodes++;
+        m_planeTests += static_cast<int>(std::bitset<Frustum::PLANE_COUNT>(planeMask).count());
+        uint8_t& lastPlane = m_rejectPlanes[std::min(m_cullPass, CULL_CACHE_PASSES - 1)][nodeIndex];
+        if (m_frustum.classifyBox(node.min, node.max, planeMask, lastPlane) == Frustum::OUTSIDE)
+        {
+            return;
+        }
+    }
+    
+    // Neighbours may be drawn at different levels, so quadtree mode always hides seams with skirts
+    if (node.chunk >= 0 && m_streaming)
+    {
+        renderStreamedChunk(node.chunk, cameraPos);
+        return;
+    }
+    
+    int lod = calculateNodeLOD(node, cameraPos);
+    if (node.chunk >= 0 || lod >= 0)
+    {
+        TerrainChunk& mesh = node.chunk >= 0 ? m_chunks[node.chunk] : m_nodeMeshes[node.mesh];
+        drawMesh(mesh, std::max(lod, 0), 0, true);
+        
+        // Count the chunks covered, so culled = total - visible still holds
+        int chunksX = (node.sizeX + m_chunkSize - 1) / m_chunkSize;
+        int chunksZ = (node.sizeZ + m_chunkSize - 1) / m_chunkSize;
+        m_visibleChunks += chunksX * chunksZ;
+        return;
+    }
+    
+    for (int child : node.children)
+    {
+        if (child >= 0)
+        {
+            renderNode(child, cameraPos, planeMask);
+        }
+    }
+}
+
+void ChunkedTerrain::renderStreamedChunk(int chunkIndex, const glm::vec3& cameraPos)
+{
+    TerrainChunk& fallback = m_fallbackChunks[chunkIndex];
+    TerrainChunk& chunk = m_chunks[chunkIndex];
+    
+    // Far chunks never need their full mesh: the fallback is as dense as LOD 3
+    int fallbackLOD = -1;
+    if (m_enableLOD && m_useScreenSpaceError && m_pixelsPerRadian > 0.0f)
+    {
+        fallbackLOD = findCoarsestLOD(fallback, cameraPos);
+    }
+    else if (m_enableLOD)
+    {
+        int lod = calculateLOD(glm::distance(cameraPos, fallback.getCenter()));
+        fallbackLOD = lod >= FALLBACK_SAMPLE_LEVEL ? lod - FALLBACK_SAMPLE_LEVEL : -1;
+    }
+    
+    TerrainChunk* mesh = &fallback;
+    int lod = std::max(fallbackLOD, 0);
+    if (fallbackLOD < 0)
+    {
+        if (m_streamer.isResident(chunkIndex))
+        {
+            m_streamer.touch(chunkIndex);
+            mesh = &chunk;
+            lod = !m_enableLOD ? 0
+                : (m_useScreenSpaceError && m_pixelsPerRadian > 0.0f) ? calculateLOD(chunk, cameraPos)
+                : calculateLOD(glm::distance(cameraPos, chunk.getCenter()));
+        }
+        else
+        {
+            // Draw the fallback until the full mesh arrives; nearest chunks are built first
+            glm::vec3 closest = glm::clamp(cameraPos, fallback.getMin(), fallback.getMax());
+            m_streamer.request(chunkIndex, glm::distance(cameraPos, closest));
+        }
+    }
+    
+    // Neighbours may come from different meshes, so streamed chunks hide seams with skirts
+    drawMesh(*mesh, lod, 0, true);
+    m_visibleChunks++;
+}
+
+void ChunkedTerrain::drawMesh(TerrainChunk& mesh, int lod, unsigned int stitchMask, bool skirts)
+{
+    // Only queued when multi-drawing; render() counts the flush instead
+    mesh.render(lod, stitchMask, skirts);
+    m_renderedTriangles += mesh.getTriangleCount(lod, stitchMask, skirts);
+    if (!m_multiDraw) m_drawCalls++;
+}
+
+int ChunkedTerrain::calculateNodeLOD(const TerrainQuadtree::Node& node, const glm::vec3& cameraPos) const
+{
+    bool leaf = node.chunk >= 0;
+    if (!m_enableLOD) return leaf ? 0 : -1;
+    
+    if (m_useScreenSpaceError && m_pixelsPerRadian > 0.0f)
+    {
+        return findCoarsestLOD(leaf ? m_chunks[node.chunk] : m_nodeMeshes[node.mesh], cameraPos);
+    }
+    
+    if (leaf) return calculateLOD(glm::distance(cameraPos, m_chunks[node.chunk].getCenter()));
+    
+    // A level-L node at LOD k has the vertex spacing of a leaf at LOD L + k; use it once
+    // every chunk below would be at least that coarse
+    glm::vec3 closest = glm::clamp(cameraPos, node.min, node.max);
+    int leafLOD = calculateLOD(glm::distance(cameraPos, closest));
+    return leafLOD >= node.level ? leafLOD - node.level : -1;
+}
+
+void ChunkedTerrain::selectLODs(const glm::vec3& cameraPos)
+{
+    // LODs are chosen for culled chunks too, since visible neighbours stitch against them
+    for (size_t i = 0; i < m_chunks.size(); i++)
+    {
+        if (!m_enableLOD)
+        {
+            m_chunkLODs[i] = 0;
+        }
+        else if (m_useScreenSpaceError && m_pixelsPerRadian > 0.0f)
+        {
+            m_chunkLODs[i] = calculateLOD(m_chunks[i], cameraPos);
+        }
+        else
+        {
+            m_chunkLODs[i] = calculateLOD(glm::distance(cameraPos, m_chunks[i].getCenter()));
+        }
+    }
+    
+    if (getSeamMode() != TerrainSeamMode::Stitch || !m_enableLOD) return;
+    
+    // Limit neighbours to one LOD apart: lod = min(lod, neighbour + 1) is a city-block
+    // distance transform, exact after one forward and one backward pass
+    int cols = m_chunksPerRow;
+    int rows = m_chunksPerCol;
+    for (int z = 0; z < rows; z++)
+    {
+        for (int x = 0; x < cols; x++)
+        {
+            int& lod = m_chunkLODs[z * cols + x];
+            if (x > 0) lod = std::min(lod, m_chunkLODs[z * cols + x - 1] + 1);
+            if (z > 0) lod = std::min(lod, m_chunkLODs[(z - 1) * cols + x] + 1);
+        }
+    }
+    for (int z = rows - 1; z >= 0; z--)
+    {
+        for (int x = cols - 1; x >= 0; x--)
+        {
+            int& lod = m_chunkLODs[z * cols + x];
+            if (x < cols - 1) lod = std::min(lod, m_chunkLODs[z * cols + x + 1] + 1);
+            if (z < rows - 1) lod = std::min(lod, m_chunkLODs[(z + 1) * cols + x] + 1);
+        }
+    }
+}
+
+unsigned int ChunkedTerrain::getStitchMask(int chunkIndex) const
+{
+    int x = chunkIndex % m_chunksPerRow;
+    int z = chunkIndex / m_chunksPerRow;
+    int lod = m_chunkLODs[chunkIndex];
+    
+    unsigned int mask = 0;
+    if (z > 0 && m_chunkLODs[chunkIndex - m_chunksPerRow] > lod) mask |= TerrainIndexCache::EDGE_NEG_Z;
+    if (z < m_chunksPerCol - 1 && m_chunkLODs[chunkIndex + m_chunksPerRow] > lod) mask |= TerrainIndexCache::EDGE_POS_Z;
+    if (x > 0 && m_chunkLODs[chunkIndex - 1] > lod) mask |= TerrainIndexCache::EDGE_NEG_X;
+    if (x < m_chunksPerRow - 1 && m_chunkLODs[chunkIndex + 1] > lod) mask |= TerrainIndexCache::EDGE_POS_X;
+    return mask;
+}
+
 int ChunkedTerrain::calculateLOD(float distance) const
 {
     for (int i = 0; i < 4; i++)
@@ -125,6 +1122,201 @@ int ChunkedTerrain::calculateLOD(float distance) const
     return 3;
 }
 
+void ChunkedTerrain::setPackedVertexUniforms(Shader& shader) const
+{
+    bool packed = m_vertexFormat == TerrainVertexFormat::Packed;
+    shader.setBool("uPackedVertices", packed);
+    if (!packed) return;
+    
+    // Inverse of the encoding in TerrainChunk::buildVertices
+    float gridW = static_cast<float>(m_heightmap.getWidth() - 1);
+    float gridH = static_cast<float>(m_heightmap.getGridHeight() - 1);
+    shader.setVec2("uPackedOrigin", glm::vec2(-m_size * 0.5f));
+    shader.setFloat("uPackedCellSize", m_size / gridW);
+    shader.setFloat("uPackedHeightScale", m_maxHeight);
+    shader.setVec2("uPackedUVScale", glm::vec2(1.0f / gridW, 1.0f / gridH));
+}
+
+int ChunkedTerrain::calculateLOD(const TerrainChunk& chunk, const glm::vec3& cameraPos) const
+{
+    return std::max(findCoarsestLOD(chunk, cameraPos), 0);
+}
+
+int ChunkedTerrain::findCoarsestLOD(const TerrainChunk& chunk, const glm::vec3& cameraPos) const
+{
+    // Nearest point of the chunk bounds, so the error is never underestimated
+    glm::vec3 closest = glm::clamp(cameraPos, chunk.getMin(), chunk.getMax());
+    float distance = glm::distance(cameraPos, closest);
+    if (distance <= 0.0f) return -1;
+    
+    // Coarsest LOD whose projected error stays under the threshold, -1 if none does
+    float pixelsPerUnit = m_pixelsPerRadian / distance;
+    for (int lod = TerrainChunk::LOD_LEVELS - 1; lod >= 0; lod--)
+    {
+        if (chunk.getLODError(lod) * pixelsPerUnit <= m_pixelErrorThreshold)
+        {
+            return lod;
+        }
+    }
+    return -1;
+}
+
+bool ChunkedTerrain::sculpt(const glm::vec3& center, const TerrainBrush& brush, float deltaTime)
+{
+    if (!m_generated || !m_heightmap.isEditable()) return false;
+    
+    auto sculptStart = std::chrono::steady_clock::now();
+    int width = m_heightmap.getWidth();
+    int height = m_heightmap.getGridHeight();
+    
+    TerrainSculptor sculptor(m_heightmap, m_size, m_maxHeight);
+    TerrainTexelRect footprint;
+    if (!sculptor.getFootprint(brush, center.x, center.z, footprint)) return false;
+    
+    // Vertices whose height or normal (central differences) reads a changed texel
+    int vx0 = std::max(0, footprint.x0 - 1), vz0 = std::max(0, footprint.z0 - 1);
+    int vx1 = std::min(width - 1, footprint.x1 + 1), vz1 = std::min(height - 1, footprint.z1 + 1);
+    auto touches = [&](const ChunkRegion& r)
+    {
+        return r.startX <= vx1 && r.startX + r.sizeX >= vx0 && r.startZ <= vz1 && r.startZ + r.sizeZ >= vz0;
+    };
+    
+    // Chunk (cx, cz) spans texels [cx * size, (cx + 1) * size], sharing its edges with neighbours
+    std::vector<int> dirtyLeaves;
+    int cx0 = std::max(0, (vx0 + m_chunkSize - 1) / m_chunkSize - 1);
+    int cz0 = std::max(0, (vz0 + m_chunkSize - 1) / m_chunkSize - 1);
+    int cx1 = std::min(m_chunksPerRow - 1, vx1 / m_chunkSize);
+    int cz1 = std::min(m_chunksPerCol - 1, vz1 / m_chunkSize);
+    for (int cz = cz0; cz <= cz1; cz++)
+    {
+        for (int cx = cx0; cx <= cx1; cx++)
+        {
+            int index = cz * m_chunksPerRow + cx;
+            if (touches(m_regions[index])) dirtyLeaves.push_back(index);
+        }
+    }
+    
+    // Streaming builds read the heightmap; none may run (or be uploaded stale) across the edit
+    if (m_streaming)
+    {
+        m_streamer.invalidate(dirtyLeaves);
+    }
+    
+    TerrainTexelRect changed;
+    if (!sculptor.apply(brush, center.x, center.z, deltaTime, changed)) return false;
+    
+    // Every mesh covering the dirty vertices: leaves (resident full chunks and fallbacks when
+    // streaming), then quadtree node meshes
+    struct Refresh
+    {
+        ChunkRegion region;
+        TerrainChunk* chunk;
+    };
+    std::vector<Refresh> refreshes;
+    for (int index : dirtyLeaves)
+    {
+        ChunkRegion full = m_regions[index];
+        if (m_streaming)
+        {
+            refreshes.push_back({ full, &m_fallbackChunks[index] });
+            full.sampleLevel = 0;
+            if (!m_chunks[index].isGenerated()) continue;
+        }
+        refreshes.push_back({ full, &m_chunks[index] });
+    }
+    for (size_t i = m_leafCount; i < m_regions.size(); i++)
+    {
+        if (touches(m_regions[i])) refreshes.push_back({ m_regions[i], &m_nodeMeshes[i - m_leafCount] });
+    }
+    
+    // Each mesh rebuilds only the vertices over the edit, and rechecks its LOD errors only over
+    // the changed texels (the root covers the whole map); the old errors stay as a floor
+    glm::ivec4 changedRect(changed.x0, changed.z0, changed.x1, changed.z1);
+    std::vector<TerrainChunkPatch> patches(refreshes.size());
+    for (size_t i = 0; i < refreshes.size(); i++)
+    {
+        const TerrainChunk& chunk = *refreshes[i].chunk;
+        for (int lod = 0; lod < TerrainChunk::LOD_LEVELS; lod++)
+        {
+            patches[i].lodErrors[lod] = chunk.getLODError(lod);
+        }
+        patches[i].min = chunk.getMin();
+        patches[i].max = chunk.getMax();
+    }
+    auto buildOne = [&](size_t i)
+    {
+        const ChunkRegion& r = refreshes[i].region;
+        TerrainChunk::buildPatch(m_heightmap, m_normalPath, r.startX, r.startZ, r.sizeX, r.sizeZ, m_size, m_maxHeight,
+                                 m_vertexFormat, m_skirts, r.sampleLevel, changedRect, patches[i]);
+    };
+    ThreadPool* workers = getWorkers();
+    if (workers)
+    {
+        workers->parallelFor(refreshes.size(), buildOne);
+    }
+    else
+    {
+        for (size_t i = 0; i < refreshes.size(); i++) buildOne(i);
+    }
+    
+    for (size_t i = 0; i < refreshes.size(); i++)
+    {
+        refreshes[i].chunk->applyPatch(patches[i]);
+    }
+    
+    if (m_useQuadtree)
+    {
+        m_quadtree.updateBounds(m_streaming ? m_fallbackChunks : m_chunks, m_nodeMeshes);
+    }
+    
+    m_gpuChunksDirty = true;
+    m_chunkBoundsDirty = true;
+    m_sculptedMeshes = static_cast<int>(refreshes.size());
+    m_sculptTimeMs = elapsedMs(sculptStart);
+    return true;
+}
+
+bool ChunkedTerrain::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                             TerrainRayHit& hit) const
+{
+    if (!m_generated) return false;
+    
+    TerrainRaycast caster(m_heightmap, m_size, m_maxHeight);
+    return caster.cast(origin, direction, maxDistance, hit);
+}
+
+void ChunkedTerrain::raycastBatch(const glm::vec3* origins, const glm::vec3* directions, size_t count,
+                                  float maxDistance, TerrainRayHit* hits, uint8_t* hitFlags)
+{
+    if (!m_generated || count == 0) return;
+    
+    TerrainRaycast caster(m_heightmap, m_size, m_maxHeight);
+    
+    // Rays go out in blocks so each task amortizes its scheduling cost
+    const size_t blockSize = 64;
+    size_t blocks = (count + blockSize - 1) / blockSize;
+    auto castBlock = [&](size_t block)
+    {
+        size_t end = std::min(count, (block + 1) * blockSize);
+        for (size_t i = block * blockSize; i < end; i++)
+        {
+            bool hit = caster.cast(origins[i], directions[i], maxDistance, hits[i]);
+            if (!hit) hits[i] = { maxDistance, origins[i], glm::vec3(0.0f, 1.0f, 0.0f) };
+            if (hitFlags) hitFlags[i] = hit ? 1 : 0;
+        }
+    };
+    
+    ThreadPool* workers = getWorkers();
+    if (workers && blocks > 1)
+    {
+        workers->parallelFor(blocks, castBlock);
+    }
+    else
+    {
+        for (size_t b = 0; b < blocks; b++) castBlock(b);
+    }
+}
+
 float ChunkedTerrain::getHeightAt(float worldX, float worldZ) const
 {
     if (!m_generated) return 0.0f;
@@ -138,3 +1330,17 @@ float ChunkedTerrain::getHeightAt(float worldX, float worldZ) const
     
     return m_heightmap.getHeightInterpolated(pixelX, pixelZ) * m_maxHeight;
 }
+
+void ChunkedTerrain::getHeightsAt(const float* worldX, const float* worldZ, size_t count,
+                                  float* heights, glm::vec3* normals) const
+{
+    if (!m_generated)
+    {
+        std::fill(heights, heights + count, 0.0f);
+        if (normals) std::fill(normals, normals + count, glm::vec3(0.0f, 1.0f, 0.0f));
+        return;
+    }
+    
+    TerrainSampler sampler(m_heightmap, m_size, m_maxHeight, m_enableSIMD);
+    sampler.sample(worldX, worldZ, count, heights, normals);
+}
@@ -9,12 +9,39 @@
 
 #include "HeightmapLoader.h"
 #include "TerrainChunk.h"
+#include "TerrainChunkBounds.h"
+#include "TerrainDrawArena.h"
+#include "TerrainGPUCuller.h"
+#include "TerrainHorizonCuller.h"
+#include "TerrainIndexCache.h"
+#include "TerrainMeshCache.h"
+#include "TerrainNormalField.h"
+#include "TerrainQuadtree.h"
+#include "TerrainRaycast.h"
+#include "TerrainSampler.h"
+#include "TerrainSculptor.h"
+#include "TerrainStreamer.h"
 #include "Frustum.h"
 #include "Core/Shader.h"
+#include "Core/ThreadPool.h"
 #include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <string>
 
+enum class TerrainSeamMode
+{
+    None,       // independent LODs, cracks where neighbours differ
+    Stitch,     // neighbours limited to one LOD apart, finer edges snapped to the coarser one
+    Skirt       // independent LODs, gaps hidden by vertical skirts
+};
+
 class ChunkedTerrain
 {
 public:
@@ -23,10 +50,72 @@ public:
     
     bool generate(const std::string& heightmapPath, float size, float maxHeight, int chunkSize = 64);
     
+    // Rebuild from the last heightmap with the current options (e.g. vertex format)
+    bool regenerate();
+    
+    /**
+     * @brief generate() on a background thread, for a terrain that is not being rendered yet
+     *
+     * Loading, normals and mesh building run off-thread; pumpGenerate() uploads the finished
+     * meshes on the GL thread a few at a time. Call nothing else on this instance until
+     * pumpGenerate() has returned true, other than the cancel calls below.
+     */
+    void generateAsync(const std::string& heightmapPath, float size, float maxHeight, int chunkSize = 64);
+    
+    // GL thread, once per frame: upload up to m_uploadsPerFrame meshes; true once finished (or failed)
+    bool pumpGenerate();
+    bool isGenerating() const { return m_generateThread.joinable(); }
+    
+    // Ask a generateAsync() build to stop without waiting for it
+    void requestCancelGenerate();
+    // After requestCancelGenerate(): true once the build thread has stopped (it is joined then)
+    bool pollCancelGenerate();
+    float getGenerateProgress() const;
+    
+    // Copy the public options (and view parameters) of another instance, e.g. before a rebuild
+    void copyOptions(const ChunkedTerrain& other);
+    
     void render(Shader& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection);
     
+    // Per-frame streaming work (uploads, eviction); once per frame before rendering
+    void update();
+    
+    // Projection used to turn LOD errors into pixels; set before each pass
+    void setViewParameters(float fovYRadians, int viewportHeight);
+    
+    // Plane (a, b, c, d) the pass clips against (gl_ClipDistance[0]); zero for none
+    void setClipPlane(const glm::vec4& plane) { m_clipPlane = plane; }
+    
     float getHeightAt(float worldX, float worldZ) const;
     
+    /**
+     * @brief getHeightAt for count positions at once (SIMD when enabled)
+     * @param normals Optional, interpolated surface normals
+     */
+    void getHeightsAt(const float* worldX, const float* worldZ, size_t count,
+                      float* heights, glm::vec3* normals = nullptr) const;
+    
+    /**
+     * @brief One brush step at world (center.x, center.z), edited into the heightmap in place
+     *
+     * Rebuilds only the chunks (and quadtree node meshes) whose vertices read the changed
+     * heights or normals, neighbours' borders included, and re-uploads just their changed
+     * vertex rows with glBufferSubData. GL thread.
+     * @return false if nothing changed (brush off the terrain, or a read-only tiled heightmap)
+     */
+    bool sculpt(const glm::vec3& center, const TerrainBrush& brush, float deltaTime);
+    
+    // First LOD 0 triangle hit within maxDistance (direction need not be normalized)
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TerrainRayHit& hit) const;
+    
+    /**
+     * @brief Cast count rays across the worker threads
+     * @param hits Written for every ray
+     * @param hitFlags Optional, set to 1 where a ray hit
+     */
+    void raycastBatch(const glm::vec3* origins, const glm::vec3* directions, size_t count, float maxDistance,
+                      TerrainRayHit* hits, uint8_t* hitFlags = nullptr);
+    
     float getSize() const { return m_size; }
     float getMaxHeight() const { return m_maxHeight; }
     bool isGenerated() const { return m_generated; }
@@ -36,29 +125,170 @@ public:
     int getTotalChunks() const { return static_cast<int>(m_chunks.size()); }
     int getVisibleChunks() const { return m_visibleChunks; }
     int getCulledChunks() const { return getTotalChunks() - m_visibleChunks; }
+    int getOccludedChunks() const { return m_occludedChunks; }  // in the frustum, rejected by the Hi-Z or horizon test
     int getRenderedTriangles() const { return m_renderedTriangles; }
     int getTotalVertices() const { return m_totalVertices; }
+    int getTestedNodes() const { return m_testedNodes; }
+    int getPlaneTests() const { return m_planeTests; }
+    int getDrawCalls() const { return m_drawCalls; }        // GL draw calls of the last render()
+    int getQuadtreeNodes() const { return m_quadtree.getNodeCount(); }
+    
+    int getSculptedMeshes() const { return m_sculptedMeshes; }    // refreshed by the last sculpt()
+    double getSculptTimeMs() const { return m_sculptTimeMs; }
+    
+    bool isStreaming() const { return m_streaming; }
+    bool hasSkirts() const { return m_skirts; }    // the meshes of the last generate() carry skirt vertices
+    // m_seamMode, or Stitch while Skirt is chosen but the meshes were generated without skirts
+    TerrainSeamMode getSeamMode() const;
+    const TerrainStreamer& getStreamer() const { return m_streamer; }
+    
+    // Mesh generation timing of the last generate() call
+    double getBuildTimeMs() const { return m_buildTimeMs; }
+    double getUploadTimeMs() const { return m_uploadTimeMs; }
+    const char* getNormalPathName() const { return CpuFeatures::getPathName(m_normalPath); }
     
-    float m_lodDistances[4] = { 100.0f, 200.0f, 400.0f, 800.0f };
+    size_t getIndexMemoryBytes() const { return m_indexCache.getMemoryBytes(); }
+    float getUnoptimizedACMR() const { return m_indexCache.getUnoptimizedACMR(); }
+    float getACMR() const { return m_indexCache.getACMR(); }
+    size_t getVertexMemoryBytes() const { return m_vertexMemoryBytes; }
+    size_t getHeightmapMemoryBytes() const { return m_heightmap.getMemoryBytes(); }
+    const char* getHeightStorageName() const { return m_heightmap.getStorageName(); }
+    const std::string& getHeightmapPath() const { return m_heightmapPath; }
+    bool isMeshCacheHit() const { return m_meshCacheHit; }     // last generate() uploaded cached meshes
+    bool isMultiDraw() const { return m_multiDraw; }
+    bool isGPUCulling() const { return m_gpuCulled; }         // the last render() culled on the GPU
+    int getGPUCullingMismatches() const { return m_gpuCullingMismatches; }
+    
+    float m_lodDistances[4] = { 40.0f, 80.0f, 160.0f, 320.0f };
     bool m_enableFrustumCulling = true;
     bool m_enableLOD = true;
+    TerrainSeamMode m_seamMode = TerrainSeamMode::Stitch;
+    bool m_useScreenSpaceError = true;  // otherwise m_lodDistances
+    float m_pixelErrorThreshold = 4.0f;
+    bool m_enableParallelBuild = true;
+    bool m_usePackedVertices = false;   // applied on the next generate()
+    HeightStorage m_heightStorage = HeightStorage::UInt16;  // CPU heightmap samples, applied on the next generate()
+    bool m_enableSIMD = true;           // AVX2/SSE2 chunk normals (next generate()), batched sampling and frustum culling
+    bool m_useQuadtree = false;         // hierarchical culling and coarse far nodes, applied on the next generate()
+    bool m_enableStreaming = false;     // page full chunks in around the camera, applied on the next generate()
+    int m_streamingBudgetMB = 256;      // resident full-chunk vertex memory
+    int m_uploadsPerFrame = 16;         // generateAsync(): meshes uploaded per pumpGenerate()
+    bool m_optimizeVertexCache = true;  // reorder index buffers for the post-transform cache, applied on the next generate()
+    bool m_enableMeshCache = false;     // reuse (or save) <heightmap>.meshcache beside the map, applied on the next generate()
+    bool m_useMultiDrawIndirect = true; // one vertex/index arena, one multi-draw per pass; applied on the next generate()
+    bool m_enableGPUCulling = false;    // compute-shader LOD selection and frustum culling (multi-draw, no quadtree or streaming)
+    bool m_verifyGPUCulling = false;    // also run the CPU path and compare its draws (stalls on the readback)
+    bool m_enableHiZCulling = false;    // GPU culling only: depth pre-pass of the near chunks, then a Hi-Z test of the rest
+    float m_occluderDistance = 2.0f;    // in chunk widths; chunks this close to the camera are the occluders
+    bool m_enableHorizonCulling = false;    // CPU chunk path: skip chunks below the horizon of nearer ones (no quadtree)
     
 private:
+    struct ChunkRegion
+    {
+        int startX;
+        int startZ;
+        int sizeX;
+        int sizeZ;
+        int sampleLevel;    // > 0 for coarse quadtree node meshes and streaming fallbacks
+    };
+    
     HeightmapLoader m_heightmap;
+    TerrainDrawArena m_drawArena;   // declared before the meshes allocated from it
+    TerrainIndexCache m_indexCache; // likewise: its EBOs must outlive the chunk VAOs bound to them
+    TerrainGPUCuller m_gpuCuller;
+    TerrainHiZBuffer m_hiZ;
+    TerrainChunkBounds m_chunkBounds;       // leaf bounds for the batch frustum test
+    std::vector<uint8_t> m_frustumMask;     // its result, one bit per chunk
+    // Last rejecting frustum plane per quadtree node, kept per pass
+    // (SSAO, reflection, refraction and main views differ) so each starts from its last frame
+    static const int CULL_CACHE_PASSES = 4;
+    std::vector<uint8_t> m_rejectPlanes[CULL_CACHE_PASSES];
+    TerrainHorizonCuller m_horizonCuller;
+    std::vector<uint8_t> m_chunkVisible;    // horizon culling: frustum, then horizon result per chunk
     std::vector<TerrainChunk> m_chunks;
+    TerrainQuadtree m_quadtree;
+    std::vector<TerrainChunk> m_nodeMeshes;     // coarse meshes of interior quadtree nodes
+    std::vector<TerrainChunk> m_fallbackChunks; // streaming: always-resident LOD 3 density chunks
+    TerrainStreamer m_streamer;
+    TerrainMeshCache m_meshCache;
     Frustum m_frustum;
+    std::string m_heightmapPath;
+    TerrainVertexFormat m_vertexFormat;
+    TerrainNormalField::Path m_normalPath;  // kernel the chunk builds compute their normals with
     
     float m_size;
     float m_maxHeight;
     int m_chunkSize;
     int m_chunksPerRow;
+    int m_chunksPerCol;
+    std::vector<int> m_chunkLODs;
+    std::vector<ChunkRegion> m_regions;     // leaf chunks first, then quadtree nodes
+    size_t m_leafCount;
+    float m_pixelsPerRadian;    // viewportHeight / (2 * tan(fovY / 2))
+    glm::vec4 m_clipPlane;
     bool m_generated;
+    bool m_streaming;
+    bool m_skirts;          // Skirt mode, streaming or quadtree at generate(); other meshes never draw skirts
+    bool m_meshCacheHit;
+    bool m_multiDraw;
+    bool m_gpuChunksDirty;  // m_gpuCuller needs the chunks again (rebuild, sculpt)
+    bool m_chunkBoundsDirty;    // m_chunkBounds needs the chunks again (rebuild, sculpt)
+    bool m_gpuCulled;
+    int m_gpuCullPass;      // GPU-culled passes this frame, reset by update()
+    int m_cullPass;         // render() calls this frame, reset by update(); picks m_rejectPlanes
+    int m_gpuCullingMismatches;
     
     int m_visibleChunks;
+    int m_occludedChunks;
     int m_renderedTriangles;
     int m_totalVertices;
+    int m_testedNodes;      // bounding boxes frustum-tested in the last render()
+    int m_planeTests;       // planes left to test per tested box (the chunk batch counts every SIMD lane)
+    int m_drawCalls;
+    
+    double m_buildTimeMs;
+    double m_uploadTimeMs;
+    double m_sculptTimeMs;
+    int m_sculptedMeshes;
+    size_t m_vertexMemoryBytes;
+    std::unique_ptr<ThreadPool> m_workers;
+    
+    // generateAsync(): built meshes wait in m_readyMeshes (bounded) for pumpGenerate()
+    std::thread m_generateThread;
+    mutable std::mutex m_generateMutex;
+    std::condition_variable m_generateCondition;
+    std::deque<std::pair<size_t, TerrainChunkData>> m_readyMeshes;
+    size_t m_uploadedMeshes;
+    size_t m_pendingMeshes;     // total to upload, known once the heightmap is loaded
+    bool m_buildFinished;
+    bool m_buildFailed;
+    std::atomic<bool> m_cancelGenerate;
+    
+    void releaseMeshes();
+    bool prepareGenerate(const std::string& heightmapPath, float size, float maxHeight, int chunkSize);
+    void buildMeshes(size_t first, std::vector<TerrainChunkData>& batch, ThreadPool* workers);
+    void uploadMesh(size_t index, const TerrainChunkData& data);
+    void uploadCachedMeshes(size_t first, size_t count);
+    uint64_t computeMeshCacheKey() const;
+    void finishGenerate();
+    void cancelGenerate();
+    void endCancelGenerate();
+    ThreadPool* getWorkers();
     
     int calculateLOD(float distance) const;
+    int calculateLOD(const TerrainChunk& chunk, const glm::vec3& cameraPos) const;
+    int findCoarsestLOD(const TerrainChunk& chunk, const glm::vec3& cameraPos) const;
+    int calculateNodeLOD(const TerrainQuadtree::Node& node, const glm::vec3& cameraPos) const;
+    void renderChunks(const glm::vec3& cameraPos, const glm::mat4* horizonViewProjection);
+    bool getHorizonView(const glm::mat4& viewProjection, TerrainHorizonCuller::View& view) const;
+    bool renderChunksGPU(Shader& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection);
+    void verifyGPUCulling(const glm::vec3& cameraPos);
+    void renderNode(int nodeIndex, const glm::vec3& cameraPos, unsigned int planeMask);
+    void renderStreamedChunk(int chunkIndex, const glm::vec3& cameraPos);
+    void drawMesh(TerrainChunk& mesh, int lod, unsigned int stitchMask, bool skirts);
+    void selectLODs(const glm::vec3& cameraPos);
+    unsigned int getStitchMask(int chunkIndex) const;
+    void setPackedVertexUniforms(Shader& shader) const;
 };
 
 #endif
@@ -1,4 +1,6 @@
 #include "Frustum.h"
+#include <algorithm>
+#include <cmath>
 
 Frustum::Frustum()
 {
@@ -83,3 +85,64 @@ bool Frustum::isBoxVisible(const glm::vec3& min, const glm::vec3& max) const
     }
     return true;
 }
+
+Frustum::Result Frustum::classifyBox(const glm::vec3& min, const glm::vec3& max,
+                                     unsigned int& planeMask, uint8_t& lastPlane) const
+{
+    if (planeMask == 0) return INSIDE;
+    
+    // Under a smoothly moving camera a box mostly leaves through the same plane as last frame
+    bool lastTested = lastPlane < COUNT && (planeMask & (1u << lastPlane));
+    if (lastTested)
+    {
+        const glm::vec4& plane = m_planes[lastPlane];
+        glm::vec3 pVertex;
+        pVertex.x = (plane.x >= 0.0f) ? max.x : min.x;
+        pVertex.y = (plane.y >= 0.0f) ? max.y : min.y;
+        pVertex.z = (plane.z >= 0.0f) ? max.z : min.z;
+        if (glm::dot(glm::vec3(plane), pVertex) + plane.w < 0.0f)
+        {
+            return OUTSIDE;
+        }
+    }
+    
+    unsigned int crossing = 0;
+    for (int i = 0; i < COUNT; i++)
+    {
+        unsigned int bit = 1u << i;
+        if (!(planeMask & bit)) continue;
+        
+        const glm::vec4& plane = m_planes[i];
+        glm::vec3 pVertex;
+        pVertex.x = (plane.x >= 0.0f) ? max.x : min.x;
+        pVertex.y = (plane.y >= 0.0f) ? max.y : min.y;
+        pVertex.z = (plane.z >= 0.0f) ? max.z : min.z;
+        
+        // Same test as isBoxVisible
+        if (!(lastTested && i == lastPlane) && glm::dot(glm::vec3(plane), pVertex) + plane.w < 0.0f)
+        {
+            lastPlane = static_cast<uint8_t>(i);
+            return OUTSIDE;
+        }
+        
+        // The negative vertex is the corner deepest outside; with it inside, so is the whole box.
+        // The margin covers the rounding of any sub-box's p-vertex test, so skipping the plane
+        // below this box never keeps one that isBoxVisible rejects
+        glm::vec3 nVertex;
+        nVertex.x = (plane.x >= 0.0f) ? min.x : max.x;
+        nVertex.y = (plane.y >= 0.0f) ? min.y : max.y;
+        nVertex.z = (plane.z >= 0.0f) ? min.z : max.z;
+        float distance = glm::dot(glm::vec3(plane), nVertex) + plane.w;
+        if (distance > 0.0f)
+        {
+            float magnitude = std::abs(plane.x) * std::max(std::abs(min.x), std::abs(max.x))
+                            + std::abs(plane.y) * std::max(std::abs(min.y), std::abs(max.y))
+                            + std::abs(plane.z) * std::max(std::abs(min.z), std::abs(max.z)) + std::abs(plane.w);
+            if (distance > magnitude * 1e-5f) continue;
+        }
+        crossing |= bit;
+    }
+    
+    planeMask = crossing;
+    return crossing ? INTERSECTING : INSIDE;
+}
@@ -8,6 +8,7 @@
 #define FRUSTUM_H
 
 #include <glm/glm.hpp>
+#include <cstdint>
 
 class Frustum
 {
@@ -17,6 +18,25 @@ public:
     void update(const glm::mat4& viewProjection);
     bool isBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
     
+    static const int PLANE_COUNT = 6;
+    static const unsigned int ALL_PLANES = (1u << PLANE_COUNT) - 1;
+    
+    enum Result { OUTSIDE = 0, INTERSECTING, INSIDE };
+    
+    /**
+     * @brief Classify a box, testing only the planes it may still cross
+     * @param planeMask In: planes to test (the parent's result, ALL_PLANES at the root); out,
+     *                  unless OUTSIDE: the planes the box crosses. A plane is only cleared when the
+     *                  box is inside it by more than rounding, so boxes within it may skip that
+     *                  plane and still get isBoxVisible's answer
+     * @param lastPlane In: plane tried first (PLANE_COUNT or more for none); out: the plane that
+     *                  rejected the box, kept by the caller for the next frame
+     */
+    Result classifyBox(const glm::vec3& min, const glm::vec3& max, unsigned int& planeMask, uint8_t& lastPlane) const;
+    
+    // Left, right, bottom, top, near, far; normalized, a point is inside when dot(xyz, p) + w >= 0
+    const glm::vec4* getPlanes() const { return m_planes; }
+    
 private:
     enum Planes { LEFT = 0, RIGHT, BOTTOM, TOP, NEAR, FAR, COUNT };
     glm::vec4 m_planes[COUNT];
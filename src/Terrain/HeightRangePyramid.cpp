@@ -0,0 +1,258 @@
+#include "HeightRangePyramid.h"
+#include "HeightmapLoader.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float INV_UINT16_MAX = 1.0f / 65535.0f;
+    
+    // Rounded outwards so stored ranges always contain the true heights
+    uint16_t quantizeDown(float h)
+    {
+        return static_cast<uint16_t>(std::max(0.0f, std::min(std::floor(h * 65535.0f), 65535.0f)));
+    }
+    
+    uint16_t quantizeUp(float h)
+    {
+        return static_cast<uint16_t>(std::max(0.0f, std::min(std::ceil(h * 65535.0f), 65535.0f)));
+    }
+}
+
+HeightRangePyramid::HeightRangePyramid()
+    : m_source(nullptr)
+    , m_cellsX(0)
+    , m_cellsZ(0)
+{
+}
+
+void HeightRangePyramid::clear()
+{
+    m_levels.clear();
+    m_source = nullptr;
+    m_cellsX = 0;
+    m_cellsZ = 0;
+}
+
+void HeightRangePyramid::build(const HeightmapLoader& heightmap)
+{
+    clear();
+    int width = heightmap.getWidth();
+    int height = heightmap.getGridHeight();
+    if (width < 2 || height < 2) return;
+    
+    m_source = &heightmap;
+    m_cellsX = width - 1;
+    m_cellsZ = height - 1;
+    
+    // Level 1 straight from the texels: node i spans texels [2i, 2i + 2]
+    Level first;
+    first.width = (m_cellsX + 1) / 2;
+    first.height = (m_cellsZ + 1) / 2;
+    first.ranges.resize(static_cast<size_t>(first.width) * first.height);
+    
+    std::vector<float> scratch[3];
+    std::vector<float> columnMin(width), columnMax(width);
+    for (int nz = 0; nz < first.height; nz++)
+    {
+        const float* rows[3];
+        int rowCount = 0;
+        for (int z = 2 * nz; z <= std::min(2 * nz + 2, height - 1); z++)
+        {
+            rows[rowCount] = heightmap.getRow(z, scratch[rowCount]);
+            rowCount++;
+        }
+        
+        for (int x = 0; x < width; x++)
+        {
+            float lo = rows[0][x], hi = rows[0][x];
+            for (int r = 1; r < rowCount; r++)
+            {
+                lo = std::min(lo, rows[r][x]);
+                hi = std::max(hi, rows[r][x]);
+            }
+            columnMin[x] = lo;
+            columnMax[x] = hi;
+        }
+        
+        for (int nx = 0; nx < first.width; nx++)
+        {
+            float lo = columnMin[2 * nx], hi = columnMax[2 * nx];
+            for (int x = 2 * nx + 1; x <= std::min(2 * nx + 2, width - 1); x++)
+            {
+                lo = std::min(lo, columnMin[x]);
+                hi = std::max(hi, columnMax[x]);
+            }
+            first.ranges[static_cast<size_t>(nz) * first.width + nx] = { quantizeDown(lo), quantizeUp(hi) };
+        }
+    }
+    m_levels.push_back(std::move(first));
+    
+    // Each further level merges 2x2 nodes until one node covers the map
+    while (m_levels.back().width > 1 || m_levels.back().height > 1)
+    {
+        const Level& src = m_levels.back();
+        Level next;
+        next.width = (src.width + 1) / 2;
+        next.height = (src.height + 1) / 2;
+        next.ranges.resize(static_cast<size_t>(next.width) * next.height);
+        
+        for (int nz = 0; nz < next.height; nz++)
+        {
+            for (int nx = 0; nx < next.width; nx++)
+            {
+                Range merged = { 65535, 0 };
+                for (int z = 2 * nz; z <= std::min(2 * nz + 1, src.height - 1); z++)
+                {
+                    for (int x = 2 * nx; x <= std::min(2 * nx + 1, src.width - 1); x++)
+                    {
+                        const Range& child = src.ranges[static_cast<size_t>(z) * src.width + x];
+                        merged.min = std::min(merged.min, child.min);
+                        merged.max = std::max(merged.max, child.max);
+                    }
+                }
+                next.ranges[static_cast<size_t>(nz) * next.width + nx] = merged;
+            }
+        }
+        m_levels.push_back(std::move(next));
+    }
+}
+
+void HeightRangePyramid::update(int x0, int z0, int x1, int z1)
+{
+    if (!m_source) return;
+    
+    // Level 1 node i spans texels [2i, 2i + 2], so texel x touches nodes (x - 1) / 2 .. x / 2
+    Level& first = m_levels[0];
+    int nx0 = std::max(0, (x0 - 1) / 2), nx1 = std::min(first.width - 1, x1 / 2);
+    int nz0 = std::max(0, (z0 - 1) / 2), nz1 = std::min(first.height - 1, z1 / 2);
+    for (int nz = nz0; nz <= nz1; nz++)
+    {
+        for (int nx = nx0; nx <= nx1; nx++)
+        {
+            float lo = 1.0f, hi = 0.0f;
+            for (int z = 2 * nz; z <= std::min(2 * nz + 2, m_cellsZ); z++)
+            {
+                for (int x = 2 * nx; x <= std::min(2 * nx + 2, m_cellsX); x++)
+                {
+                    float h = m_source->getHeight(x, z);
+                    lo = std::min(lo, h);
+                    hi = std::max(hi, h);
+                }
+            }
+            first.ranges[static_cast<size_t>(nz) * first.width + nx] = { quantizeDown(lo), quantizeUp(hi) };
+        }
+    }
+    
+    // Parents of the touched nodes, level by level
+    for (size_t k = 1; k < m_levels.size(); k++)
+    {
+        const Level& src = m_levels[k - 1];
+        Level& dst = m_levels[k];
+        nx0 >>= 1; nx1 >>= 1;
+        nz0 >>= 1; nz1 >>= 1;
+        for (int nz = nz0; nz <= nz1; nz++)
+        {
+            for (int nx = nx0; nx <= nx1; nx++)
+            {
+                Range merged = { 65535, 0 };
+                for (int z = 2 * nz; z <= std::min(2 * nz + 1, src.height - 1); z++)
+                {
+                    for (int x = 2 * nx; x <= std::min(2 * nx + 1, src.width - 1); x++)
+                    {
+                        const Range& child = src.ranges[static_cast<size_t>(z) * src.width + x];
+                        merged.min = std::min(merged.min, child.min);
+                        merged.max = std::max(merged.max, child.max);
+                    }
+                }
+                dst.ranges[static_cast<size_t>(nz) * dst.width + nx] = merged;
+            }
+        }
+    }
+}
+
+int HeightRangePyramid::getNodesX(int level) const
+{
+    return level == 0 ? m_cellsX : m_levels[level - 1].width;
+}
+
+int HeightRangePyramid::getNodesZ(int level) const
+{
+    return level == 0 ? m_cellsZ : m_levels[level - 1].height;
+}
+
+void HeightRangePyramid::getCellRange(int cellX, int cellZ, float& minHeight, float& maxHeight) const
+{
+    float h00 = m_source->getHeight(cellX, cellZ);
+    float h10 = m_source->getHeight(cellX + 1, cellZ);
+    float h01 = m_source->getHeight(cellX, cellZ + 1);
+    float h11 = m_source->getHeight(cellX + 1, cellZ + 1);
+    minHeight = std::min(std::min(h00, h10), std::min(h01, h11));
+    maxHeight = std::max(std::max(h00, h10), std::max(h01, h11));
+}
+
+void HeightRangePyramid::getNodeRange(int level, int nodeX, int nodeZ, float& minHeight, float& maxHeight) const
+{
+    if (level == 0)
+    {
+        getCellRange(nodeX, nodeZ, minHeight, maxHeight);
+        return;
+    }
+    
+    const Level& l = m_levels[level - 1];
+    const Range& range = l.ranges[static_cast<size_t>(nodeZ) * l.width + nodeX];
+    minHeight = range.min * INV_UINT16_MAX;
+    maxHeight = range.max * INV_UINT16_MAX;
+}
+
+void HeightRangePyramid::getRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const
+{
+    minHeight = 1.0f;
+    maxHeight = 0.0f;
+    if (!m_source) return;
+    
+    // Texel rectangle to half-open cell rectangle; a single row or column widens to its cells
+    int cx0 = std::max(0, std::min(x0, m_cellsX - 1));
+    int cz0 = std::max(0, std::min(z0, m_cellsZ - 1));
+    int cx1 = std::max(cx0 + 1, std::min(x1, m_cellsX));
+    int cz1 = std::max(cz0 + 1, std::min(z1, m_cellsZ));
+    
+    int top = getLevelCount() - 1;
+    visit(top, 0, 0, cx0, cz0, cx1, cz1, minHeight, maxHeight);
+}
+
+void HeightRangePyramid::visit(int level, int nodeX, int nodeZ, int cx0, int cz0, int cx1, int cz1,
+                               float& minHeight, float& maxHeight) const
+{
+    int size = 1 << level;
+    int nx0 = nodeX << level;
+    int nz0 = nodeZ << level;
+    if (nx0 >= cx1 || nz0 >= cz1 || nx0 + size <= cx0 || nz0 + size <= cz0) return;
+    if (nx0 >= m_cellsX || nz0 >= m_cellsZ) return;
+    
+    // Fully covered (nodes on the map edge only hold the cells that exist)
+    bool inside = nx0 >= cx0 && nz0 >= cz0 &&
+                  std::min(nx0 + size, m_cellsX) <= cx1 && std::min(nz0 + size, m_cellsZ) <= cz1;
+    if (inside || level == 0)
+    {
+        float lo, hi;
+        getNodeRange(level, nodeX, nodeZ, lo, hi);
+        minHeight = std::min(minHeight, lo);
+        maxHeight = std::max(maxHeight, hi);
+        return;
+    }
+    
+    for (int i = 0; i < 4; i++)
+    {
+        visit(level - 1, nodeX * 2 + (i & 1), nodeZ * 2 + (i >> 1), cx0, cz0, cx1, cz1, minHeight, maxHeight);
+    }
+}
+
+size_t HeightRangePyramid::getMemoryBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& level : m_levels)
+    {
+        bytes += level.ranges.size() * sizeof(Range);
+    }
+    return bytes;
+}
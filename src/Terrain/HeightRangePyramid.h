@@ -0,0 +1,74 @@
+/**
+ * @file HeightRangePyramid.h
+ * @brief Min/max height pyramid over heightmap grid cells for fast rectangle range queries
+ * @author LuNingfang
+ */
+
+#ifndef HEIGHT_RANGE_PYRAMID_H
+#define HEIGHT_RANGE_PYRAMID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class HeightmapLoader;
+
+/*
+ * Level k node (i, j) bounds the 2^k x 2^k grid cells starting at cell (i << k, j << k),
+ * including their corner texels, so neighbouring nodes share an edge like neighbouring chunks.
+ * Level 0 (single cells) is read straight from the heightmap; levels >= 1 are stored as
+ * conservatively rounded 16-bit ranges.
+ */
+class HeightRangePyramid
+{
+public:
+    HeightRangePyramid();
+
+    void build(const HeightmapLoader& heightmap);
+    void clear();
+    
+    // Recompute the nodes touching texels [x0, x1] x [z0, z1] after the heightmap changed there
+    void update(int x0, int z0, int x1, int z1);
+
+    /**
+     * @brief Normalized min/max height over texels [x0, x1] x [z0, z1] (inclusive)
+     *
+     * Visits O(log n) nodes for rectangles on the chunk grid and O(perimeter / cell) in
+     * the worst case, instead of scanning every texel.
+     */
+    void getRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const;
+
+    // Node access for hierarchical traversals (rays, occlusion); level 0 is a single cell
+    int getLevelCount() const { return static_cast<int>(m_levels.size()) + 1; }
+    int getNodesX(int level) const;
+    int getNodesZ(int level) const;
+    void getNodeRange(int level, int nodeX, int nodeZ, float& minHeight, float& maxHeight) const;
+
+    size_t getMemoryBytes() const;
+    bool isBuilt() const { return m_source != nullptr; }
+
+private:
+    struct Range
+    {
+        uint16_t min;
+        uint16_t max;
+    };
+
+    struct Level
+    {
+        int width;      // nodes
+        int height;
+        std::vector<Range> ranges;
+    };
+
+    const HeightmapLoader* m_source;
+    int m_cellsX;
+    int m_cellsZ;
+    std::vector<Level> m_levels;    // m_levels[k - 1] is level k
+
+    void getCellRange(int cellX, int cellZ, float& minHeight, float& maxHeight) const;
+    void visit(int level, int nodeX, int nodeZ, int cx0, int cz0, int cx1, int cz1,
+               float& minHeight, float& maxHeight) const;
+};
+
+#endif
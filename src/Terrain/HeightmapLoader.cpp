@@ -2,9 +2,64 @@
 #include <stb_image.h>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    const float INV_UINT8_MAX = 1.0f / 255.0f;
+    const float INV_UINT16_MAX = 1.0f / 65535.0f;
+
+    // Room for a 32-bit gather starting at the last sample
+    const size_t GATHER_PADDING_BYTES = 4;
+
+    // Side of one tile of unrounded sculpt edits
+    const int EDIT_TILE_SIZE = 64;
+
+    bool hasExtension(const std::string& path, const char* extension)
+    {
+        size_t length = std::char_traits<char>::length(extension);
+        return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+    }
+
+    // Headerless little-endian 16-bit samples; the size is implied by a square grid
+    bool loadRaw16(const std::string& path, std::vector<uint16_t>& samples, int& width, int& height)
+    {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) return false;
+
+        // long is 32-bit on Windows, too small for maps past 2 GB
+#ifdef _WIN32
+        _fseeki64(file, 0, SEEK_END);
+        long long bytes = _ftelli64(file);
+#else
+        fseeko(file, 0, SEEK_END);
+        long long bytes = ftello(file);
+#endif
+        std::fseek(file, 0, SEEK_SET);
+
+        size_t count = bytes > 0 ? static_cast<size_t>(bytes) / sizeof(uint16_t) : 0;
+        int side = static_cast<int>(std::lround(std::sqrt(static_cast<double>(count))));
+        if (count == 0 || static_cast<size_t>(side) * side != count)
+        {
+            std::cerr << "ERROR::HEIGHTMAP::RAW16_NOT_SQUARE: " << count << " samples" << std::endl;
+            std::fclose(file);
+            return false;
+        }
+
+        samples.resize(count);
+        size_t read = std::fread(samples.data(), sizeof(uint16_t), count, file);
+        std::fclose(file);
+        width = side;
+        height = side;
+        return read == count;
+    }
+}
 
 HeightmapLoader::HeightmapLoader()
-    : m_width(0)
+    : m_storage(HeightStorage::UInt16)
+    , m_requestedStorage(HeightStorage::UInt16)
+    , m_width(0)
     , m_height(0)
     , m_loaded(false)
 {
@@ -16,34 +71,190 @@ HeightmapLoader::~HeightmapLoader()
 
 bool HeightmapLoader::load(const std::string& path)
 {
-    m_heightData.clear();
+    releaseSamples();
+    m_tiled.close();
+    m_rangePyramid.clear();
     m_loaded = false;
+    m_storage = m_requestedStorage;
 
-    // Load image as grayscale
-    int channels;
-    unsigned char* data = stbi_load(path.c_str(), &m_width, &m_height, &channels, 1);
-
-    if (!data)
+    if (hasExtension(path, ".rhm"))
     {
-        std::cerr << "ERROR::HEIGHTMAP::FAILED_TO_LOAD: " << path << std::endl;
-        return false;
-    }
+        if (!m_tiled.open(path))
+        {
+            std::cerr << "ERROR::HEIGHTMAP::FAILED_TO_LOAD: " << path << std::endl;
+            return false;
+        }
 
-    std::cout << "Heightmap loaded: " << path << " (" << m_width << "x" << m_height << ")" << std::endl;
+        m_storage = HeightStorage::UInt16;
+        m_width = m_tiled.getWidth();
+        m_height = m_tiled.getHeight();
+        m_loaded = true;
+        m_rangePyramid.build(*this);
+        std::cout << "Heightmap mapped: " << path << " (" << m_width << "x" << m_height << ", "
+                  << m_tiled.getLevelCount() << " levels, " << m_tiled.getTileSize() << " tiles)" << std::endl;
+        return true;
+    }
 
-    // Convert to normalized float values (0-1)
-    m_heightData.resize(m_width * m_height);
-    for (int i = 0; i < m_width * m_height; i++)
+    // Decode at the source's own depth, then convert once into the chosen storage
+    int sourceBits;
+    if (hasExtension(path, ".raw") || hasExtension(path, ".r16"))
     {
-        m_heightData[i] = static_cast<float>(data[i]) / 255.0f;
+        std::vector<uint16_t> samples;
+        if (!loadRaw16(path, samples, m_width, m_height))
+        {
+            std::cerr << "ERROR::HEIGHTMAP::FAILED_TO_LOAD: " << path << std::endl;
+            return false;
+        }
+        storeSamples16(samples.data());
+        sourceBits = 16;
     }
+    else if (stbi_is_16_bit(path.c_str()))
+    {
+        int channels;
+        stbi_us* data = stbi_load_16(path.c_str(), &m_width, &m_height, &channels, 1);
+        if (!data)
+        {
+            std::cerr << "ERROR::HEIGHTMAP::FAILED_TO_LOAD: " << path << std::endl;
+            return false;
+        }
+        storeSamples16(data);
+        stbi_image_free(data);
+        sourceBits = 16;
+    }
+    else
+    {
+        // Load image as grayscale
+        int channels;
+        unsigned char* data = stbi_load(path.c_str(), &m_width, &m_height, &channels, 1);
+        if (!data)
+        {
+            std::cerr << "ERROR::HEIGHTMAP::FAILED_TO_LOAD: " << path << std::endl;
+            return false;
+        }
+        storeSamples8(data);
+        stbi_image_free(data);
+        sourceBits = 8;
+    }
+
+    std::cout << "Heightmap loaded: " << path << " (" << m_width << "x" << m_height << ", "
+              << sourceBits << "-bit source, " << getStorageName() << " storage, "
+              << getMemoryBytes() / 1024 << " KB)" << std::endl;
 
-    stbi_image_free(data);
     m_loaded = true;
+    m_rangePyramid.build(*this);
 
     return true;
 }
 
+void HeightmapLoader::releaseSamples()
+{
+    // Swap rather than clear so switching storage gives the memory back
+    std::vector<uint8_t>().swap(m_samples8);
+    std::vector<uint16_t>().swap(m_samples16);
+    std::vector<float>().swap(m_samplesFloat);
+    std::vector<std::vector<float>>().swap(m_editTiles);
+}
+
+void HeightmapLoader::storeSamples8(const uint8_t* samples)
+{
+    size_t count = static_cast<size_t>(m_width) * m_height;
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:
+        m_samples8.resize(count + GATHER_PADDING_BYTES);
+        std::copy(samples, samples + count, m_samples8.begin());
+        break;
+    case HeightStorage::UInt16:
+        // x * 257 maps 0..255 exactly onto 0..65535
+        m_samples16.resize(count + GATHER_PADDING_BYTES / sizeof(uint16_t));
+        for (size_t i = 0; i < count; i++) m_samples16[i] = static_cast<uint16_t>(samples[i] * 257);
+        break;
+    case HeightStorage::Float:
+        m_samplesFloat.resize(count);
+        for (size_t i = 0; i < count; i++) m_samplesFloat[i] = samples[i] * INV_UINT8_MAX;
+        break;
+    }
+}
+
+void HeightmapLoader::storeSamples16(const uint16_t* samples)
+{
+    size_t count = static_cast<size_t>(m_width) * m_height;
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:
+        // Rounded, so a widened 8-bit source survives the round trip
+        m_samples8.resize(count + GATHER_PADDING_BYTES);
+        for (size_t i = 0; i < count; i++) m_samples8[i] = static_cast<uint8_t>((samples[i] + 128) / 257);
+        break;
+    case HeightStorage::UInt16:
+        m_samples16.resize(count + GATHER_PADDING_BYTES / sizeof(uint16_t));
+        std::copy(samples, samples + count, m_samples16.begin());
+        break;
+    case HeightStorage::Float:
+        m_samplesFloat.resize(count);
+        for (size_t i = 0; i < count; i++) m_samplesFloat[i] = samples[i] * INV_UINT16_MAX;
+        break;
+    }
+}
+
+const char* HeightmapLoader::getStorageName() const
+{
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:  return "uint8";
+    case HeightStorage::UInt16: return "uint16";
+    default:                    return "float";
+    }
+}
+
+size_t HeightmapLoader::getMemoryBytes() const
+{
+    // Tiled files live in the page cache, not on the heap
+    size_t bytes = m_samples8.capacity() + m_samples16.capacity() * sizeof(uint16_t)
+                 + m_samplesFloat.capacity() * sizeof(float)
+                 + m_editTiles.capacity() * sizeof(std::vector<float>);
+    for (const std::vector<float>& tile : m_editTiles)
+    {
+        bytes += tile.capacity() * sizeof(float);
+    }
+    return bytes;
+}
+
+const void* HeightmapLoader::getSamples() const
+{
+    if (m_tiled.isOpen()) return nullptr;
+
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:  return m_samples8.data();
+    case HeightStorage::UInt16: return m_samples16.data();
+    default:                    return m_samplesFloat.data();
+    }
+}
+
+size_t HeightmapLoader::getSampleBytes() const
+{
+    if (m_tiled.isOpen()) return 0;
+
+    size_t count = static_cast<size_t>(m_width) * m_height;
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:  return count * sizeof(uint8_t);
+    case HeightStorage::UInt16: return count * sizeof(uint16_t);
+    default:                    return count * sizeof(float);
+    }
+}
+
+float HeightmapLoader::getSampleScale() const
+{
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:  return INV_UINT8_MAX;
+    case HeightStorage::UInt16: return INV_UINT16_MAX;
+    default:                    return 1.0f;
+    }
+}
+
 float HeightmapLoader::getHeight(int x, int z) const
 {
     if (!m_loaded)
@@ -55,7 +266,113 @@ float HeightmapLoader::getHeight(int x, int z) const
     x = std::max(0, std::min(x, m_width - 1));
     z = std::max(0, std::min(z, m_height - 1));
 
-    return m_heightData[z * m_width + x];
+    if (m_tiled.isOpen())
+    {
+        return m_tiled.getSample(0, x, z) * INV_UINT16_MAX;
+    }
+
+    size_t i = static_cast<size_t>(z) * m_width + x;
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:  return m_samples8[i] * INV_UINT8_MAX;
+    case HeightStorage::UInt16: return m_samples16[i] * INV_UINT16_MAX;
+    default:                    return m_samplesFloat[i];
+    }
+}
+
+void HeightmapLoader::setHeight(int x, int z, float height)
+{
+    height = std::max(0.0f, std::min(height, 1.0f));
+    size_t i = static_cast<size_t>(z) * m_width + x;
+    if (m_storage != HeightStorage::Float)
+    {
+        // A brush step below half a storage step would round back to the old sample every
+        // time; keeping the exact value lets the next step start from it instead
+        int tilesX = (m_width + EDIT_TILE_SIZE - 1) / EDIT_TILE_SIZE;
+        int tilesZ = (m_height + EDIT_TILE_SIZE - 1) / EDIT_TILE_SIZE;
+        if (m_editTiles.empty())
+        {
+            m_editTiles.resize(static_cast<size_t>(tilesX) * tilesZ);
+        }
+        std::vector<float>& tile = m_editTiles[static_cast<size_t>(z / EDIT_TILE_SIZE) * tilesX + x / EDIT_TILE_SIZE];
+        if (tile.empty())
+        {
+            tile.assign(EDIT_TILE_SIZE * EDIT_TILE_SIZE, -1.0f);
+        }
+        tile[(z % EDIT_TILE_SIZE) * EDIT_TILE_SIZE + x % EDIT_TILE_SIZE] = height;
+    }
+
+    switch (m_storage)
+    {
+    case HeightStorage::UInt8:  m_samples8[i] = static_cast<uint8_t>(std::lround(height * 255.0f)); break;
+    case HeightStorage::UInt16: m_samples16[i] = static_cast<uint16_t>(std::lround(height * 65535.0f)); break;
+    default:                    m_samplesFloat[i] = height; break;
+    }
+}
+
+float HeightmapLoader::getEditedHeight(int x, int z) const
+{
+    if (!m_editTiles.empty() && x >= 0 && z >= 0 && x < m_width && z < m_height)
+    {
+        int tilesX = (m_width + EDIT_TILE_SIZE - 1) / EDIT_TILE_SIZE;
+        const std::vector<float>& tile = m_editTiles[static_cast<size_t>(z / EDIT_TILE_SIZE) * tilesX + x / EDIT_TILE_SIZE];
+        if (!tile.empty())
+        {
+            float height = tile[(z % EDIT_TILE_SIZE) * EDIT_TILE_SIZE + x % EDIT_TILE_SIZE];
+            if (height >= 0.0f) return height;
+        }
+    }
+    return getHeight(x, z);
+}
+
+const float* HeightmapLoader::getRow(int z, std::vector<float>& scratch) const
+{
+    z = std::max(0, std::min(z, m_height - 1));
+    size_t rowStart = static_cast<size_t>(z) * m_width;
+    if (!m_tiled.isOpen() && m_storage == HeightStorage::Float)
+    {
+        return m_samplesFloat.data() + rowStart;
+    }
+
+    scratch.resize(m_width);
+    if (m_tiled.isOpen())
+    {
+        for (int x = 0; x < m_width; x++)
+        {
+            scratch[x] = m_tiled.getSample(0, x, z) * INV_UINT16_MAX;
+        }
+    }
+    else if (m_storage == HeightStorage::UInt16)
+    {
+        const uint16_t* row = m_samples16.data() + rowStart;
+        for (int x = 0; x < m_width; x++) scratch[x] = row[x] * INV_UINT16_MAX;
+    }
+    else
+    {
+        const uint8_t* row = m_samples8.data() + rowStart;
+        for (int x = 0; x < m_width; x++) scratch[x] = row[x] * INV_UINT8_MAX;
+    }
+    return scratch.data();
+}
+
+float HeightmapLoader::getMipHeight(int level, int x, int z) const
+{
+    if (!m_tiled.isOpen() || level <= 0)
+    {
+        return getHeight(x << std::max(level, 0), z << std::max(level, 0));
+    }
+
+    // Past the coarsest stored level, sample it at the matching texel
+    int top = m_tiled.getLevelCount() - 1;
+    if (level > top)
+    {
+        x <<= level - top;
+        z <<= level - top;
+        level = top;
+    }
+    x = std::max(0, std::min(x, m_tiled.getWidth(level) - 1));
+    z = std::max(0, std::min(z, m_tiled.getHeight(level) - 1));
+    return m_tiled.getSample(level, x, z) * INV_UINT16_MAX;
 }
 
 float HeightmapLoader::getHeightInterpolated(float x, float z) const
@@ -7,16 +7,43 @@
 #ifndef HEIGHTMAP_LOADER_H
 #define HEIGHTMAP_LOADER_H
 
+#include "HeightRangePyramid.h"
+#include "TiledHeightmap.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
+// In-memory sample type of image heightmaps; heights are normalized to 0..1 on read
+enum class HeightStorage
+{
+    UInt8,
+    UInt16,
+    Float
+};
+
 class HeightmapLoader
 {
 public:
     HeightmapLoader();
     ~HeightmapLoader();
 
+    // The range pyramid points back at this loader, so it stays where it was loaded (no move either)
+    HeightmapLoader(const HeightmapLoader&) = delete;
+    HeightmapLoader& operator=(const HeightmapLoader&) = delete;
+
+    /**
+     * @brief Grayscale image via stb_image, RAW16, or a tiled .rhm file mapped without copying
+     *
+     * 16-bit PNGs and .raw/.r16 files (square, little-endian) keep full precision when the
+     * storage allows it. Tiled files are always 16-bit and ignore the storage setting.
+     */
     bool load(const std::string& path);
+    
+    // Applied on the next load()
+    void setStorage(HeightStorage storage) { m_requestedStorage = storage; }
+    HeightStorage getStorage() const { return m_storage; }
+    const char* getStorageName() const;
+    size_t getMemoryBytes() const;
 
     float getHeight(int x, int z) const;
     float getHeightInterpolated(float x, float z) const;
@@ -24,10 +51,62 @@ public:
     int getWidth() const { return m_width; }
     int getGridHeight() const { return m_height; }
 
+    /**
+     * @brief Row-major samples of getStorage() type, width * height values; null for tiled files
+     *
+     * Padded by 4 bytes so 32-bit gathers of the last 8/16-bit sample stay in bounds.
+     * Multiply by getSampleScale() to normalize.
+     */
+    const void* getSamples() const;
+    size_t getSampleBytes() const;      // width * height samples, without the padding
+    float getSampleScale() const;
+    
+    // One row of normalized heights, in place for float storage, otherwise decoded into scratch
+    const float* getRow(int z, std::vector<float>& scratch) const;
+    
+    // Mip pyramid of tiled files (level 0 only for images); texel i of level L is texel i * 2^L
+    int getMipLevelCount() const { return m_tiled.isOpen() ? m_tiled.getLevelCount() : 1; }
+    float getMipHeight(int level, int x, int z) const;
+    
+    bool isTiled() const { return m_tiled.isOpen(); }
+    
+    // Image heightmaps can be edited in place; tiled files are mapped read-only
+    bool isEditable() const { return m_loaded && !m_tiled.isOpen(); }
+    
+    // Normalized height, clamped to 0..1 and rounded to the storage type; no bounds check.
+    // 8/16-bit storage also keeps the unrounded value so repeated small edits add up
+    void setHeight(int x, int z, float height);
+    
+    // Last value passed to setHeight() at (x, z), or getHeight() where it was never edited
+    float getEditedHeight(int x, int z) const;
+    
+    // Refresh the range pyramid after setHeight() calls inside [x0, x1] x [z0, z1]
+    void updateHeightRange(int x0, int z0, int x1, int z1) { m_rangePyramid.update(x0, z0, x1, z1); }
+    
+    // Normalized min/max over texels [x0, x1] x [z0, z1], from the pyramid built at load time
+    void getHeightRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const
+    {
+        m_rangePyramid.getRange(x0, z0, x1, z1, minHeight, maxHeight);
+    }
+    const HeightRangePyramid& getRangePyramid() const { return m_rangePyramid; }
+
     bool isLoaded() const { return m_loaded; }
 
 private:
-    std::vector<float> m_heightData;
+    void releaseSamples();
+    void storeSamples8(const uint8_t* samples);
+    void storeSamples16(const uint16_t* samples);
+
+    // Only the vector matching m_storage is filled
+    std::vector<uint8_t> m_samples8;
+    std::vector<uint16_t> m_samples16;
+    std::vector<float> m_samplesFloat;
+    // Unrounded edits for 8/16-bit storage, in 64x64 tiles allocated on first write; -1 = unedited
+    std::vector<std::vector<float>> m_editTiles;
+    HeightStorage m_storage;
+    HeightStorage m_requestedStorage;
+    TiledHeightmap m_tiled;
+    HeightRangePyramid m_rangePyramid;   // refers back to this loader
     int m_width;
     int m_height;
     bool m_loaded;
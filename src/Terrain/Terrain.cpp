@@ -1,7 +1,9 @@
 #include "Terrain.h"
+#include <algorithm>
 #include <iostream>
 
 Terrain::Terrain()
+    : m_chunkedTerrain(std::make_unique<ChunkedTerrain>())
 {
 }
 
@@ -11,15 +13,62 @@ Terrain::~Terrain()
 
 bool Terrain::generate(const std::string& heightmapPath, float size, float maxHeight)
 {
-    return m_chunkedTerrain.generate(heightmapPath, size, maxHeight, 64);
+    m_pendingTerrain.reset();
+    return m_chunkedTerrain->generate(heightmapPath, size, maxHeight, 64);
+}
+
+void Terrain::generateAsync(const std::string& heightmapPath, float size, float maxHeight)
+{
+    // A superseded rebuild is told to stop and freed by update() once its thread has, so this
+    // frame does not wait for the row or chunk it is on
+    if (m_pendingTerrain)
+    {
+        m_pendingTerrain->requestCancelGenerate();
+        m_retiredTerrains.push_back(std::move(m_pendingTerrain));
+    }
+    m_pendingTerrain = std::make_unique<ChunkedTerrain>();
+    m_pendingTerrain->copyOptions(*m_chunkedTerrain);
+    m_pendingTerrain->generateAsync(heightmapPath, size, maxHeight, 64);
+}
+
+void Terrain::regenerateAsync()
+{
+    if (m_chunkedTerrain->getHeightmapPath().empty()) return;
+    generateAsync(m_chunkedTerrain->getHeightmapPath(), m_chunkedTerrain->getSize(), m_chunkedTerrain->getMaxHeight());
+}
+
+void Terrain::update()
+{
+    // Their GL objects are freed here, on the GL thread
+    m_retiredTerrains.erase(std::remove_if(m_retiredTerrains.begin(), m_retiredTerrains.end(),
+        [](const std::unique_ptr<ChunkedTerrain>& terrain) { return terrain->pollCancelGenerate(); }),
+        m_retiredTerrains.end());
+    
+    if (m_pendingTerrain && m_pendingTerrain->pumpGenerate())
+    {
+        if (m_pendingTerrain->isGenerated())
+        {
+            // Options changed on the old terrain while this one was building still apply
+            m_pendingTerrain->copyOptions(*m_chunkedTerrain);
+            std::swap(m_chunkedTerrain, m_pendingTerrain);
+        }
+        else
+        {
+            std::cerr << "ERROR::TERRAIN::REBUILD_FAILED: keeping the current terrain" << std::endl;
+        }
+        // Frees the replaced terrain's GL objects here, on the GL thread
+        m_pendingTerrain.reset();
+    }
+    
+    m_chunkedTerrain->update();
 }
 
 void Terrain::render(Shader& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection)
 {
-    m_chunkedTerrain.render(shader, cameraPos, viewProjection);
+    m_chunkedTerrain->render(shader, cameraPos, viewProjection);
 }
 
 float Terrain::getHeightAt(float worldX, float worldZ) const
 {
-    return m_chunkedTerrain.getHeightAt(worldX, worldZ);
+    return m_chunkedTerrain->getHeightAt(worldX, worldZ);
 }
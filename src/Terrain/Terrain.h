@@ -10,7 +10,9 @@
 #include "ChunkedTerrain.h"
 #include "Core/Shader.h"
 #include <glm/glm.hpp>
+#include <memory>
 #include <string>
+#include <vector>
 
 class Terrain
 {
@@ -18,28 +20,73 @@ public:
     Terrain();
     ~Terrain();
 
+    // Blocks until the terrain is built and uploaded (startup)
     bool generate(const std::string& heightmapPath, float size, float maxHeight);
+    
+    /**
+     * @brief Build a replacement terrain in the background; the current one keeps rendering
+     *
+     * update() uploads its meshes over the following frames and swaps it in at the start of
+     * a frame once complete. A second request supersedes one still in progress.
+     */
+    void generateAsync(const std::string& heightmapPath, float size, float maxHeight);
+    
+    // generateAsync() with the current heightmap, size and options
+    void regenerateAsync();
+    
+    bool isRebuilding() const { return m_pendingTerrain != nullptr; }
+    float getRebuildProgress() const { return m_pendingTerrain ? m_pendingTerrain->getGenerateProgress() : 0.0f; }
 
     void render(Shader& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection);
+    // Once per frame before rendering: background rebuild uploads and swap, then streaming
+    void update();
+    void setViewParameters(float fovYRadians, int viewportHeight) { m_chunkedTerrain->setViewParameters(fovYRadians, viewportHeight); }
+    void setClipPlane(const glm::vec4& plane) { m_chunkedTerrain->setClipPlane(plane); }
 
     float getHeightAt(float worldX, float worldZ) const;
+    void getHeightsAt(const float* worldX, const float* worldZ, size_t count,
+                      float* heights, glm::vec3* normals = nullptr) const
+    {
+        m_chunkedTerrain->getHeightsAt(worldX, worldZ, count, heights, normals);
+    }
+    bool sculpt(const glm::vec3& center, const TerrainBrush& brush, float deltaTime)
+    {
+        return m_chunkedTerrain->sculpt(center, brush, deltaTime);
+    }
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TerrainRayHit& hit) const
+    {
+        return m_chunkedTerrain->raycast(origin, direction, maxDistance, hit);
+    }
 
-    float getSize() const { return m_chunkedTerrain.getSize(); }
-    float getMaxHeight() const { return m_chunkedTerrain.getMaxHeight(); }
-    bool isGenerated() const { return m_chunkedTerrain.isGenerated(); }
-    int getGridWidth() const { return m_chunkedTerrain.getGridWidth(); }
-    int getGridHeight() const { return m_chunkedTerrain.getGridHeight(); }
+    float getSize() const { return m_chunkedTerrain->getSize(); }
+    float getMaxHeight() const { return m_chunkedTerrain->getMaxHeight(); }
+    bool isGenerated() const { return m_chunkedTerrain->isGenerated(); }
+    int getGridWidth() const { return m_chunkedTerrain->getGridWidth(); }
+    int getGridHeight() const { return m_chunkedTerrain->getGridHeight(); }
     
-    int getVertexCount() const { return m_chunkedTerrain.getTotalVertices(); }
-    int getTriangleCount() const { return m_chunkedTerrain.getRenderedTriangles(); }
-    int getTotalChunks() const { return m_chunkedTerrain.getTotalChunks(); }
-    int getVisibleChunks() const { return m_chunkedTerrain.getVisibleChunks(); }
-    int getCulledChunks() const { return m_chunkedTerrain.getCulledChunks(); }
+    int getVertexCount() const { return m_chunkedTerrain->getTotalVertices(); }
+    int getTestedNodes() const { return m_chunkedTerrain->getTestedNodes(); }
+    int getPlaneTests() const { return m_chunkedTerrain->getPlaneTests(); }
+    int getTriangleCount() const { return m_chunkedTerrain->getRenderedTriangles(); }
+    int getTotalChunks() const { return m_chunkedTerrain->getTotalChunks(); }
+    int getVisibleChunks() const { return m_chunkedTerrain->getVisibleChunks(); }
+    int getCulledChunks() const { return m_chunkedTerrain->getCulledChunks(); }
+    int getOccludedChunks() const { return m_chunkedTerrain->getOccludedChunks(); }
+    int getDrawCalls() const { return m_chunkedTerrain->getDrawCalls(); }
+    double getBuildTimeMs() const { return m_chunkedTerrain->getBuildTimeMs(); }
+    double getUploadTimeMs() const { return m_chunkedTerrain->getUploadTimeMs(); }
+    const char* getNormalPathName() const { return m_chunkedTerrain->getNormalPathName(); }
+    size_t getIndexMemoryBytes() const { return m_chunkedTerrain->getIndexMemoryBytes(); }
+    size_t getVertexMemoryBytes() const { return m_chunkedTerrain->getVertexMemoryBytes(); }
+    size_t getHeightmapMemoryBytes() const { return m_chunkedTerrain->getHeightmapMemoryBytes(); }
     
-    ChunkedTerrain& getChunkedTerrain() { return m_chunkedTerrain; }
+    // The terrain being rendered; options set here carry over to the next rebuild
+    ChunkedTerrain& getChunkedTerrain() { return *m_chunkedTerrain; }
 
 private:
-    ChunkedTerrain m_chunkedTerrain;
+    std::unique_ptr<ChunkedTerrain> m_chunkedTerrain;
+    std::unique_ptr<ChunkedTerrain> m_pendingTerrain;   // generateAsync() in progress
+    std::vector<std::unique_ptr<ChunkedTerrain>> m_retiredTerrains;    // superseded rebuilds still stopping
 };
 
 #endif
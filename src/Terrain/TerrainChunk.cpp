@@ -1,67 +1,330 @@
 #include "TerrainChunk.h"
+#include "TerrainDrawArena.h"
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 namespace {
     template<typename T>
     T clampValue(T val, T minVal, T maxVal) {
         return std::max(minVal, std::min(val, maxVal));
     }
+    
+    struct PackedTerrainVertex
+    {
+        uint16_t gridX;
+        uint16_t gridZ;
+        uint16_t height;
+        uint8_t octNormal[2];
+    };
+    static_assert(sizeof(PackedTerrainVertex) == 8, "packed terrain vertex must be 8 bytes");
+    
+    uint8_t packUnorm8(float v)
+    {
+        return static_cast<uint8_t>(std::lround(clampValue(v, 0.0f, 1.0f) * 255.0f));
+    }
+    
+    // Octahedral encoding around +Y (terrain normals always point up)
+    void packOctahedral(const glm::vec3& n, uint8_t out[2])
+    {
+        float invL1 = 1.0f / (std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z));
+        float px = n.x * invL1;
+        float pz = n.z * invL1;
+        if (n.y < 0.0f)
+        {
+            float fx = (1.0f - std::fabs(pz)) * (px >= 0.0f ? 1.0f : -1.0f);
+            float fz = (1.0f - std::fabs(px)) * (pz >= 0.0f ? 1.0f : -1.0f);
+            px = fx;
+            pz = fz;
+        }
+        out[0] = packUnorm8(px * 0.5f + 0.5f);
+        out[1] = packUnorm8(pz * 0.5f + 0.5f);
+    }
+    
+    // Deep enough to hide the largest possible LOD gap along an edge
+    float getSkirtDepth(float minY, float maxY, float cellSize, int sampleLevel)
+    {
+        return (maxY - minY) + cellSize * (1 << sampleLevel);
+    }
+    
+    // Indices [first, last] of the samples that fall in texels [lo, hi]; first > last if none do
+    void findSampleRange(const std::vector<int>& samples, int start, int lo, int hi, int& first, int& last)
+    {
+        first = static_cast<int>(std::lower_bound(samples.begin(), samples.end(), lo - start) - samples.begin());
+        last = static_cast<int>(std::upper_bound(samples.begin(), samples.end(), hi - start) - samples.begin()) - 1;
+    }
+    
+    // One LOD cell, split along the same TR-BL diagonal as TerrainIndexCache::buildGridIndices
+    struct LODCell
+    {
+        int x0, z0, x1, z1;
+        float hTL, hTR, hBL, hBR;
+        
+        float getU(int x) const { return static_cast<float>(x - x0) / static_cast<float>(x1 - x0); }
+        float getV(int z) const { return static_cast<float>(z - z0) / static_cast<float>(z1 - z0); }
+        float upper(float u, float v) const { return hTL + u * (hTR - hTL) + v * (hBL - hTL); }
+        float lower(float u, float v) const { return hBR + (1.0f - u) * (hBL - hBR) + (1.0f - v) * (hTR - hBR); }
+    };
+    
+    const int ERROR_SCAN_LEVEL = 3;    // range pyramid nodes of 8 x 8 cells and smaller are scanned texel by texel
+    
+    // Normalized heights as HeightmapLoader::getHeight() returns them, read straight from its
+    // samples (tiled files have none and go through getHeight())
+    struct HeightSamples
+    {
+        const HeightmapLoader& heightmap;
+        const void* data;
+        HeightStorage storage;
+        int width;
+        float scale;
+        
+        explicit HeightSamples(const HeightmapLoader& source)
+            : heightmap(source)
+            , data(source.getSamples())
+            , storage(source.getStorage())
+            , width(source.getWidth())
+            , scale(source.getSampleScale())
+        {
+        }
+        
+        float get(int x, int z) const
+        {
+            if (!data) return heightmap.getHeight(x, z);
+            size_t i = static_cast<size_t>(z) * width + x;
+            switch (storage)
+            {
+            case HeightStorage::UInt8:  return static_cast<const uint8_t*>(data)[i] * scale;
+            case HeightStorage::UInt16: return static_cast<const uint16_t*>(data)[i] * scale;
+            default:                    return static_cast<const float*>(data)[i];
+            }
+        }
+    };
+    
+    template<typename T>
+    void scanTexelError(const T* samples, int width, float scale, const LODCell& cell,
+                        int x0, int z0, int x1, int z1, float maxHeight, float& maxError)
+    {
+        for (int z = z0; z <= z1; z++)
+        {
+            float v = cell.getV(z);
+            const T* row = samples + static_cast<size_t>(z) * width;
+            for (int x = x0; x <= x1; x++)
+            {
+                float u = cell.getU(x);
+                float approx = (u + v <= 1.0f) ? cell.upper(u, v) : cell.lower(u, v);
+                maxError = std::max(maxError, std::fabs(approx - row[x] * scale) * maxHeight);
+            }
+        }
+    }
+    
+    // Raise maxError to the largest |surface - height| over texels [x0, x1] x [z0, z1] of the cell
+    void scanTexels(const HeightSamples& heights, const LODCell& cell, int x0, int z0, int x1, int z1,
+                    float maxHeight, float& maxError)
+    {
+        switch (heights.data ? heights.storage : HeightStorage::Float)
+        {
+        case HeightStorage::UInt8:
+            scanTexelError(static_cast<const uint8_t*>(heights.data), heights.width, heights.scale, cell,
+                           x0, z0, x1, z1, maxHeight, maxError);
+            return;
+        case HeightStorage::UInt16:
+            scanTexelError(static_cast<const uint16_t*>(heights.data), heights.width, heights.scale, cell,
+                           x0, z0, x1, z1, maxHeight, maxError);
+            return;
+        default:
+            break;
+        }
+        if (heights.data)
+        {
+            scanTexelError(static_cast<const float*>(heights.data), heights.width, 1.0f, cell,
+                           x0, z0, x1, z1, maxHeight, maxError);
+            return;
+        }
+        
+        // Tiled files
+        for (int z = z0; z <= z1; z++)
+        {
+            float v = cell.getV(z);
+            for (int x = x0; x <= x1; x++)
+            {
+                float u = cell.getU(x);
+                float approx = (u + v <= 1.0f) ? cell.upper(u, v) : cell.lower(u, v);
+                maxError = std::max(maxError, std::fabs(approx - heights.get(x, z)) * maxHeight);
+            }
+        }
+    }
+    
+    // Range of the cell's surface over texels [x0, x1] x [z0, z1]: each triangle's plane takes its
+    // extremes over a rectangle at the corners, and only triangles reaching into it count
+    void getSurfaceRange(const LODCell& cell, int x0, int z0, int x1, int z1, float& minH, float& maxH)
+    {
+        const float us[2] = { cell.getU(x0), cell.getU(x1) };
+        const float vs[2] = { cell.getV(z0), cell.getV(z1) };
+        bool upper = us[0] + vs[0] <= 1.0f;
+        bool lower = us[1] + vs[1] > 1.0f;
+        minH = std::numeric_limits<float>::max();
+        maxH = -std::numeric_limits<float>::max();
+        for (float u : us)
+        {
+            for (float v : vs)
+            {
+                if (upper)
+                {
+                    minH = std::min(minH, cell.upper(u, v));
+                    maxH = std::max(maxH, cell.upper(u, v));
+                }
+                if (lower)
+                {
+                    minH = std::min(minH, cell.lower(u, v));
+                    maxH = std::max(maxH, cell.lower(u, v));
+                }
+            }
+        }
+    }
+    
+    // scanTexels() over the texels of [x0, x1] x [z0, z1] that range pyramid node (level, nodeX,
+    // nodeZ) owns (the first texel of each of its cells, plus the map's far edge), skipping nodes
+    // whose height range cannot put any texel further than maxError from the surface
+    void scanNodeError(const HeightSamples& heights, const HeightRangePyramid& pyramid, const LODCell& cell,
+                       int level, int nodeX, int nodeZ, int x0, int z0, int x1, int z1,
+                       float maxHeight, float& maxError)
+    {
+        int lastX = pyramid.getNodesX(0);
+        int lastZ = pyramid.getNodesZ(0);
+        int size = 1 << level;
+        int nodeX0 = nodeX << level;
+        int nodeZ0 = nodeZ << level;
+        int bx0 = std::max(x0, nodeX0);
+        int bz0 = std::max(z0, nodeZ0);
+        int bx1 = std::min(x1, nodeX0 + size >= lastX ? lastX : nodeX0 + size - 1);
+        int bz1 = std::min(z1, nodeZ0 + size >= lastZ ? lastZ : nodeZ0 + size - 1);
+        if (bx0 > bx1 || bz0 > bz1) return;
+        
+        if (level <= ERROR_SCAN_LEVEL)
+        {
+            scanTexels(heights, cell, bx0, bz0, bx1, bz1, maxHeight, maxError);
+            return;
+        }
+        
+        // The margin covers rounding between this bound and the per-texel sums
+        float minH, maxH, surfaceMin, surfaceMax;
+        pyramid.getNodeRange(level, nodeX, nodeZ, minH, maxH);
+        getSurfaceRange(cell, bx0, bz0, bx1, bz1, surfaceMin, surfaceMax);
+        float bound = std::max(surfaceMax - minH, maxH - surfaceMin);
+        if ((bound + 1e-5f) * maxHeight <= maxError) return;
+        
+        for (int i = 0; i < 4; i++)
+        {
+            int childX = nodeX * 2 + (i & 1);
+            int childZ = nodeZ * 2 + (i >> 1);
+            if (childX >= pyramid.getNodesX(level - 1) || childZ >= pyramid.getNodesZ(level - 1)) continue;
+            scanNodeError(heights, pyramid, cell, level - 1, childX, childZ, x0, z0, x1, z1, maxHeight, maxError);
+        }
+    }
+    
+    // Coarse cells span up to thousands of texels a side; the range pyramid skips the parts of them
+    // that cannot raise maxError
+    void scanCellError(const HeightSamples& heights, const LODCell& cell, int x0, int z0, int x1, int z1,
+                       float maxHeight, float& maxError)
+    {
+        const HeightRangePyramid& pyramid = heights.heightmap.getRangePyramid();
+        int extent = std::max(x1 - x0, z1 - z0);
+        if (extent <= (1 << ERROR_SCAN_LEVEL) || !pyramid.isBuilt())
+        {
+            scanTexels(heights, cell, x0, z0, x1, z1, maxHeight, maxError);
+            return;
+        }
+        
+        // Start from the finest level whose nodes span the rectangle, so few of them cover it
+        int level = ERROR_SCAN_LEVEL + 1;
+        while ((1 << level) < extent && level + 1 < pyramid.getLevelCount()) level++;
+        for (int nodeZ = z0 >> level; nodeZ <= (z1 >> level) && nodeZ < pyramid.getNodesZ(level); nodeZ++)
+        {
+            for (int nodeX = x0 >> level; nodeX <= (x1 >> level) && nodeX < pyramid.getNodesX(level); nodeX++)
+            {
+                scanNodeError(heights, pyramid, cell, level, nodeX, nodeZ, x0, z0, x1, z1, maxHeight, maxError);
+            }
+        }
+    }
 }
 
 TerrainChunk::TerrainChunk()
-    : m_min(0.0f)
+    : m_arena(nullptr)
+    , m_arenaBaseVertex(0)
+    , m_arenaFirstIndex(0)
+    , m_vertexBytes(0)
+    , m_min(0.0f)
     , m_max(0.0f)
     , m_center(0.0f)
     , m_generated(false)
 {
+    m_indexRanges = {};
     for (int i = 0; i < LOD_LEVELS; i++)
     {
-        m_triangleCounts[i] = 0;
+        m_lodErrors[i] = 0.0f;
     }
 }
 
 TerrainChunk::~TerrainChunk()
 {
+    releaseArena();
 }
 
 TerrainChunk::TerrainChunk(TerrainChunk&& other) noexcept
-    : m_min(other.m_min)
+    : m_mesh(std::move(other.m_mesh))
+    , m_arena(other.m_arena)
+    , m_arenaBaseVertex(other.m_arenaBaseVertex)
+    , m_arenaFirstIndex(other.m_arenaFirstIndex)
+    , m_indexRanges(other.m_indexRanges)
+    , m_vertexBytes(other.m_vertexBytes)
+    , m_min(other.m_min)
     , m_max(other.m_max)
     , m_center(other.m_center)
     , m_generated(other.m_generated)
 {
     for (int i = 0; i < LOD_LEVELS; i++)
     {
-        m_lodMeshes[i] = std::move(other.m_lodMeshes[i]);
-        m_triangleCounts[i] = other.m_triangleCounts[i];
+        m_lodErrors[i] = other.m_lodErrors[i];
     }
     other.m_generated = false;
+    other.m_vertexBytes = 0;    // the arena vertices now belong to this chunk
 }
 
 TerrainChunk& TerrainChunk::operator=(TerrainChunk&& other) noexcept
 {
     if (this != &other)
     {
+        releaseArena();
+        m_mesh = std::move(other.m_mesh);
+        m_arena = other.m_arena;
+        m_arenaBaseVertex = other.m_arenaBaseVertex;
+        m_arenaFirstIndex = other.m_arenaFirstIndex;
+        m_indexRanges = other.m_indexRanges;
+        for (int i = 0; i < LOD_LEVELS; i++)
+        {
+            m_lodErrors[i] = other.m_lodErrors[i];
+        }
+        m_vertexBytes = other.m_vertexBytes;
         m_min = other.m_min;
         m_max = other.m_max;
         m_center = other.m_center;
         m_generated = other.m_generated;
-        
-        for (int i = 0; i < LOD_LEVELS; i++)
-        {
-            m_lodMeshes[i] = std::move(other.m_lodMeshes[i]);
-            m_triangleCounts[i] = other.m_triangleCounts[i];
-        }
         other.m_generated = false;
+        other.m_vertexBytes = 0;
     }
     return *this;
 }
 
-void TerrainChunk::generate(const HeightmapLoader& heightmap,
-                            int startX, int startZ, int chunkSize,
-                            float worldSize, float terrainSize, float maxHeight)
+void TerrainChunk::build(const HeightmapLoader& heightmap, TerrainNormalField::Path normalPath,
+                         int startX, int startZ, int sizeX, int sizeZ,
+                         float terrainSize, float maxHeight,
+                         TerrainVertexFormat format, bool skirts, TerrainChunkData& data,
+                         int sampleLevel)
 {
+    data.format = format;
+    
     int hmWidth = heightmap.getWidth();
     int hmHeight = heightmap.getGridHeight();
     
@@ -71,151 +334,489 @@ void TerrainChunk::generate(const HeightmapLoader& heightmap,
     float worldOffsetX = startX * cellSize - halfTerrain;
     float worldOffsetZ = startZ * cellSize - halfTerrain;
     
-    // Calculate AABB
-    float minY = maxHeight, maxY = 0.0f;
-    for (int z = startZ; z <= startZ + chunkSize && z < hmHeight; z++)
+    // AABB from the min/max pyramid instead of a scan over every texel
+    float minH, maxH;
+    heightmap.getHeightRange(startX, startZ, std::min(startX + sizeX, hmWidth - 1),
+                             std::min(startZ + sizeZ, hmHeight - 1), minH, maxH);
+    float minY = minH * maxHeight;
+    float maxY = maxH * maxHeight;
+    
+    data.min = glm::vec3(worldOffsetX, minY, worldOffsetZ);
+    data.max = glm::vec3(worldOffsetX + sizeX * cellSize, maxY, worldOffsetZ + sizeZ * cellSize);
+    
+    // Texels the vertex grid samples: all of them for chunks, every
+    // (1 << sampleLevel)-th (plus the far edge) for coarse quadtree nodes
+    std::vector<int> samplesX, samplesZ;
+    TerrainIndexCache::getLODSamples(sizeX + 1, sampleLevel, samplesX);
+    TerrainIndexCache::getLODSamples(sizeZ + 1, sampleLevel, samplesZ);
+    
+    // Normals over this region only, so no field for the whole map has to stay resident. Coarse
+    // meshes would need a window over their whole node for a few texels; they compute each one.
+    thread_local TerrainNormalField normalField;
+    const TerrainNormalField* normals = nullptr;
+    if (sampleLevel == 0)
+    {
+        normalField.build(heightmap, cellSize, maxHeight, startX, startZ, startX + sizeX, startZ + sizeZ, normalPath);
+        normals = &normalField;
+    }
+    
+    // LODs differ only in their index ranges, so only the finest grid is built
+    buildVertices(heightmap, normals, startX, startZ, samplesX, samplesZ,
+                  worldOffsetX, worldOffsetZ, cellSize, maxHeight, data);
+    
+    if (skirts)
+    {
+        appendSkirtVertices(data, getSkirtDepth(minY, maxY, cellSize, sampleLevel), maxHeight);
+    }
+    
+    computeLODErrors(heightmap, startX, startZ, samplesX, samplesZ, maxHeight, nullptr, data.lodErrors);
+}
+
+void TerrainChunk::buildPatch(const HeightmapLoader& heightmap, TerrainNormalField::Path normalPath,
+                              int startX, int startZ, int sizeX, int sizeZ,
+                              float terrainSize, float maxHeight,
+                              TerrainVertexFormat format, bool skirts, int sampleLevel,
+                              const glm::ivec4& changed, TerrainChunkPatch& patch)
+{
+    patch.format = format;
+    patch.runs.clear();
+    patch.vertices.clear();
+    
+    int hmWidth = heightmap.getWidth();
+    int hmHeight = heightmap.getGridHeight();
+    size_t stride = getVertexStride(format);
+    
+    float cellSize = terrainSize / static_cast<float>(hmWidth - 1);
+    float halfTerrain = terrainSize * 0.5f;
+    float worldOffsetX = startX * cellSize - halfTerrain;
+    float worldOffsetZ = startZ * cellSize - halfTerrain;
+    
+    // Bounds as build() computes them; the skirts hang by their height difference
+    float minH, maxH;
+    heightmap.getHeightRange(startX, startZ, std::min(startX + sizeX, hmWidth - 1),
+                             std::min(startZ + sizeZ, hmHeight - 1), minH, maxH);
+    float minY = minH * maxHeight;
+    float maxY = maxH * maxHeight;
+    bool depthChanged = minY != patch.min.y || maxY != patch.max.y;
+    patch.min = glm::vec3(worldOffsetX, minY, worldOffsetZ);
+    patch.max = glm::vec3(worldOffsetX + sizeX * cellSize, maxY, worldOffsetZ + sizeZ * cellSize);
+    
+    std::vector<int> samplesX, samplesZ;
+    TerrainIndexCache::getLODSamples(sizeX + 1, sampleLevel, samplesX);
+    TerrainIndexCache::getLODSamples(sizeZ + 1, sampleLevel, samplesZ);
+    int verticesX = static_cast<int>(samplesX.size());
+    int verticesZ = static_cast<int>(samplesZ.size());
+    
+    // Grid vertices [i0, i1] x [j0, j1] read a changed texel, directly or through a central difference
+    int i0, i1, j0, j1;
+    findSampleRange(samplesX, startX, changed.x - 1, changed.z + 1, i0, i1);
+    findSampleRange(samplesZ, startZ, changed.y - 1, changed.w + 1, j0, j1);
+    
+    // Vertices for grid columns [c0, c1] x rows [r0, r1], built exactly as build() builds them
+    thread_local TerrainNormalField normalField;
+    auto buildBlock = [&](int c0, int c1, int r0, int r1, TerrainChunkData& block)
     {
-        for (int x = startX; x <= startX + chunkSize && x < hmWidth; x++)
+        std::vector<int> blockX(samplesX.begin() + c0, samplesX.begin() + c1 + 1);
+        std::vector<int> blockZ(samplesZ.begin() + r0, samplesZ.begin() + r1 + 1);
+        const TerrainNormalField* normals = nullptr;
+        if (sampleLevel == 0)
         {
-            float h = heightmap.getHeight(x, z) * maxHeight;
-            minY = std::min(minY, h);
-            maxY = std::max(maxY, h);
+            normalField.build(heightmap, cellSize, maxHeight, startX + blockX.front(), startZ + blockZ.front(),
+                              startX + blockX.back(), startZ + blockZ.back(), normalPath);
+            normals = &normalField;
+        }
+        block.format = format;
+        buildVertices(heightmap, normals, startX, startZ, blockX, blockZ,
+                      worldOffsetX, worldOffsetZ, cellSize, maxHeight, block);
+    };
+    auto addRun = [&](size_t firstVertex, const uint8_t* vertices, size_t vertexCount)
+    {
+        patch.runs.push_back({ firstVertex, vertexCount });
+        patch.vertices.insert(patch.vertices.end(), vertices, vertices + vertexCount * stride);
+    };
+    
+    TerrainChunkData block;
+    bool gridChanged = i0 <= i1 && j0 <= j1;
+    if (gridChanged)
+    {
+        buildBlock(i0, i1, j0, j1, block);
+        int blockWidth = i1 - i0 + 1;
+        if (blockWidth == verticesX)
+        {
+            addRun(static_cast<size_t>(j0) * verticesX, block.vertices.data(), block.vertices.size() / stride);
+        }
+        else
+        {
+            for (int j = j0; j <= j1; j++)
+            {
+                addRun(static_cast<size_t>(j) * verticesX + i0,
+                       block.vertices.data() + static_cast<size_t>(j - j0) * blockWidth * stride, blockWidth);
+            }
         }
     }
     
-    m_min = glm::vec3(worldOffsetX, minY, worldOffsetZ);
-    m_max = glm::vec3(worldOffsetX + chunkSize * cellSize, maxY, worldOffsetZ + chunkSize * cellSize);
+    // Skirts: bottom row, top row, left column, right column, as appendSkirtVertices() lays them out
+    if (skirts && verticesX >= 2 && verticesZ >= 2 && (gridChanged || depthChanged))
+    {
+        float depth = getSkirtDepth(minY, maxY, cellSize, sampleLevel);
+        size_t skirtStart = static_cast<size_t>(verticesX) * verticesZ;
+        size_t edgeStarts[4] = { skirtStart, skirtStart + verticesX, skirtStart + 2 * verticesX,
+                                 skirtStart + 2 * verticesX + verticesZ };
+        
+        // A new depth moves every skirt vertex, so each edge is rebuilt whole; otherwise only
+        // the part of an edge inside the changed block
+        struct Edge { int c0, c1, r0, r1; size_t first; };
+        std::vector<Edge> edges;
+        if (depthChanged)
+        {
+            edges.push_back({ 0, verticesX - 1, 0, 0, edgeStarts[0] });
+            edges.push_back({ 0, verticesX - 1, verticesZ - 1, verticesZ - 1, edgeStarts[1] });
+            edges.push_back({ 0, 0, 0, verticesZ - 1, edgeStarts[2] });
+            edges.push_back({ verticesX - 1, verticesX - 1, 0, verticesZ - 1, edgeStarts[3] });
+        }
+        else
+        {
+            if (j0 == 0) edges.push_back({ i0, i1, 0, 0, edgeStarts[0] + i0 });
+            if (j1 == verticesZ - 1) edges.push_back({ i0, i1, verticesZ - 1, verticesZ - 1, edgeStarts[1] + i0 });
+            if (i0 == 0) edges.push_back({ 0, 0, j0, j1, edgeStarts[2] + j0 });
+            if (i1 == verticesX - 1) edges.push_back({ verticesX - 1, verticesX - 1, j0, j1, edgeStarts[3] + j0 });
+        }
+        
+        TerrainChunkData edgeBlock;
+        for (const Edge& edge : edges)
+        {
+            buildBlock(edge.c0, edge.c1, edge.r0, edge.r1, edgeBlock);
+            size_t count = edgeBlock.vertices.size() / stride;
+            for (size_t k = 0; k < count; k++)
+            {
+                lowerVertex(edgeBlock.vertices.data() + k * stride, format, depth, maxHeight);
+            }
+            addRun(edge.first, edgeBlock.vertices.data(), count);
+        }
+    }
+    
+    glm::ivec4 errorRect(changed.x, changed.y, changed.z, changed.w);
+    computeLODErrors(heightmap, startX, startZ, samplesX, samplesZ, maxHeight, &errorRect, patch.lodErrors);
+}
+
+void TerrainChunk::setDrawArena(TerrainDrawArena* arena)
+{
+    release();
+    m_arena = arena;
+}
+
+void TerrainChunk::upload(const TerrainChunkData& data, TerrainIndexCache& indexCache)
+{
+    upload(data, indexCache, data.vertices.data(), data.vertices.size());
+}
+
+void TerrainChunk::upload(const TerrainChunkData& data, TerrainIndexCache& indexCache,
+                          const uint8_t* vertices, size_t vertexBytes)
+{
+    m_min = data.min;
+    m_max = data.max;
     m_center = (m_min + m_max) * 0.5f;
+    releaseArena();
+    
+    const TerrainIndexCache::Buffer& indices = indexCache.get(data.verticesX, data.verticesZ);
+    if (vertexBytes > 0 && indices.ebo != 0 && m_arena)
+    {
+        m_arenaBaseVertex = m_arena->allocate(data.format, vertices, vertexBytes);
+        m_arenaFirstIndex = m_arena->addIndices(indices);
+        m_vertexBytes = vertexBytes;
+        m_indexRanges = indices;
+    }
+    else if (vertexBytes > 0 && indices.ebo != 0)
+    {
+        m_mesh.setVertices(vertices, vertexBytes, getVertexLayout(data.format));
+        m_mesh.setSharedIndices(indices.ebo, indices.totalIndexCount, indices.indexType);
+        m_vertexBytes = vertexBytes;
+        m_indexRanges = indices;
+    }
     
-    // Generate LOD meshes
     for (int lod = 0; lod < LOD_LEVELS; lod++)
     {
-        generateLODMesh(heightmap, startX, startZ, chunkSize,
-                        worldOffsetX, worldOffsetZ, cellSize, maxHeight, lod);
+        m_lodErrors[lod] = data.lodErrors[lod];
     }
     
     m_generated = true;
 }
 
-void TerrainChunk::generateLODMesh(const HeightmapLoader& heightmap,
-                                   int startX, int startZ, int chunkSize,
-                                   float worldOffsetX, float worldOffsetZ,
-                                   float cellSize, float maxHeight, int lodLevel)
+void TerrainChunk::applyPatch(const TerrainChunkPatch& patch)
+{
+    m_min = patch.min;
+    m_max = patch.max;
+    m_center = (m_min + m_max) * 0.5f;
+    for (int lod = 0; lod < LOD_LEVELS; lod++)
+    {
+        m_lodErrors[lod] = patch.lodErrors[lod];
+    }
+    if (!m_generated) return;
+    
+    size_t stride = getVertexStride(patch.format);
+    const uint8_t* source = patch.vertices.data();
+    for (const TerrainChunkPatch::Run& run : patch.runs)
+    {
+        size_t offset = run.firstVertex * stride;
+        size_t bytes = run.vertexCount * stride;
+        if (offset + bytes > m_vertexBytes) break;
+        if (m_arena)
+        {
+            m_arena->update(m_arenaBaseVertex, offset, source, bytes);
+        }
+        else
+        {
+            m_mesh.updateVertices(source, offset, bytes);
+        }
+        source += bytes;
+    }
+}
+
+void TerrainChunk::release()
+{
+    releaseArena();
+    m_mesh = Mesh();
+    m_indexRanges = {};
+    m_vertexBytes = 0;
+    m_generated = false;
+}
+
+void TerrainChunk::buildVertices(const HeightmapLoader& heightmap, const TerrainNormalField* normals,
+                                 int startX, int startZ,
+                                 const std::vector<int>& samplesX, const std::vector<int>& samplesZ,
+                                 float worldOffsetX, float worldOffsetZ,
+                                 float cellSize, float maxHeight,
+                                 TerrainChunkData& data)
 {
-    int step = 1 << lodLevel; // LOD0=1, LOD1=2, LOD2=4, LOD3=8
     int hmWidth = heightmap.getWidth();
     int hmHeight = heightmap.getGridHeight();
     
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+    std::vector<uint8_t>& vertices = data.vertices;
+    vertices.resize(samplesX.size() * samplesZ.size() * getVertexStride(data.format));
+    uint8_t* out = vertices.data();
     
     // Generate vertices
-    int vertexCountX = 0, vertexCountZ = 0;
-    for (int z = startZ; z <= startZ + chunkSize && z < hmHeight; z += step)
+    for (int localZ : samplesZ)
     {
-        vertexCountX = 0;
-        for (int x = startX; x <= startX + chunkSize && x < hmWidth; x += step)
+        int z = startZ + localZ;
+        for (int localX : samplesX)
         {
-            float worldX = worldOffsetX + (x - startX) * cellSize;
-            float worldZ = worldOffsetZ + (z - startZ) * cellSize;
-            float worldY = heightmap.getHeight(x, z) * maxHeight;
-            
-            glm::vec3 normal = calculateNormal(heightmap, x, z, cellSize, maxHeight);
-            
-            float u = static_cast<float>(x) / static_cast<float>(hmWidth - 1);
-            float v = static_cast<float>(z) / static_cast<float>(hmHeight - 1);
-            
-            glm::vec3 tangent = calculateTangent(normal);
+            int x = startX + localX;
+            float height = heightmap.getHeight(x, z);
+            glm::vec3 normal = normals ? normals->getNormal(x, z)
+                                       : TerrainNormalField::calculateNormal(heightmap, x, z, cellSize, maxHeight);
             
-            vertices.push_back(worldX);
-            vertices.push_back(worldY);
-            vertices.push_back(worldZ);
-            vertices.push_back(normal.x);
-            vertices.push_back(normal.y);
-            vertices.push_back(normal.z);
-            vertices.push_back(u);
-            vertices.push_back(v);
-            vertices.push_back(tangent.x);
-            vertices.push_back(tangent.y);
-            vertices.push_back(tangent.z);
+            if (data.format == TerrainVertexFormat::Packed)
+            {
+                // Position and UV are rebuilt in the shader from the global grid coordinate
+                PackedTerrainVertex packed;
+                packed.gridX = static_cast<uint16_t>(x);
+                packed.gridZ = static_cast<uint16_t>(z);
+                packed.height = static_cast<uint16_t>(std::lround(clampValue(height, 0.0f, 1.0f) * 65535.0f));
+                packOctahedral(normal, packed.octNormal);
+                std::memcpy(out, &packed, sizeof(packed));
+                out += sizeof(packed);
+            }
+            else
+            {
+                float worldX = worldOffsetX + (x - startX) * cellSize;
+                float worldZ = worldOffsetZ + (z - startZ) * cellSize;
+                float worldY = height * maxHeight;
+                
+                float u = static_cast<float>(x) / static_cast<float>(hmWidth - 1);
+                float v = static_cast<float>(z) / static_cast<float>(hmHeight - 1);
+                
+                glm::vec3 tangent = normals ? normals->getTangent(x, z) : TerrainNormalField::calculateTangent(normal);
+                
+                const float vertex[11] = {
+                    worldX, worldY, worldZ,
+                    normal.x, normal.y, normal.z,
+                    u, v,
+                    tangent.x, tangent.y, tangent.z
+                };
+                std::memcpy(out, vertex, sizeof(vertex));
+                out += sizeof(vertex);
+            }
             
-            vertexCountX++;
         }
-        vertexCountZ++;
     }
     
-    // Generate indices
-    for (int z = 0; z < vertexCountZ - 1; z++)
+    // Indices depend only on the grid shape and come from TerrainIndexCache
+    data.verticesX = static_cast<int>(samplesX.size());
+    data.verticesZ = static_cast<int>(samplesZ.size());
+}
+
+void TerrainChunk::appendSkirtVertices(TerrainChunkData& data, float depth, float maxHeight)
+{
+    size_t stride = getVertexStride(data.format);
+    int vx = data.verticesX;
+    int vz = data.verticesZ;
+    if (vx < 2 || vz < 2) return;
+    
+    std::vector<uint8_t>& vertices = data.vertices;
+    vertices.reserve(vertices.size() + TerrainIndexCache::getSkirtVertexCount(vx, vz) * stride);
+    
+    // Copy of an edge vertex pushed down by depth
+    auto appendLowered = [&](int x, int z)
     {
-        for (int x = 0; x < vertexCountX - 1; x++)
+        size_t src = (static_cast<size_t>(z) * vx + x) * stride;
+        size_t dst = vertices.size();
+        vertices.resize(dst + stride);
+        std::memcpy(vertices.data() + dst, vertices.data() + src, stride);
+        lowerVertex(vertices.data() + dst, data.format, depth, maxHeight);
+    };
+    
+    // Same order as TerrainIndexCache::buildSkirtIndices expects
+    for (int x = 0; x < vx; x++) appendLowered(x, 0);
+    for (int x = 0; x < vx; x++) appendLowered(x, vz - 1);
+    for (int z = 0; z < vz; z++) appendLowered(0, z);
+    for (int z = 0; z < vz; z++) appendLowered(vx - 1, z);
+}
+
+void TerrainChunk::lowerVertex(uint8_t* vertex, TerrainVertexFormat format, float depth, float maxHeight)
+{
+    // The height sits at byte 4 in both formats
+    if (format == TerrainVertexFormat::Packed)
+    {
+        uint16_t height;
+        std::memcpy(&height, vertex + 4, sizeof(height));
+        float lowered = std::max(0.0f, height / 65535.0f - depth / maxHeight);
+        height = static_cast<uint16_t>(std::lround(lowered * 65535.0f));
+        std::memcpy(vertex + 4, &height, sizeof(height));
+    }
+    else
+    {
+        float y;
+        std::memcpy(&y, vertex + 4, sizeof(y));
+        y -= depth;
+        std::memcpy(vertex + 4, &y, sizeof(y));
+    }
+}
+
+void TerrainChunk::computeLODErrors(const HeightmapLoader& heightmap, int startX, int startZ,
+                                    const std::vector<int>& samplesX, const std::vector<int>& samplesZ,
+                                    float maxHeight, const glm::ivec4* errorRect, float* lodErrors)
+{
+    HeightSamples heights(heightmap);
+    std::vector<int> xs, zs;
+    float maxError = 0.0f;
+    if (!errorRect)
+    {
+        for (int lod = 0; lod < LOD_LEVELS; lod++) lodErrors[lod] = 0.0f;
+    }
+    for (int lod = 0; lod < LOD_LEVELS; lod++)
+    {
+        // LOD samples index the vertex grid, which in turn samples the heightmap
+        TerrainIndexCache::getLODSamples(static_cast<int>(samplesX.size()), lod, xs);
+        TerrainIndexCache::getLODSamples(static_cast<int>(samplesZ.size()), lod, zs);
+        
+        // Compare every heightmap texel against the LOD surface
+        for (size_t j = 0; j + 1 < zs.size(); j++)
         {
-            unsigned int topLeft = z * vertexCountX + x;
-            unsigned int topRight = topLeft + 1;
-            unsigned int bottomLeft = (z + 1) * vertexCountX + x;
-            unsigned int bottomRight = bottomLeft + 1;
-            
-            indices.push_back(topLeft);
-            indices.push_back(bottomLeft);
-            indices.push_back(topRight);
-            
-            indices.push_back(topRight);
-            indices.push_back(bottomLeft);
-            indices.push_back(bottomRight);
+            int z0 = startZ + samplesZ[zs[j]], z1 = startZ + samplesZ[zs[j + 1]];
+            for (size_t i = 0; i + 1 < xs.size(); i++)
+            {
+                int x0 = startX + samplesX[xs[i]], x1 = startX + samplesX[xs[i + 1]];
+                if (errorRect && (x1 < errorRect->x || x0 > errorRect->z || z1 < errorRect->y || z0 > errorRect->w))
+                {
+                    continue;
+                }
+                
+                // A single-texel cell has no texels besides its corners
+                if (x1 - x0 == 1 && z1 - z0 == 1) continue;
+                LODCell cell = { x0, z0, x1, z1, heights.get(x0, z0), heights.get(x1, z0),
+                                 heights.get(x0, z1), heights.get(x1, z1) };
+                
+                // With its corners unchanged a cell's surface is too, so only the changed texels
+                // under it can have moved further from it
+                int sx0 = x0, sz0 = z0, sx1 = x1, sz1 = z1;
+                if (errorRect)
+                {
+                    auto inRect = [&](int x, int z)
+                    {
+                        return x >= errorRect->x && x <= errorRect->z && z >= errorRect->y && z <= errorRect->w;
+                    };
+                    if (!inRect(x0, z0) && !inRect(x1, z0) && !inRect(x0, z1) && !inRect(x1, z1))
+                    {
+                        sx0 = std::max(x0, errorRect->x);
+                        sz0 = std::max(z0, errorRect->y);
+                        sx1 = std::min(x1, errorRect->z);
+                        sz1 = std::min(z1, errorRect->w);
+                    }
+                }
+                
+                // The floor already counts, so blocks below it can be skipped
+                float floorError = errorRect ? std::max(maxError, lodErrors[lod]) : maxError;
+                scanCellError(heights, cell, sx0, sz0, sx1, sz1, maxHeight, floorError);
+                maxError = std::max(maxError, floorError);
+            }
         }
+        // Kept monotonic so coarser never reports less error than finer
+        maxError = std::max(maxError, lodErrors[lod]);
+        lodErrors[lod] = maxError;
     }
+}
+
+void TerrainChunk::render(int lodLevel, unsigned int stitchMask, bool skirts)
+{
+    if (!m_generated) return;
+    lodLevel = clampValue(lodLevel, 0, LOD_LEVELS - 1);
     
-    if (!vertices.empty() && !indices.empty())
+    if (skirts)
     {
-        m_lodMeshes[lodLevel].setVertices(vertices.data(), vertices.size() * sizeof(float),
-                                          VertexLayout::positionNormalTextureTangent());
-        m_lodMeshes[lodLevel].setIndices(indices.data(), indices.size());
-        m_triangleCounts[lodLevel] = static_cast<int>(indices.size() / 3);
+        // Skirt range directly follows the unstitched grid range
+        const TerrainIndexCache::Range& grid = m_indexRanges.lods[lodLevel][0];
+        drawRange(grid.firstIndex, grid.indexCount + m_indexRanges.skirts[lodLevel].indexCount);
+        return;
     }
+    
+    const TerrainIndexCache::Range& range = m_indexRanges.lods[lodLevel][stitchMask % TerrainIndexCache::STITCH_VARIANTS];
+    drawRange(range.firstIndex, range.indexCount);
 }
 
-glm::vec3 TerrainChunk::calculateNormal(const HeightmapLoader& heightmap,
-                                        int x, int z, float cellSize, float maxHeight)
+void TerrainChunk::drawRange(unsigned int firstIndex, unsigned int indexCount)
 {
-    int width = heightmap.getWidth();
-    int height = heightmap.getGridHeight();
-    
-    float hL = heightmap.getHeight(std::max(0, x - 1), z) * maxHeight;
-    float hR = heightmap.getHeight(std::min(width - 1, x + 1), z) * maxHeight;
-    float hD = heightmap.getHeight(x, std::max(0, z - 1)) * maxHeight;
-    float hU = heightmap.getHeight(x, std::min(height - 1, z + 1)) * maxHeight;
-    
-    glm::vec3 normal(hL - hR, 2.0f * cellSize, hD - hU);
-    return glm::normalize(normal);
+    if (m_arena)
+    {
+        m_arena->addDraw(m_indexRanges.indexType, m_arenaFirstIndex + firstIndex, indexCount, m_arenaBaseVertex);
+        return;
+    }
+    m_mesh.drawRange(firstIndex, indexCount);
 }
 
-glm::vec3 TerrainChunk::calculateTangent(const glm::vec3& normal)
+void TerrainChunk::releaseArena()
 {
-    // For terrain, tangent is along +X axis (texture U direction)
-    // Then orthogonalize with respect to normal using Gram-Schmidt
-    glm::vec3 tangent(1.0f, 0.0f, 0.0f);
-    
-    // Gram-Schmidt orthogonalization
-    tangent = tangent - glm::dot(tangent, normal) * normal;
-    
-    // Handle edge case where normal is parallel to X axis
-    if (glm::length(tangent) < 0.001f)
+    if (m_arena && m_vertexBytes > 0)
     {
-        tangent = glm::vec3(0.0f, 0.0f, 1.0f);
-        tangent = tangent - glm::dot(tangent, normal) * normal;
+        m_arena->deallocate(m_arenaBaseVertex, m_vertexBytes);
     }
-    
-    return glm::normalize(tangent);
+    m_vertexBytes = 0;
 }
 
-void TerrainChunk::render(int lodLevel)
+size_t TerrainChunk::getVertexStride(TerrainVertexFormat format)
+{
+    return format == TerrainVertexFormat::Packed ? sizeof(PackedTerrainVertex) : 11 * sizeof(float);
+}
+
+VertexLayout TerrainChunk::getVertexLayout(TerrainVertexFormat format)
+{
+    return format == TerrainVertexFormat::Packed ? VertexLayout::packedGridHeightNormal()
+                                                 : VertexLayout::positionNormalTextureTangent();
+}
+
+float TerrainChunk::getLODError(int lodLevel) const
 {
-    if (!m_generated) return;
     lodLevel = clampValue(lodLevel, 0, LOD_LEVELS - 1);
-    m_lodMeshes[lodLevel].draw();
+    return m_lodErrors[lodLevel];
 }
 
-int TerrainChunk::getTriangleCount(int lodLevel) const
+int TerrainChunk::getTriangleCount(int lodLevel, unsigned int stitchMask, bool skirts) const
 {
     lodLevel = clampValue(lodLevel, 0, LOD_LEVELS - 1);
-    return m_triangleCounts[lodLevel];
+    if (skirts)
+    {
+        return static_cast<int>((m_indexRanges.lods[lodLevel][0].indexCount +
+                                 m_indexRanges.skirts[lodLevel].indexCount) / 3);
+    }
+    return static_cast<int>(m_indexRanges.lods[lodLevel][stitchMask % TerrainIndexCache::STITCH_VARIANTS].indexCount / 3);
 }
@@ -8,13 +8,58 @@
 #define TERRAIN_CHUNK_H
 
 #include "HeightmapLoader.h"
+#include "TerrainIndexCache.h"
+#include "TerrainNormalField.h"
 #include "Core/Mesh.h"
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+enum class TerrainVertexFormat
+{
+    Standard,   // positionNormalTextureTangent, 44 bytes
+    Packed      // packedGridHeightNormal, 8 bytes, decoded in the vertex shader
+};
+
+class TerrainDrawArena;
+
+/**
+ * @brief CPU-side mesh data for one chunk, built off the GL thread
+ */
+struct TerrainChunkData
+{
+    TerrainVertexFormat format;
+    std::vector<uint8_t> vertices;  // full-resolution grid; every LOD indexes into it
+    int verticesX;
+    int verticesZ;
+    float lodErrors[TerrainIndexCache::LOD_LEVELS];  // max vertical error vs. full detail, world units
+    glm::vec3 min, max;
+};
+
+/**
+ * @brief Vertices of one uploaded chunk mesh rebuilt after a heightmap edit, as runs of
+ *        consecutive vertices, plus the mesh's new bounds and LOD errors
+ */
+struct TerrainChunkPatch
+{
+    struct Run
+    {
+        size_t firstVertex;
+        size_t vertexCount;
+    };
+    
+    TerrainVertexFormat format;
+    std::vector<Run> runs;
+    std::vector<uint8_t> vertices;  // every run's vertices, back to back in run order
+    float lodErrors[TerrainIndexCache::LOD_LEVELS];  // the mesh's errors on input, raised over the edit
+    glm::vec3 min, max;             // the mesh's bounds on input, its bounds after the edit on output
+};
 
 class TerrainChunk
 {
 public:
-    static const int LOD_LEVELS = 4;
+    static const int LOD_LEVELS = TerrainIndexCache::LOD_LEVELS;
+    static const int PACKED_GRID_LIMIT = 65536;     // Packed stores grid X/Z as uint16
     
     TerrainChunk();
     ~TerrainChunk();
@@ -25,33 +70,103 @@ public:
     TerrainChunk(const TerrainChunk&) = delete;
     TerrainChunk& operator=(const TerrainChunk&) = delete;
     
-    void generate(const HeightmapLoader& heightmap,
-                  int startX, int startZ, int chunkSize,
-                  float worldSize, float terrainSize, float maxHeight);
+    // Thread-safe: only reads the heightmap; normals are computed for this region alone with
+    // normalPath. sampleLevel > 0 builds a coarse mesh over every (1 << sampleLevel)-th texel,
+    // used by quadtree nodes.
+    // skirts appends the edge skirt vertices; without them render() must not draw skirts.
+    static void build(const HeightmapLoader& heightmap, TerrainNormalField::Path normalPath,
+                      int startX, int startZ, int sizeX, int sizeZ,
+                      float terrainSize, float maxHeight,
+                      TerrainVertexFormat format, bool skirts, TerrainChunkData& data,
+                      int sampleLevel = 0);
+    
+    /**
+     * @brief Rebuild only what an edit of texels changed (x0, z0, x1, z1) touches in a mesh that
+     *        build() made with the same arguments. Thread-safe like build().
+     *
+     * Covers the grid vertices whose height or normal reads a changed texel, and the skirt
+     * vertices below them (all of the skirt when the bounds, and so the skirt depth, moved).
+     * The LOD errors are rescanned over the changed texels only, with patch.lodErrors as a floor,
+     * so they never drop until the next full build. The result is byte-identical to a build().
+     */
+    static void buildPatch(const HeightmapLoader& heightmap, TerrainNormalField::Path normalPath,
+                           int startX, int startZ, int sizeX, int sizeZ,
+                           float terrainSize, float maxHeight,
+                           TerrainVertexFormat format, bool skirts, int sampleLevel,
+                           const glm::ivec4& changed, TerrainChunkPatch& patch);
+    
+    /**
+     * @brief Keep this chunk's vertices in a shared arena instead of its own buffer
+     *
+     * Set before upload(); render() then queues draws for TerrainDrawArena::flush().
+     * The arena must outlive the chunk. nullptr draws the chunk on its own again.
+     */
+    void setDrawArena(TerrainDrawArena* arena);
+    
+    // Must run on the GL context thread; LOD index ranges come from the shared cache
+    void upload(const TerrainChunkData& data, TerrainIndexCache& indexCache);
     
-    void render(int lodLevel);
+    // As above, with the vertices taken from elsewhere (e.g. a mapped mesh cache) instead of data.vertices
+    void upload(const TerrainChunkData& data, TerrainIndexCache& indexCache,
+                const uint8_t* vertices, size_t vertexBytes);
+    
+    // Upload a buildPatch() result over the mesh and take its bounds and LOD errors. GL thread.
+    void applyPatch(const TerrainChunkPatch& patch);
+    
+    // Free the GPU mesh; bounds and LOD errors are kept
+    void release();
+    
+    /**
+     * @param stitchMask TerrainIndexCache::Edge bits of neighbours one LOD coarser
+     * @param skirts Also draw the edge skirts (instead of stitching)
+     *
+     * In a draw arena the draw is only queued.
+     */
+    void render(int lodLevel, unsigned int stitchMask = 0, bool skirts = false);
     
     glm::vec3 getMin() const { return m_min; }
     glm::vec3 getMax() const { return m_max; }
     glm::vec3 getCenter() const { return m_center; }
     
-    int getTriangleCount(int lodLevel) const;
+    int getTriangleCount(int lodLevel, unsigned int stitchMask = 0, bool skirts = false) const;
+    float getLODError(int lodLevel) const;
+    size_t getVertexMemoryBytes() const { return m_vertexBytes; }
+    unsigned int getIndexCount() const { return m_indexRanges.totalIndexCount; }
+    const TerrainIndexCache::Buffer& getIndexRanges() const { return m_indexRanges; }
+    
+    // Where upload() placed the mesh in its draw arena; ranges of getIndexRanges() are relative to the first index
+    unsigned int getArenaBaseVertex() const { return m_arenaBaseVertex; }
+    unsigned int getArenaFirstIndex() const { return m_arenaFirstIndex; }
+    
+    static size_t getVertexStride(TerrainVertexFormat format);
+    static VertexLayout getVertexLayout(TerrainVertexFormat format);
     bool isGenerated() const { return m_generated; }
     
 private:
-    Mesh m_lodMeshes[LOD_LEVELS];
-    int m_triangleCounts[LOD_LEVELS];
+    Mesh m_mesh;
+    TerrainDrawArena* m_arena;
+    unsigned int m_arenaBaseVertex;
+    unsigned int m_arenaFirstIndex;     // of m_indexRanges' copy in the arena
+    TerrainIndexCache::Buffer m_indexRanges;
+    float m_lodErrors[LOD_LEVELS];
+    size_t m_vertexBytes;
     glm::vec3 m_min, m_max, m_center;
     bool m_generated;
     
-    void generateLODMesh(const HeightmapLoader& heightmap,
-                         int startX, int startZ, int chunkSize,
-                         float worldOffsetX, float worldOffsetZ,
-                         float cellSize, float maxHeight, int lodLevel);
+    void drawRange(unsigned int firstIndex, unsigned int indexCount);
+    void releaseArena();
     
-    glm::vec3 calculateNormal(const HeightmapLoader& heightmap,
-                              int x, int z, float cellSize, float maxHeight);
-    glm::vec3 calculateTangent(const glm::vec3& normal);
+    static void buildVertices(const HeightmapLoader& heightmap, const TerrainNormalField* normals,
+                              int startX, int startZ,
+                              const std::vector<int>& samplesX, const std::vector<int>& samplesZ,
+                              float worldOffsetX, float worldOffsetZ,
+                              float cellSize, float maxHeight,
+                              TerrainChunkData& data);
+    static void appendSkirtVertices(TerrainChunkData& data, float depth, float maxHeight);
+    static void lowerVertex(uint8_t* vertex, TerrainVertexFormat format, float depth, float maxHeight);
+    static void computeLODErrors(const HeightmapLoader& heightmap, int startX, int startZ,
+                                 const std::vector<int>& samplesX, const std::vector<int>& samplesZ,
+                                 float maxHeight, const glm::ivec4* errorRect, float* lodErrors);
 };
 
 #endif
@@ -0,0 +1,320 @@
+#include "TerrainChunkBounds.h"
+#include "Core/CpuFeatures.h"
+#include <algorithm>
+#include <bitset>
+#include <limits>
+
+#ifdef ROAMING_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const float FLOAT_MAX = std::numeric_limits<float>::max();
+    
+    // Same operation order as glm::dot in Frustum::isBoxVisible
+    bool isOutside(const glm::vec4& plane, float x, float y, float z)
+    {
+        return plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f;
+    }
+}
+
+TerrainChunkBounds::TerrainChunkBounds()
+    : m_unionMin(FLOAT_MAX)
+    , m_unionMax(-FLOAT_MAX)
+    , m_groupsPerRow(0)
+    , m_planeTests(0)
+{
+}
+
+void TerrainChunkBounds::resize(size_t count, size_t columns)
+{
+    for (auto* component : { &m_minX, &m_minY, &m_minZ, &m_maxX, &m_maxY, &m_maxZ })
+    {
+        component->assign(count, 0.0f);
+    }
+    
+    // Groups only line up into tiles when every row starts a new one
+    m_groupsPerRow = (columns > 0 && columns % GROUP_SIZE == 0) ? columns / GROUP_SIZE : 0;
+    m_blockMin.assign(getBlockCount(), glm::vec3(FLOAT_MAX));
+    m_blockMax.assign(getBlockCount(), glm::vec3(-FLOAT_MAX));
+    m_unionMin = glm::vec3(FLOAT_MAX);
+    m_unionMax = glm::vec3(-FLOAT_MAX);
+}
+
+void TerrainChunkBounds::set(size_t index, const glm::vec3& min, const glm::vec3& max)
+{
+    m_minX[index] = min.x;
+    m_minY[index] = min.y;
+    m_minZ[index] = min.z;
+    m_maxX[index] = max.x;
+    m_maxY[index] = max.y;
+    m_maxZ[index] = max.z;
+    
+    // Bounds only grow; resize() starts them over
+    size_t block = getBlockOfGroup(index / GROUP_SIZE);
+    m_blockMin[block] = glm::min(m_blockMin[block], min);
+    m_blockMax[block] = glm::max(m_blockMax[block], max);
+    m_unionMin = glm::min(m_unionMin, min);
+    m_unionMax = glm::max(m_unionMax, max);
+}
+
+size_t TerrainChunkBounds::getBlockCount() const
+{
+    size_t groups = getGroupCount();
+    if (m_groupsPerRow == 0) return (groups + BLOCK_GROUPS - 1) / BLOCK_GROUPS;
+    size_t rows = (groups + m_groupsPerRow - 1) / m_groupsPerRow;
+    return (rows + BLOCK_GROUPS - 1) / BLOCK_GROUPS * m_groupsPerRow;
+}
+
+size_t TerrainChunkBounds::getBlockOfGroup(size_t group) const
+{
+    if (m_groupsPerRow == 0) return group / BLOCK_GROUPS;
+    return group / m_groupsPerRow / BLOCK_GROUPS * m_groupsPerRow + group % m_groupsPerRow;
+}
+
+size_t TerrainChunkBounds::getBlockGroup(size_t block, size_t k) const
+{
+    size_t group = m_groupsPerRow == 0 ? block * BLOCK_GROUPS + k
+        : (block / m_groupsPerRow * BLOCK_GROUPS + k) * m_groupsPerRow + block % m_groupsPerRow;
+    return std::min(group, getGroupCount());
+}
+
+TerrainChunkBounds::Path TerrainChunkBounds::getBestPath()
+{
+    return CpuFeatures::get().getBestPath();
+}
+
+const char* TerrainChunkBounds::getPathName(Path path)
+{
+    return CpuFeatures::getPathName(path);
+}
+
+size_t TerrainChunkBounds::cull(const Frustum& frustum, std::vector<uint8_t>& visible, Path path)
+{
+    size_t count = size();
+    size_t groups = getGroupCount();
+    size_t blocks = getBlockCount();
+    visible.assign(groups, 0);
+    m_planeTests = 0;
+    if (count == 0) return 0;
+    
+    // The p-vertex corner depends only on the plane's signs, so it is picked once per plane
+    Planes planes;
+    const glm::vec4* frustumPlanes = frustum.getPlanes();
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+    {
+        const glm::vec4& plane = frustumPlanes[p];
+        planes.plane[p] = plane;
+        planes.x[p] = plane.x >= 0.0f ? m_maxX.data() : m_minX.data();
+        planes.y[p] = plane.y >= 0.0f ? m_maxY.data() : m_minY.data();
+        planes.z[p] = plane.z >= 0.0f ? m_maxZ.data() : m_minZ.data();
+    }
+    
+    // Planes every box is inside need no test at all; a set wholly outside needs none either
+    size_t tests = Frustum::PLANE_COUNT;
+    unsigned int rootMask = Frustum::ALL_PLANES;
+    uint8_t rootPlane = Frustum::PLANE_COUNT;
+    if (frustum.classifyBox(m_unionMin, m_unionMax, rootMask, rootPlane) == Frustum::OUTSIDE)
+    {
+        m_planeTests = tests;
+        return 0;
+    }
+    
+    // Path values are ordered by width
+    path = std::min(path, getBestPath());
+    for (size_t block = 0; block < blocks; block++)
+    {
+        Active active;
+        active.mask = rootMask;
+        if (active.mask != 0)
+        {
+            tests += std::bitset<Frustum::PLANE_COUNT>(active.mask).count();
+            uint8_t lastPlane = Frustum::PLANE_COUNT;
+            if (frustum.classifyBox(m_blockMin[block], m_blockMax[block], active.mask, lastPlane) == Frustum::OUTSIDE)
+            {
+                continue;
+            }
+        }
+        
+        // Inside every plane: the whole block, untested
+        if (active.mask == 0)
+        {
+            for (size_t k = 0; k < BLOCK_GROUPS; k++)
+            {
+                size_t group = getBlockGroup(block, k);
+                if (group >= groups) break;
+                size_t boxes = std::min(count - group * GROUP_SIZE, GROUP_SIZE);
+                visible[group] = static_cast<uint8_t>((1u << boxes) - 1);
+            }
+            continue;
+        }
+        
+        active.count = 0;
+        for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+        {
+            if (active.mask & (1u << p)) active.plane[active.count++] = p;
+        }
+        if (path == Path::AVX2) cullBlockAVX2(planes, active, block, visible.data(), tests);
+        else if (path == Path::SSE2) cullBlockSSE2(planes, active, block, visible.data(), tests);
+        else cullBlockScalar(planes, active, block, visible.data(), tests);
+    }
+    m_planeTests = tests;
+    
+    size_t visibleCount = 0;
+    for (uint8_t bits : visible)
+    {
+        visibleCount += std::bitset<8>(bits).count();
+    }
+    return visibleCount;
+}
+
+uint8_t TerrainChunkBounds::cullGroupScalar(const Planes& planes, const Active& active, size_t group, size_t& tests) const
+{
+    size_t first = group * GROUP_SIZE;
+    size_t last = std::min(first + GROUP_SIZE, size());
+    unsigned int bits = 0;
+    size_t tested = 0;
+    for (size_t i = first; i < last; i++)
+    {
+        bool inside = true;
+        for (int k = 0; k < active.count && inside; k++)
+        {
+            int p = active.plane[k];
+            tested++;
+            inside = !isOutside(planes.plane[p], planes.x[p][i], planes.y[p][i], planes.z[p][i]);
+        }
+        if (inside) bits |= 1u << (i - first);
+    }
+    tests += tested;
+    return static_cast<uint8_t>(bits);
+}
+
+void TerrainChunkBounds::cullBlockScalar(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                                         size_t& tests) const
+{
+    for (size_t k = 0; k < BLOCK_GROUPS; k++)
+    {
+        size_t group = getBlockGroup(block, k);
+        if (group >= getGroupCount()) break;
+        visible[group] = cullGroupScalar(planes, active, group, tests);
+    }
+}
+
+#ifdef ROAMING_SIMD_X86
+
+namespace
+{
+    // Lanes of the 4 boxes from i whose p-vertex is outside the plane
+    __m128 outsideSSE2(const glm::vec4& plane, const float* x, const float* y, const float* z, size_t i)
+    {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(x + i)),
+            _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(y + i))),
+            _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(z + i))),
+            _mm_set1_ps(plane.w));
+        return _mm_cmplt_ps(distance, _mm_setzero_ps());
+    }
+    
+    // The same for 8 boxes; multiply and add kept separate (no FMA) so rounding matches the scalar test
+    ROAMING_TARGET_AVX2
+    __m256 outsideAVX2(const __m256* plane, const float* x, const float* y, const float* z, size_t i)
+    {
+        __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(plane[0], _mm256_loadu_ps(x + i)),
+            _mm256_mul_ps(plane[1], _mm256_loadu_ps(y + i))),
+            _mm256_mul_ps(plane[2], _mm256_loadu_ps(z + i))),
+            plane[3]);
+        return _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ);
+    }
+}
+
+void TerrainChunkBounds::cullBlockSSE2(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                                       size_t& tests) const
+{
+    size_t groups = getGroupCount();
+    size_t tested = 0;
+    for (size_t k = 0; k < BLOCK_GROUPS; k++)
+    {
+        size_t group = getBlockGroup(block, k);
+        if (group >= groups) break;
+        size_t i = group * GROUP_SIZE;
+        if (i + GROUP_SIZE > size())
+        {
+            visible[group] = cullGroupScalar(planes, active, group, tested);
+            continue;
+        }
+        
+        // Two halves of 4 make up one mask byte
+        int bits = 0;
+        for (size_t half = 0; half < GROUP_SIZE; half += 4)
+        {
+            __m128 outside = _mm_setzero_ps();
+            for (int a = 0; a < active.count && _mm_movemask_ps(outside) != 0xF; a++)
+            {
+                int p = active.plane[a];
+                outside = _mm_or_ps(outside, outsideSSE2(planes.plane[p], planes.x[p], planes.y[p], planes.z[p], i + half));
+                tested += 4;
+            }
+            bits |= (~_mm_movemask_ps(outside) & 0xF) << half;
+        }
+        visible[group] = static_cast<uint8_t>(bits);
+    }
+    tests += tested;
+}
+
+ROAMING_TARGET_AVX2
+void TerrainChunkBounds::cullBlockAVX2(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                                       size_t& tests) const
+{
+    __m256 broadcast[Frustum::PLANE_COUNT][4];
+    for (int a = 0; a < active.count; a++)
+    {
+        const glm::vec4& plane = planes.plane[active.plane[a]];
+        for (int c = 0; c < 4; c++)
+        {
+            broadcast[active.plane[a]][c] = _mm256_set1_ps(plane[c]);
+        }
+    }
+    
+    size_t groups = getGroupCount();
+    size_t tested = 0;
+    for (size_t k = 0; k < BLOCK_GROUPS; k++)
+    {
+        size_t group = getBlockGroup(block, k);
+        if (group >= groups) break;
+        size_t i = group * GROUP_SIZE;
+        if (i + GROUP_SIZE > size())
+        {
+            visible[group] = cullGroupScalar(planes, active, group, tested);
+            continue;
+        }
+        
+        // Neighbouring chunks tend to leave through the same plane, so whole groups often stop early
+        __m256 outside = _mm256_setzero_ps();
+        for (int a = 0; a < active.count && _mm256_movemask_ps(outside) != 0xFF; a++)
+        {
+            int p = active.plane[a];
+            outside = _mm256_or_ps(outside, outsideAVX2(broadcast[p], planes.x[p], planes.y[p], planes.z[p], i));
+            tested += 8;
+        }
+        visible[group] = static_cast<uint8_t>(~_mm256_movemask_ps(outside));
+    }
+    tests += tested;
+}
+
+#else
+
+void TerrainChunkBounds::cullBlockSSE2(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                                       size_t& tests) const
+{
+    cullBlockScalar(planes, active, block, visible, tests);
+}
+
+void TerrainChunkBounds::cullBlockAVX2(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                                       size_t& tests) const
+{
+    cullBlockScalar(planes, active, block, visible, tests);
+}
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * @file TerrainChunkBounds.h
+ * @brief Chunk AABBs in structure-of-arrays form, frustum-tested in batches with SSE2/AVX2
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_CHUNK_BOUNDS_H
+#define TERRAIN_CHUNK_BOUNDS_H
+
+#include "Frustum.h"
+#include "Core/CpuFeatures.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * The culling loop only needs six floats per chunk; reading them out of TerrainChunk (meshes,
+ * LOD ranges, arena offsets) touches a cache line or more per box. Here each component is its
+ * own array, so the AVX2 kernel loads 8 boxes' worth with one load per component and tests
+ * them against each plane at once. Results match Frustum::isBoxVisible exactly.
+ *
+ * Above the groups of 8 sit blocks of 8 groups with their union box, and above those the union
+ * of everything. Each level is classified with Frustum::classifyBox: an outside block skips its
+ * 64 boxes, an inside one sets them without a test, and planes a block is inside of are dropped
+ * for its groups, which then only test the planes their block crosses.
+ */
+class TerrainChunkBounds
+{
+public:
+    using Path = SimdPath;
+
+    static const size_t GROUP_SIZE = 8;     // boxes per mask byte and per AVX2 batch
+    static const size_t BLOCK_GROUPS = 8;   // groups per block
+
+    TerrainChunkBounds();
+
+    /**
+     * @param columns Row length when the boxes are a row-major grid, else 0. With a multiple of
+     *                GROUP_SIZE, blocks are 8 x 8 box tiles instead of runs of 64 boxes
+     */
+    void resize(size_t count, size_t columns = 0);
+    size_t size() const { return m_minX.size(); }
+
+    void set(size_t index, const glm::vec3& min, const glm::vec3& max);
+    glm::vec3 getMin(size_t index) const { return glm::vec3(m_minX[index], m_minY[index], m_minZ[index]); }
+    glm::vec3 getMax(size_t index) const { return glm::vec3(m_maxX[index], m_maxY[index], m_maxZ[index]); }
+
+    /**
+     * @brief Frustum-test every box (p-vertex test, as Frustum::isBoxVisible)
+     * @param visible Resized to (size() + 7) / 8 bytes; bit (i & 7) of byte i / 8 is set when box i
+     *                is at least partly inside
+     * @param path Widest path to use, limited to what the CPU supports (Scalar for comparison)
+     * @return Number of visible boxes
+     */
+    size_t cull(const Frustum& frustum, std::vector<uint8_t>& visible, Path path = Path::AVX2);
+
+    // Box-plane tests done by the last cull(), block tests included, counting every SIMD lane
+    size_t getPlaneTests() const { return m_planeTests; }
+
+    static bool isVisible(const std::vector<uint8_t>& visible, size_t index)
+    {
+        return ((visible[index >> 3] >> (index & 7)) & 1) != 0;
+    }
+
+    // Widest path the CPU supports
+    static Path getBestPath();
+    static const char* getPathName(Path path);
+
+private:
+    std::vector<float> m_minX;
+    std::vector<float> m_minY;
+    std::vector<float> m_minZ;
+    std::vector<float> m_maxX;
+    std::vector<float> m_maxY;
+    std::vector<float> m_maxZ;
+    std::vector<glm::vec3> m_blockMin;
+    std::vector<glm::vec3> m_blockMax;
+    glm::vec3 m_unionMin;
+    glm::vec3 m_unionMax;
+    size_t m_groupsPerRow;  // tiled blocks: groups per grid row; 0 for runs of groups
+    size_t m_planeTests;
+
+    // Per plane, the component arrays holding its p-vertex
+    struct Planes
+    {
+        const float* x[Frustum::PLANE_COUNT];
+        const float* y[Frustum::PLANE_COUNT];
+        const float* z[Frustum::PLANE_COUNT];
+        glm::vec4 plane[Frustum::PLANE_COUNT];
+    };
+
+    // Planes a block still crosses
+    struct Active
+    {
+        unsigned int mask;
+        int plane[Frustum::PLANE_COUNT];
+        int count;
+    };
+
+    size_t getGroupCount() const { return (size() + GROUP_SIZE - 1) / GROUP_SIZE; }
+    size_t getBlockCount() const;
+    size_t getBlockOfGroup(size_t group) const;
+    // Group k of a block, or getGroupCount() past the edge of the grid
+    size_t getBlockGroup(size_t block, size_t k) const;
+
+    // Each tests the groups of one block; a group of fewer than 8 boxes goes to cullGroupScalar
+    void cullBlockScalar(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                         size_t& tests) const;
+    void cullBlockSSE2(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                       size_t& tests) const;
+    void cullBlockAVX2(const Planes& planes, const Active& active, size_t block, uint8_t* visible,
+                       size_t& tests) const;
+    uint8_t cullGroupScalar(const Planes& planes, const Active& active, size_t group, size_t& tests) const;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include "TerrainDrawArena.h"
+#include <algorithm>
+
+namespace {
+    // Smallest vertex buffer created, in vertices; later growth doubles it
+    const unsigned int MIN_VERTEX_CAPACITY = 1 << 16;
+}
+
+TerrainDrawArena::TerrainDrawArena()
+    : m_vao(0)
+    , m_vertexBuffer(0)
+    , m_commandBuffer(0)
+    , m_format(TerrainVertexFormat::Standard)
+    , m_stride(TerrainChunk::getVertexStride(TerrainVertexFormat::Standard))
+    , m_vertexCapacity(0)
+    , m_vertexEnd(0)
+    , m_usedVertices(0)
+    , m_reserveBytes(0)
+    , m_indices()
+{
+}
+
+TerrainDrawArena::~TerrainDrawArena()
+{
+    clear();
+}
+
+unsigned int TerrainDrawArena::allocate(TerrainVertexFormat format, const uint8_t* vertices, size_t vertexBytes)
+{
+    if (m_vao == 0 || format != m_format)
+    {
+        clear();
+        m_format = format;
+        m_stride = TerrainChunk::getVertexStride(format);
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_commandBuffer);
+    }
+    
+    unsigned int count = static_cast<unsigned int>(vertexBytes / m_stride);
+    unsigned int first = m_vertexEnd;
+    
+    // First fit from the holes released meshes left, else append
+    auto hole = std::find_if(m_freeRanges.begin(), m_freeRanges.end(),
+                             [count](const std::pair<const unsigned int, unsigned int>& r) { return r.second >= count; });
+    if (hole != m_freeRanges.end())
+    {
+        first = hole->first;
+        unsigned int remaining = hole->second - count;
+        m_freeRanges.erase(hole);
+        if (remaining > 0) m_freeRanges[first + count] = remaining;
+    }
+    else
+    {
+        if (m_vertexEnd + count > m_vertexCapacity) growVertices(m_vertexEnd + count);
+        m_vertexEnd += count;
+    }
+    m_usedVertices += count;
+    
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(first) * m_stride, static_cast<GLsizeiptr>(count * m_stride), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return first;
+}
+
+void TerrainDrawArena::update(unsigned int baseVertex, size_t offset, const void* data, size_t bytes)
+{
+    if (m_vertexBuffer == 0 || bytes == 0) return;
+    
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(baseVertex * m_stride + offset),
+                    static_cast<GLsizeiptr>(bytes), data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TerrainDrawArena::deallocate(unsigned int baseVertex, size_t vertexBytes)
+{
+    unsigned int count = static_cast<unsigned int>(vertexBytes / m_stride);
+    if (count == 0 || baseVertex + count > m_vertexEnd) return;
+    m_usedVertices -= count;
+    
+    // Merge with the holes on either side, so streaming churn does not fragment the buffer
+    auto next = m_freeRanges.find(baseVertex + count);
+    if (next != m_freeRanges.end())
+    {
+        count += next->second;
+        m_freeRanges.erase(next);
+    }
+    auto prev = m_freeRanges.lower_bound(baseVertex);
+    if (prev != m_freeRanges.begin() && (--prev)->first + prev->second == baseVertex)
+    {
+        baseVertex = prev->first;
+        count += prev->second;
+        m_freeRanges.erase(prev);
+    }
+    
+    if (baseVertex + count == m_vertexEnd)
+    {
+        m_vertexEnd = baseVertex;
+    }
+    else
+    {
+        m_freeRanges[baseVertex] = count;
+    }
+}
+
+unsigned int TerrainDrawArena::addIndices(const TerrainIndexCache::Buffer& indices)
+{
+    auto found = m_indexCopies.find(indices.ebo);
+    if (found != m_indexCopies.end()) return found->second.firstIndex;
+    
+    int type = indices.indexType == GL_UNSIGNED_SHORT ? SHORT_INDICES : INT_INDICES;
+    size_t indexSize = Mesh::getIndexSize(indices.indexType);
+    IndexBuffer& target = m_indices[type];
+    
+    if (target.count + indices.totalIndexCount > target.capacity)
+    {
+        unsigned int capacity = std::max(target.count + indices.totalIndexCount, target.capacity * 2);
+        target.buffer = growBuffer(target.buffer, target.count * indexSize, capacity * indexSize);
+        target.capacity = capacity;
+    }
+    
+    // GPU to GPU; the shared buffer keeps serving chunks drawn one at a time
+    glBindBuffer(GL_COPY_READ_BUFFER, indices.ebo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, static_cast<GLintptr>(target.count * indexSize),
+                        static_cast<GLsizeiptr>(indices.totalIndexCount * indexSize));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    IndexCopy copy = { type, target.count };
+    m_indexCopies[indices.ebo] = copy;
+    target.count += indices.totalIndexCount;
+    return copy.firstIndex;
+}
+
+void TerrainDrawArena::addDraw(GLenum indexType, unsigned int firstIndex, unsigned int indexCount,
+                               unsigned int baseVertex)
+{
+    if (indexCount == 0) return;
+    
+    DrawCommand command = { indexCount, 1, firstIndex, static_cast<int>(baseVertex), 0 };
+    m_indices[indexType == GL_UNSIGNED_SHORT ? SHORT_INDICES : INT_INDICES].draws.push_back(command);
+}
+
+int TerrainDrawArena::flush()
+{
+    m_commands.clear();
+    for (IndexBuffer& indices : m_indices)
+    {
+        m_commands.insert(m_commands.end(), indices.draws.begin(), indices.draws.end());
+    }
+    if (m_commands.empty() || m_vao == 0)
+    {
+        for (IndexBuffer& indices : m_indices) indices.draws.clear();
+        return 0;
+    }
+    
+    // Orphaned every pass, so the driver never waits on the previous pass's commands
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(m_commands.size() * sizeof(DrawCommand)),
+                 m_commands.data(), GL_STREAM_DRAW);
+    glBindVertexArray(m_vao);
+    
+    int drawCalls = 0;
+    size_t offset = 0;
+    for (int type = 0; type < INDEX_TYPES; type++)
+    {
+        IndexBuffer& indices = m_indices[type];
+        if (indices.draws.empty()) continue;
+        
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, type == SHORT_INDICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                                    reinterpret_cast<const void*>(offset * sizeof(DrawCommand)),
+                                    static_cast<GLsizei>(indices.draws.size()), 0);
+        offset += indices.draws.size();
+        indices.draws.clear();
+        drawCalls++;
+    }
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return drawCalls;
+}
+
+int TerrainDrawArena::drawIndirect(unsigned int commandBuffer, unsigned int maxDraws)
+{
+    if (m_vao == 0 || maxDraws == 0) return 0;
+    
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBindVertexArray(m_vao);
+    
+    // GL 4.5 has no draw count read from a buffer (glMultiDrawElementsIndirectCount is 4.6),
+    // so the zero-count commands past the written ones are submitted too
+    int drawCalls = 0;
+    for (int type = 0; type < INDEX_TYPES; type++)
+    {
+        if (m_indices[type].count == 0) continue;
+        
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices[type].buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, type == SHORT_INDICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                                    reinterpret_cast<const void*>(type * maxDraws * sizeof(DrawCommand)),
+                                    static_cast<GLsizei>(maxDraws), 0);
+        drawCalls++;
+    }
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return drawCalls;
+}
+
+void TerrainDrawArena::takeDraws(std::vector<DrawCommand>& shortDraws, std::vector<DrawCommand>& intDraws)
+{
+    shortDraws.swap(m_indices[SHORT_INDICES].draws);
+    intDraws.swap(m_indices[INT_INDICES].draws);
+    m_indices[SHORT_INDICES].draws.clear();
+    m_indices[INT_INDICES].draws.clear();
+}
+
+void TerrainDrawArena::clear()
+{
+    if (m_vao != 0) glDeleteVertexArrays(1, &m_vao);
+    if (m_vertexBuffer != 0) glDeleteBuffers(1, &m_vertexBuffer);
+    if (m_commandBuffer != 0) glDeleteBuffers(1, &m_commandBuffer);
+    for (IndexBuffer& indices : m_indices)
+    {
+        if (indices.buffer != 0) glDeleteBuffers(1, &indices.buffer);
+        indices = IndexBuffer();
+    }
+    
+    m_vao = 0;
+    m_vertexBuffer = 0;
+    m_commandBuffer = 0;
+    m_vertexCapacity = 0;
+    m_vertexEnd = 0;
+    m_usedVertices = 0;
+    m_freeRanges.clear();
+    m_indexCopies.clear();
+    m_commands.clear();
+}
+
+size_t TerrainDrawArena::getIndexMemoryBytes() const
+{
+    return m_indices[SHORT_INDICES].capacity * sizeof(unsigned short) +
+           m_indices[INT_INDICES].capacity * sizeof(unsigned int);
+}
+
+void TerrainDrawArena::growVertices(unsigned int minVertices)
+{
+    unsigned int capacity = std::max({ minVertices, m_vertexCapacity * 2, MIN_VERTEX_CAPACITY });
+    if (m_vertexCapacity == 0)
+    {
+        capacity = std::max(capacity, static_cast<unsigned int>(m_reserveBytes / m_stride));
+    }
+    
+    m_vertexBuffer = growBuffer(m_vertexBuffer, m_vertexEnd * m_stride, capacity * m_stride);
+    m_vertexCapacity = capacity;
+    bindVertexLayout();
+}
+
+void TerrainDrawArena::bindVertexLayout()
+{
+    // Attribute pointers capture the buffer, so they are re-pointed whenever it is replaced
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    TerrainChunk::getVertexLayout(m_format).setAttribPointers();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+unsigned int TerrainDrawArena::growBuffer(unsigned int buffer, size_t usedBytes, size_t newBytes)
+{
+    unsigned int grown = 0;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newBytes), nullptr, GL_STATIC_DRAW);
+    
+    if (buffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(usedBytes));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return grown;
+}
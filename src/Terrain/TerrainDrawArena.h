@@ -0,0 +1,126 @@
+/**
+ * @file TerrainDrawArena.h
+ * @brief Shared vertex/index buffers that draw every queued terrain mesh in one multi-draw call
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_DRAW_ARENA_H
+#define TERRAIN_DRAW_ARENA_H
+
+#include "TerrainChunk.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/*
+ * All meshes of one terrain live in a single vertex buffer (one VAO), addressed through
+ * baseVertex. Each grid shape's shared index buffer is copied once into an index buffer per
+ * index type, so a chunk draw is just (firstIndex, indexCount, baseVertex). Draws queued during
+ * a pass become a DrawElementsIndirectCommand array, submitted by flush() with one
+ * glMultiDrawElementsIndirect per index type in use.
+ */
+class TerrainDrawArena
+{
+public:
+    // Layout fixed by glMultiDrawElementsIndirect
+    struct DrawCommand
+    {
+        unsigned int count;
+        unsigned int instanceCount;
+        unsigned int firstIndex;
+        int baseVertex;
+        unsigned int baseInstance;
+    };
+
+    TerrainDrawArena();
+    ~TerrainDrawArena();
+
+    TerrainDrawArena(const TerrainDrawArena&) = delete;
+    TerrainDrawArena& operator=(const TerrainDrawArena&) = delete;
+
+    // Vertex buffer size to create on the first allocation instead of growing to it; no GL call
+    void reserve(size_t vertexBytes) { m_reserveBytes = vertexBytes; }
+
+    /**
+     * @brief Copy a mesh's vertices into the arena (GL thread)
+     * @return First vertex of the mesh, its baseVertex; the arena is emptied first if format changed
+     */
+    unsigned int allocate(TerrainVertexFormat format, const uint8_t* vertices, size_t vertexBytes);
+
+    // Overwrite bytes of an allocated mesh, offset from its first vertex (glBufferSubData)
+    void update(unsigned int baseVertex, size_t offset, const void* data, size_t bytes);
+
+    // Return a mesh's vertices to the free list; no GL call
+    void deallocate(unsigned int baseVertex, size_t vertexBytes);
+
+    /**
+     * @brief First index of a shared index buffer's copy in the arena, copying it on first use
+     *
+     * Index ranges of the buffer keep their offsets relative to the returned index.
+     */
+    unsigned int addIndices(const TerrainIndexCache::Buffer& indices);
+
+    // Queue one draw for flush(); firstIndex as returned by addIndices() plus the range offset
+    void addDraw(GLenum indexType, unsigned int firstIndex, unsigned int indexCount, unsigned int baseVertex);
+
+    // Draw everything queued since the last flush(); returns the GL draw calls issued
+    int flush();
+    
+    /**
+     * @brief Draw commands another pass wrote into a GL buffer (e.g. a culling compute shader)
+     *
+     * 16-bit index commands start at command 0, 32-bit ones at command maxDraws; each index type
+     * in use is drawn with maxDraws commands, so unused ones must have a zero count.
+     * @return GL draw calls issued
+     */
+    int drawIndirect(unsigned int commandBuffer, unsigned int maxDraws);
+    
+    // Move the draws queued since the last flush() out instead of drawing them
+    void takeDraws(std::vector<DrawCommand>& shortDraws, std::vector<DrawCommand>& intDraws);
+
+    // Free every buffer (GL thread)
+    void clear();
+
+    size_t getVertexCapacityBytes() const { return m_vertexCapacity * m_stride; }
+    size_t getVertexUsedBytes() const { return m_usedVertices * m_stride; }
+    size_t getIndexMemoryBytes() const;
+
+private:
+    enum { SHORT_INDICES, INT_INDICES, INDEX_TYPES };
+
+    struct IndexBuffer
+    {
+        unsigned int buffer;
+        unsigned int count;         // indices in use
+        unsigned int capacity;
+        std::vector<DrawCommand> draws;
+    };
+
+    struct IndexCopy
+    {
+        int type;
+        unsigned int firstIndex;
+    };
+
+    unsigned int m_vao;
+    unsigned int m_vertexBuffer;
+    unsigned int m_commandBuffer;
+    TerrainVertexFormat m_format;
+    size_t m_stride;
+    unsigned int m_vertexCapacity;  // in vertices
+    unsigned int m_vertexEnd;       // one past the highest allocated vertex
+    unsigned int m_usedVertices;
+    size_t m_reserveBytes;
+    std::map<unsigned int, unsigned int> m_freeRanges;  // first vertex -> vertex count, coalesced
+
+    IndexBuffer m_indices[INDEX_TYPES];
+    std::map<unsigned int, IndexCopy> m_indexCopies;    // shared EBO -> its copy
+    std::vector<DrawCommand> m_commands;
+
+    void growVertices(unsigned int minVertices);
+    void bindVertexLayout();
+    static unsigned int growBuffer(unsigned int buffer, size_t usedBytes, size_t newBytes);
+};
+
+#endif
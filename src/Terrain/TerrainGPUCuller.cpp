@@ -0,0 +1,380 @@
+#include "TerrainGPUCuller.h"
+#include <iostream>
+#include <map>
+#include <utility>
+
+namespace {
+    const int WORKGROUP_SIZE = 64;      // local_size_x of terrain_cull.comp
+    
+    // Shape table layout, shared with terrain_cull.comp
+    const int SHAPE_SKIRTS = TerrainChunk::LOD_LEVELS * TerrainIndexCache::STITCH_VARIANTS * 2;
+    const int SHAPE_INDEX_TYPE = SHAPE_SKIRTS + TerrainChunk::LOD_LEVELS;
+    const int SHAPE_STRIDE = SHAPE_INDEX_TYPE + 4;
+    
+    enum { STAGE_SELECT, STAGE_STITCH, STAGE_EMIT, STAGE_OCCLUDERS };
+    enum { BINDING_CHUNKS, BINDING_SHAPES, BINDING_LODS, BINDING_COMMANDS, BINDING_COUNTERS, BINDING_OCCLUDERS };
+    enum
+    {
+        COUNTER_SHORT_DRAWS, COUNTER_INT_DRAWS, COUNTER_VISIBLE, COUNTER_TRIANGLES,
+        COUNTER_SHORT_OCCLUDERS, COUNTER_INT_OCCLUDERS, COUNTER_OCCLUDED, COUNTER_COUNT
+    };
+    
+    // Matches struct Chunk in the shader (std430)
+    struct GPUChunk
+    {
+        glm::vec4 min;
+        glm::vec4 max;
+        glm::vec4 center;
+        float lodErrors[TerrainChunk::LOD_LEVELS];
+        unsigned int baseVertex;
+        unsigned int shape;
+        unsigned int padding[2];
+    };
+    
+    unsigned int createBuffer(size_t bytes, const void* data, GLenum usage)
+    {
+        unsigned int buffer = 0;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(bytes), data, usage);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return buffer;
+    }
+    
+    void deleteBuffer(unsigned int& buffer)
+    {
+        if (buffer != 0) glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+}
+
+TerrainGPUCuller::TerrainGPUCuller()
+    : m_loadFailed(false)
+    , m_chunkBuffer(0)
+    , m_shapeBuffer(0)
+    , m_lodBuffer(0)
+    , m_commandBuffer(0)
+    , m_occluderBuffer(0)
+    , m_counterBuffer(0)
+    , m_chunkCount(0)
+    , m_chunksPerRow(0)
+    , m_chunksPerCol(0)
+    , m_lodSource(0)
+{
+    for (PassReadback& pass : m_passes)
+    {
+        pass = PassReadback();
+    }
+}
+
+TerrainGPUCuller::~TerrainGPUCuller()
+{
+    clear();
+}
+
+bool TerrainGPUCuller::setChunks(const std::vector<TerrainChunk>& chunks, int chunksPerRow, int chunksPerCol)
+{
+    if (m_loadFailed) return false;
+    if (!m_shader.isValid() && !m_shader.loadCompute("shaders/terrain_cull.comp"))
+    {
+        std::cerr << "ERROR::TERRAIN_GPU_CULLER::SHADER_UNAVAILABLE: culling stays on the CPU" << std::endl;
+        m_loadFailed = true;
+        return false;
+    }
+    
+    // Each grid shape's ranges once, with the offset of its index copy in the arena applied
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> shapeIndices;
+    std::vector<unsigned int> shapes;
+    std::vector<GPUChunk> gpuChunks(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        const TerrainChunk& chunk = chunks[i];
+        const TerrainIndexCache::Buffer& ranges = chunk.getIndexRanges();
+        unsigned int firstIndex = chunk.getArenaFirstIndex();
+        
+        auto key = std::make_pair(ranges.indexType, firstIndex);
+        auto found = shapeIndices.find(key);
+        if (found == shapeIndices.end())
+        {
+            found = shapeIndices.emplace(key, static_cast<unsigned int>(shapeIndices.size())).first;
+            size_t base = shapes.size();
+            shapes.resize(base + SHAPE_STRIDE, 0);
+            for (int lod = 0; lod < TerrainChunk::LOD_LEVELS; lod++)
+            {
+                for (int variant = 0; variant < TerrainIndexCache::STITCH_VARIANTS; variant++)
+                {
+                    const TerrainIndexCache::Range& range = ranges.lods[lod][variant];
+                    size_t slot = base + (lod * TerrainIndexCache::STITCH_VARIANTS + variant) * 2;
+                    shapes[slot] = firstIndex + range.firstIndex;
+                    shapes[slot + 1] = range.indexCount;
+                }
+                shapes[base + SHAPE_SKIRTS + lod] = ranges.skirts[lod].indexCount;
+            }
+            shapes[base + SHAPE_INDEX_TYPE] = ranges.indexType == GL_UNSIGNED_SHORT ? 0 : 1;
+        }
+        
+        GPUChunk& gpuChunk = gpuChunks[i];
+        gpuChunk.min = glm::vec4(chunk.getMin(), 0.0f);
+        gpuChunk.max = glm::vec4(chunk.getMax(), 0.0f);
+        gpuChunk.center = glm::vec4(chunk.getCenter(), 0.0f);
+        for (int lod = 0; lod < TerrainChunk::LOD_LEVELS; lod++)
+        {
+            gpuChunk.lodErrors[lod] = chunk.getLODError(lod);
+        }
+        gpuChunk.baseVertex = chunk.getArenaBaseVertex();
+        gpuChunk.shape = found->second;
+        gpuChunk.padding[0] = gpuChunk.padding[1] = 0;
+    }
+    
+    // Same chunk count (a sculpt): the buffers are refilled in place
+    if (m_chunkBuffer != 0 && static_cast<int>(chunks.size()) == m_chunkCount)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_chunkBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(gpuChunks.size() * sizeof(GPUChunk)),
+                        gpuChunks.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_shapeBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(shapes.size() * sizeof(unsigned int)),
+                     shapes.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        m_chunksPerRow = chunksPerRow;
+        m_chunksPerCol = chunksPerCol;
+        return true;
+    }
+    
+    clear();
+    m_chunkCount = static_cast<int>(chunks.size());
+    m_chunksPerRow = chunksPerRow;
+    m_chunksPerCol = chunksPerCol;
+    if (m_chunkCount == 0) return true;
+    
+    m_chunkBuffer = createBuffer(gpuChunks.size() * sizeof(GPUChunk), gpuChunks.data(), GL_STATIC_DRAW);
+    m_shapeBuffer = createBuffer(shapes.size() * sizeof(unsigned int), shapes.data(), GL_STATIC_DRAW);
+    m_lodBuffer = createBuffer(2 * m_chunkCount * sizeof(int), nullptr, GL_DYNAMIC_COPY);
+    m_counterBuffer = createBuffer(COUNTER_COUNT * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+    
+    // Room for every chunk under either index type
+    m_commandBuffer = createBuffer(2 * m_chunkCount * sizeof(TerrainDrawArena::DrawCommand), nullptr, GL_DYNAMIC_COPY);
+    m_occluderBuffer = createBuffer(2 * m_chunkCount * sizeof(TerrainDrawArena::DrawCommand), nullptr, GL_DYNAMIC_COPY);
+    
+    for (PassReadback& pass : m_passes)
+    {
+        pass.buffer = createBuffer(COUNTER_COUNT * sizeof(unsigned int), nullptr, GL_STREAM_READ);
+    }
+    return true;
+}
+
+void TerrainGPUCuller::cull(const Params& params, int pass)
+{
+    beginCull(params);
+    finishCull(params, nullptr, pass);
+}
+
+void TerrainGPUCuller::beginCull(const Params& params)
+{
+    if (m_chunkCount == 0) return;
+    
+    // Commands past the appended ones must stay zero, so the whole buffers are cleared
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    if (params.occluderDistance > 0.0f)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_occluderBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    
+    bindBuffers(true);
+    m_shader.use();
+    m_shader.setInt("uChunkCount", m_chunkCount);
+    m_shader.setInt("uChunksPerRow", m_chunksPerRow);
+    m_shader.setInt("uChunksPerCol", m_chunksPerCol);
+    m_shader.setVec3("uCameraPos", params.cameraPos);
+    m_shader.setInt("uLodMode", params.lodMode);
+    m_shader.setFloat("uPixelsPerRadian", params.pixelsPerRadian);
+    m_shader.setFloat("uPixelErrorThreshold", params.pixelErrorThreshold);
+    if (params.lodDistances)
+    {
+        m_shader.setVec4("uLodDistances", glm::vec4(params.lodDistances[0], params.lodDistances[1],
+                                                    params.lodDistances[2], params.lodDistances[3]));
+    }
+    m_shader.setInt("uSeamMode", params.seamMode);
+    m_shader.setBool("uCullFrustum", params.frustum != nullptr);
+    if (params.frustum)
+    {
+        glUniform4fv(glGetUniformLocation(m_shader.ID, "uPlanes"), Frustum::PLANE_COUNT, &params.frustum->getPlanes()[0][0]);
+    }
+    m_shader.setFloat("uOccluderDistance", params.occluderDistance);
+    
+    dispatch(STAGE_SELECT, 0);
+    
+    // lod = min(lod, neighbour + 1) as Jacobi steps; LODs differ by at most LOD_LEVELS - 1,
+    // so no chunk further away than that many steps can lower one, and the result is exact
+    m_lodSource = 0;
+    if (params.seamMode == SEAM_STITCH && params.lodMode != LOD_FIXED)
+    {
+        for (int step = 0; step < TerrainChunk::LOD_LEVELS - 1; step++)
+        {
+            dispatch(STAGE_STITCH, m_lodSource);
+            m_lodSource = m_chunkCount - m_lodSource;
+        }
+    }
+    
+    if (params.occluderDistance > 0.0f)
+    {
+        dispatch(STAGE_OCCLUDERS, m_lodSource);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    }
+    bindBuffers(false);
+}
+
+int TerrainGPUCuller::drawOccluders(TerrainDrawArena& arena) const
+{
+    if (m_chunkCount == 0) return 0;
+    return arena.drawIndirect(m_occluderBuffer, static_cast<unsigned int>(m_chunkCount));
+}
+
+void TerrainGPUCuller::finishCull(const Params& params, const TerrainHiZBuffer* hiZ, int pass)
+{
+    if (m_chunkCount == 0) return;
+    
+    bool occlusion = hiZ != nullptr && hiZ->getPyramidLevels() > 0;
+    int activeTexture = 0;
+    if (occlusion)
+    {
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+        glActiveTexture(GL_TEXTURE0 + TerrainHiZBuffer::TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, hiZ->getPyramidTexture());
+    }
+    
+    bindBuffers(true);
+    m_shader.use();
+    m_shader.setBool("uOcclusion", occlusion);
+    if (occlusion)
+    {
+        glm::ivec2 depthSize = hiZ->getDepthSize();
+        m_shader.setMat4("uViewProjection", params.viewProjection);
+        m_shader.setInt("uHiZ", TerrainHiZBuffer::TEXTURE_UNIT);
+        m_shader.setInt("uHiZLevels", hiZ->getPyramidLevels());
+        glUniform2i(glGetUniformLocation(m_shader.ID, "uDepthSize"), depthSize.x, depthSize.y);
+    }
+    
+    dispatch(STAGE_EMIT, m_lodSource);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    bindBuffers(false);
+    
+    if (occlusion)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(static_cast<GLenum>(activeTexture));
+    }
+    
+    // Counters go to this pass's readback buffer unless its previous copy is still in flight
+    PassReadback& readback = m_passes[pass % MAX_PASSES];
+    collectStats(readback);
+    if (readback.fence == nullptr)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, m_counterBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, COUNTER_COUNT * sizeof(unsigned int));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+int TerrainGPUCuller::draw(TerrainDrawArena& arena) const
+{
+    if (m_chunkCount == 0) return 0;
+    return arena.drawIndirect(m_commandBuffer, static_cast<unsigned int>(m_chunkCount));
+}
+
+void TerrainGPUCuller::readBack(std::vector<TerrainDrawArena::DrawCommand>& shortDraws,
+                                std::vector<TerrainDrawArena::DrawCommand>& intDraws, Stats& stats) const
+{
+    shortDraws.clear();
+    intDraws.clear();
+    stats = Stats();
+    if (m_chunkCount == 0) return;
+    
+    unsigned int counters[COUNTER_COUNT];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+    stats.visibleChunks = static_cast<int>(counters[COUNTER_VISIBLE]);
+    stats.triangles = static_cast<int>(counters[COUNTER_TRIANGLES]);
+    stats.occludedChunks = static_cast<int>(counters[COUNTER_OCCLUDED]);
+    
+    shortDraws.resize(counters[COUNTER_SHORT_DRAWS]);
+    intDraws.resize(counters[COUNTER_INT_DRAWS]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    if (!shortDraws.empty())
+    {
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                           static_cast<GLsizeiptr>(shortDraws.size() * sizeof(TerrainDrawArena::DrawCommand)), shortDraws.data());
+    }
+    if (!intDraws.empty())
+    {
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                           static_cast<GLintptr>(m_chunkCount * sizeof(TerrainDrawArena::DrawCommand)),
+                           static_cast<GLsizeiptr>(intDraws.size() * sizeof(TerrainDrawArena::DrawCommand)), intDraws.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TerrainGPUCuller::clear()
+{
+    deleteBuffer(m_chunkBuffer);
+    deleteBuffer(m_shapeBuffer);
+    deleteBuffer(m_lodBuffer);
+    deleteBuffer(m_commandBuffer);
+    deleteBuffer(m_occluderBuffer);
+    deleteBuffer(m_counterBuffer);
+    for (PassReadback& pass : m_passes)
+    {
+        if (pass.fence != nullptr) glDeleteSync(pass.fence);
+        deleteBuffer(pass.buffer);
+        pass = PassReadback();
+    }
+    m_chunkCount = 0;
+}
+
+void TerrainGPUCuller::bindBuffers(bool bind) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CHUNKS, bind ? m_chunkBuffer : 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SHAPES, bind ? m_shapeBuffer : 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_LODS, bind ? m_lodBuffer : 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COMMANDS, bind ? m_commandBuffer : 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COUNTERS, bind ? m_counterBuffer : 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_OCCLUDERS, bind ? m_occluderBuffer : 0);
+}
+
+void TerrainGPUCuller::dispatch(int stage, int source)
+{
+    m_shader.setInt("uStage", stage);
+    m_shader.setInt("uSource", source);
+    glDispatchCompute(static_cast<GLuint>((m_chunkCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+    
+    // Each stage reads the LODs the previous one wrote
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void TerrainGPUCuller::collectStats(PassReadback& pass)
+{
+    if (pass.fence == nullptr) return;
+    
+    // Zero timeout: a copy the GPU has not reached yet is picked up by a later frame
+    GLenum status = glClientWaitSync(pass.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+    
+    glDeleteSync(pass.fence);
+    pass.fence = nullptr;
+    
+    unsigned int counters[COUNTER_COUNT];
+    glBindBuffer(GL_COPY_READ_BUFFER, pass.buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(counters), counters);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    pass.stats.visibleChunks = static_cast<int>(counters[COUNTER_VISIBLE]);
+    pass.stats.triangles = static_cast<int>(counters[COUNTER_TRIANGLES]);
+    pass.stats.occludedChunks = static_cast<int>(counters[COUNTER_OCCLUDED]);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file TerrainGPUCuller.h
+ * @brief Compute-shader LOD selection, frustum and Hi-Z occlusion culling for chunks in a draw arena
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_GPU_CULLER_H
+#define TERRAIN_GPU_CULLER_H
+
+#include "Frustum.h"
+#include "TerrainChunk.h"
+#include "TerrainDrawArena.h"
+#include "TerrainHiZBuffer.h"
+#include "Core/Shader.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+ * Chunk bounds, LOD errors and the arena ranges of every grid shape live in GPU buffers.
+ * cull() runs shaders/terrain_cull.comp: one dispatch picks each chunk's LOD, stitch mode adds
+ * LOD_LEVELS - 1 relaxation dispatches, and the last one frustum-culls the chunks and appends
+ * a DrawElementsIndirectCommand per visible chunk with an atomic counter. draw() hands the
+ * command buffer to TerrainDrawArena::drawIndirect(), so the CPU never walks the chunks.
+ *
+ * For occlusion culling the work is split: beginCull() also appends the visible chunks within
+ * occluderDistance to a second command buffer, the caller draws those with drawOccluders()
+ * into a TerrainHiZBuffer, and finishCull() drops the farther chunks hidden behind them.
+ */
+class TerrainGPUCuller
+{
+public:
+    struct Params
+    {
+        glm::vec3 cameraPos;
+        const Frustum* frustum;         // nullptr draws every chunk
+        int lodMode;                    // LOD_FIXED, LOD_SCREEN_SPACE or LOD_DISTANCE
+        float pixelsPerRadian;
+        float pixelErrorThreshold;
+        const float* lodDistances;      // 4 distances, LOD_DISTANCE only
+        int seamMode;                   // SEAM_NONE, SEAM_STITCH or SEAM_SKIRT
+        glm::mat4 viewProjection;       // for the Hi-Z test
+        float occluderDistance;         // world units from the camera; 0 selects no occluders
+    };
+
+    struct Stats
+    {
+        int visibleChunks;
+        int triangles;
+        int occludedChunks;             // in the frustum but behind the Hi-Z pyramid
+    };
+
+    enum { LOD_FIXED, LOD_SCREEN_SPACE, LOD_DISTANCE };
+    enum { SEAM_NONE, SEAM_STITCH, SEAM_SKIRT };
+
+    // Passes per frame whose statistics are kept apart (main view, reflection, ...)
+    static const int MAX_PASSES = 4;
+
+    TerrainGPUCuller();
+    ~TerrainGPUCuller();
+
+    TerrainGPUCuller(const TerrainGPUCuller&) = delete;
+    TerrainGPUCuller& operator=(const TerrainGPUCuller&) = delete;
+
+    /**
+     * @brief Upload the chunks' bounds, LOD errors and arena ranges (GL thread)
+     *
+     * Chunks must be uploaded into a draw arena, row-major chunksPerRow x chunksPerCol.
+     * Call again whenever they change (a rebuild or sculpt).
+     * @return false if the compute shader is unavailable; it is only loaded once
+     */
+    bool setChunks(const std::vector<TerrainChunk>& chunks, int chunksPerRow, int chunksPerCol);
+
+    // Write this view's draw commands on the GPU; pass picks the statistics slot
+    void cull(const Params& params, int pass);
+
+    // Select LODs and write the occluder commands; draw them, then finishCull()
+    void beginCull(const Params& params);
+
+    // Draw the occluders of the last beginCull(), usually into a TerrainHiZBuffer
+    int drawOccluders(TerrainDrawArena& arena) const;
+
+    /**
+     * @brief Write the draw commands after beginCull()
+     * @param hiZ Pyramid of this view's occluders, nullptr for no occlusion test
+     */
+    void finishCull(const Params& params, const TerrainHiZBuffer* hiZ, int pass);
+
+    // Draw the commands of the last cull() from the arena the chunks live in
+    int draw(TerrainDrawArena& arena) const;
+
+    /**
+     * @brief Counters of an earlier cull() of the same pass, read back without stalling
+     *
+     * Usually a frame old; zero until the first readback completes.
+     */
+    Stats getStats(int pass) const { return m_passes[pass % MAX_PASSES].stats; }
+
+    // Read the last cull()'s commands and counters back right away (stalls; for verification)
+    void readBack(std::vector<TerrainDrawArena::DrawCommand>& shortDraws,
+                  std::vector<TerrainDrawArena::DrawCommand>& intDraws, Stats& stats) const;
+
+    bool isAvailable() const { return !m_loadFailed; }
+
+    // Free the buffers; the shader is kept (GL thread)
+    void clear();
+
+private:
+    struct PassReadback
+    {
+        unsigned int buffer;
+        GLsync fence;
+        Stats stats;
+    };
+
+    Shader m_shader;
+    bool m_loadFailed;
+    unsigned int m_chunkBuffer;
+    unsigned int m_shapeBuffer;
+    unsigned int m_lodBuffer;
+    unsigned int m_commandBuffer;
+    unsigned int m_occluderBuffer;
+    unsigned int m_counterBuffer;
+    int m_chunkCount;
+    int m_chunksPerRow;
+    int m_chunksPerCol;
+    int m_lodSource;        // half of m_lodBuffer holding the final LODs
+    PassReadback m_passes[MAX_PASSES];
+
+    void bindBuffers(bool bind) const;
+    void dispatch(int stage, int source);
+    void collectStats(PassReadback& pass);
+};
+
+#endif
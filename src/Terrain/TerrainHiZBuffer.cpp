@@ -0,0 +1,155 @@
+#include "TerrainHiZBuffer.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    const int WORKGROUP_SIZE = 8;       // local_size_x/y of hiz_reduce.comp
+}
+
+TerrainHiZBuffer::TerrainHiZBuffer()
+    : m_loadFailed(false)
+    , m_current(nullptr)
+    , m_previousFramebuffer(0)
+{
+    std::fill(m_previousViewport, m_previousViewport + 4, 0);
+}
+
+TerrainHiZBuffer::~TerrainHiZBuffer()
+{
+    clear();
+}
+
+bool TerrainHiZBuffer::begin()
+{
+    if (m_loadFailed) return false;
+    if (!m_reduceShader.isValid() && !m_reduceShader.loadCompute("shaders/hiz_reduce.comp"))
+    {
+        std::cerr << "ERROR::TERRAIN_HIZ::SHADER_UNAVAILABLE: occlusion culling disabled" << std::endl;
+        m_loadFailed = true;
+        return false;
+    }
+    
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+    int width = std::max(m_previousViewport[2], 1);
+    int height = std::max(m_previousViewport[3], 1);
+    
+    m_current = &getTarget(width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_current->fbo);
+    glViewport(0, 0, width, height);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+void TerrainHiZBuffer::end()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_previousFramebuffer));
+    glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+    if (m_current) buildPyramid(*m_current);
+}
+
+void TerrainHiZBuffer::clear()
+{
+    for (auto& entry : m_targets)
+    {
+        Target& target = entry.second;
+        glDeleteFramebuffers(1, &target.fbo);
+        glDeleteTextures(1, &target.depth);
+        glDeleteTextures(1, &target.pyramid);
+    }
+    m_targets.clear();
+    m_current = nullptr;
+}
+
+TerrainHiZBuffer::Target& TerrainHiZBuffer::getTarget(int width, int height)
+{
+    auto found = m_targets.find(std::make_pair(width, height));
+    if (found != m_targets.end()) return found->second;
+    
+    Target target = {};
+    target.width = width;
+    target.height = height;
+    
+    // Textures are set up on TEXTURE_UNIT so the caller's bindings survive
+    int activeTexture = 0;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    
+    // Depth only; the occluders' fragment outputs go nowhere
+    glGenTextures(1, &target.depth);
+    glBindTexture(GL_TEXTURE_2D, target.depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depth, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "ERROR::TERRAIN_HIZ::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    }
+    
+    // Full mip chain down to 1x1, each level sized as hiz_reduce.comp halves it
+    glGenTextures(1, &target.pyramid);
+    glBindTexture(GL_TEXTURE_2D, target.pyramid);
+    int levelWidth = std::max(width / 2, 1);
+    int levelHeight = std::max(height / 2, 1);
+    for (target.levels = 0; ; target.levels++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, target.levels, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, nullptr);
+        if (levelWidth == 1 && levelHeight == 1) break;
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+    target.levels++;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, target.levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(static_cast<GLenum>(activeTexture));
+    
+    return m_targets.emplace(std::make_pair(width, height), target).first->second;
+}
+
+void TerrainHiZBuffer::buildPyramid(const Target& target)
+{
+    // The culling shaders own TEXTURE_UNIT; the active unit is left as the caller had it
+    int activeTexture = 0;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, target.depth);
+    
+    m_reduceShader.use();
+    m_reduceShader.setInt("uDepth", TEXTURE_UNIT);
+    
+    int sourceWidth = target.width;
+    int sourceHeight = target.height;
+    for (int level = 0; level < target.levels; level++)
+    {
+        int targetWidth = std::max(sourceWidth / 2, 1);
+        int targetHeight = std::max(sourceHeight / 2, 1);
+        
+        // Level 0 reads the depth texture; uSource is bound to something valid regardless
+        glBindImageTexture(0, target.pyramid, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, target.pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        m_reduceShader.setBool("uFromDepth", level == 0);
+        glUniform2i(glGetUniformLocation(m_reduceShader.ID, "uSourceSize"), sourceWidth, sourceHeight);
+        glUniform2i(glGetUniformLocation(m_reduceShader.ID, "uTargetSize"), targetWidth, targetHeight);
+        glDispatchCompute(static_cast<GLuint>((targetWidth + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE),
+                          static_cast<GLuint>((targetHeight + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1);
+        
+        // The next level loads this one; the culling pass fetches them all
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        sourceWidth = targetWidth;
+        sourceHeight = targetHeight;
+    }
+    
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(static_cast<GLenum>(activeTexture));
+}
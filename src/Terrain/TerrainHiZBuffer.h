@@ -0,0 +1,73 @@
+/**
+ * @file TerrainHiZBuffer.h
+ * @brief Depth target and max-depth pyramid (Hi-Z) for terrain occlusion culling
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_HIZ_BUFFER_H
+#define TERRAIN_HIZ_BUFFER_H
+
+#include "Core/Shader.h"
+#include <glm/glm.hpp>
+#include <map>
+#include <utility>
+
+/*
+ * Occluders are drawn between begin() and end() into a depth texture the size of the current
+ * viewport; end() reduces it with shaders/hiz_reduce.comp into a pyramid whose level 0 is half
+ * that size and whose texels hold the farthest depth they cover. A box whose nearest depth is
+ * behind every texel it projects onto is hidden. One target is kept per viewport size, so
+ * passes of different sizes (main view, water reflection) do not reallocate each frame.
+ */
+class TerrainHiZBuffer
+{
+public:
+    // Texture unit the culling shaders sample depth through; the terrain shaders use the low ones
+    static const int TEXTURE_UNIT = 15;
+
+    TerrainHiZBuffer();
+    ~TerrainHiZBuffer();
+
+    TerrainHiZBuffer(const TerrainHiZBuffer&) = delete;
+    TerrainHiZBuffer& operator=(const TerrainHiZBuffer&) = delete;
+
+    /**
+     * @brief Bind (creating on first use) the depth target of the current viewport's size, cleared
+     * @return false if the reduce shader is unavailable; nothing is bound then
+     */
+    bool begin();
+
+    // Restore the previous framebuffer and viewport, then build the pyramid
+    void end();
+
+    // Pyramid of the last end(); GL_R32F, level 0 half the depth target
+    unsigned int getPyramidTexture() const { return m_current ? m_current->pyramid : 0; }
+    int getPyramidLevels() const { return m_current ? m_current->levels : 0; }
+    glm::ivec2 getDepthSize() const { return m_current ? glm::ivec2(m_current->width, m_current->height) : glm::ivec2(0); }
+
+    // Free every target (GL thread)
+    void clear();
+
+private:
+    struct Target
+    {
+        unsigned int fbo;
+        unsigned int depth;
+        unsigned int pyramid;
+        int width;
+        int height;
+        int levels;
+    };
+
+    Shader m_reduceShader;
+    bool m_loadFailed;
+    std::map<std::pair<int, int>, Target> m_targets;
+    Target* m_current;
+    int m_previousFramebuffer;
+    int m_previousViewport[4];
+
+    Target& getTarget(int width, int height);
+    void buildPyramid(const Target& target);
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "TerrainHorizonCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    const float PI = 3.14159265358979f;
+    const float BINS_PER_RADIAN = TerrainHorizonCuller::AZIMUTH_BINS / (2.0f * PI);
+    const float INF = std::numeric_limits<float>::infinity();
+    
+    int wrapBin(int bin)
+    {
+        return ((bin % TerrainHorizonCuller::AZIMUTH_BINS) + TerrainHorizonCuller::AZIMUTH_BINS) %
+               TerrainHorizonCuller::AZIMUTH_BINS;
+    }
+    
+    // Distances along the horizontal ray (dirX, dirZ) from the eye over which it crosses the chunk
+    bool intersectFootprint(const TerrainChunk& chunk, const glm::vec3& eye, float dirX, float dirZ,
+                            float& enter, float& exit)
+    {
+        const float origin[2] = { eye.x, eye.z };
+        const float dir[2] = { dirX, dirZ };
+        const float lo[2] = { chunk.getMin().x, chunk.getMin().z };
+        const float hi[2] = { chunk.getMax().x, chunk.getMax().z };
+        enter = 0.0f;
+        exit = INF;
+        for (int axis = 0; axis < 2; axis++)
+        {
+            if (dir[axis] == 0.0f)
+            {
+                if (origin[axis] < lo[axis] || origin[axis] > hi[axis]) return false;
+                continue;
+            }
+            float t0 = (lo[axis] - origin[axis]) / dir[axis];
+            float t1 = (hi[axis] - origin[axis]) / dir[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        return enter <= exit;
+    }
+}
+
+TerrainHorizonCuller::TerrainHorizonCuller()
+    : m_horizon(AZIMUTH_BINS)
+    , m_nearest(AZIMUTH_BINS)
+    , m_edgeCos(AZIMUTH_BINS)
+    , m_edgeSin(AZIMUTH_BINS)
+{
+    for (int bin = 0; bin < AZIMUTH_BINS; bin++)
+    {
+        float angle = -PI + bin / BINS_PER_RADIAN;
+        m_edgeCos[bin] = std::cos(angle);
+        m_edgeSin[bin] = std::sin(angle);
+    }
+    
+    // Exact zeros on the axes, so a bin never straddles a sign change of either component
+    for (int quarter = 0; quarter < 4; quarter++)
+    {
+        int bin = quarter * AZIMUTH_BINS / 4;
+        m_edgeCos[bin] = (quarter == 1 || quarter == 3) ? 0.0f : (quarter == 0 ? -1.0f : 1.0f);
+        m_edgeSin[bin] = (quarter == 0 || quarter == 2) ? 0.0f : (quarter == 1 ? -1.0f : 1.0f);
+    }
+}
+
+int TerrainHorizonCuller::cull(const std::vector<TerrainChunk>& chunks, int chunksPerRow, int chunksPerCol,
+                               const View& view, std::vector<uint8_t>& visible)
+{
+    if (chunksPerRow <= 0 || chunksPerCol <= 0) return 0;
+    if (chunks.size() < static_cast<size_t>(chunksPerRow) * chunksPerCol) return 0;
+    
+    std::fill(m_horizon.begin(), m_horizon.end(), -INF);
+    std::fill(m_nearest.begin(), m_nearest.end(), INF);
+    
+    // Chunk cell of the eye; every chunk but the last row and column has the first one's size
+    const glm::vec3 origin = chunks[0].getMin();
+    const glm::vec3 chunkSize = chunks[0].getMax() - origin;
+    int eyeX = std::min(std::max(static_cast<int>(std::floor((view.eye.x - origin.x) / chunkSize.x)), 0), chunksPerRow - 1);
+    int eyeZ = std::min(std::max(static_cast<int>(std::floor((view.eye.z - origin.z) / chunkSize.z)), 0), chunksPerCol - 1);
+    int rings = std::max(std::max(eyeX, chunksPerRow - 1 - eyeX), std::max(eyeZ, chunksPerCol - 1 - eyeZ));
+    
+    int hidden = 0;
+    for (int ring = 0; ring <= rings; ring++)
+    {
+        m_ring.clear();
+        for (int z = std::max(eyeZ - ring, 0); z <= std::min(eyeZ + ring, chunksPerCol - 1); z++)
+        {
+            // Whole first and last rows, only the two end cells in between
+            bool edgeRow = z == eyeZ - ring || z == eyeZ + ring;
+            int step = edgeRow ? 1 : 2 * ring;
+            for (int x = eyeX - ring; x <= eyeX + ring; x += step)
+            {
+                if (x < 0 || x >= chunksPerRow) continue;
+                int index = z * chunksPerRow + x;
+                if (visible[index]) m_ring.push_back(index);
+            }
+        }
+        
+        // The ring is tested against the inner rings only: its own chunks may overlap in depth
+        for (int index : m_ring)
+        {
+            if (isHidden(chunks[index], view))
+            {
+                visible[index] = 0;
+                hidden++;
+            }
+        }
+        
+        // Hidden chunks still raise the horizon; whatever hides them hides what they would
+        for (int index : m_ring)
+        {
+            addOccluder(chunks[index], view);
+        }
+    }
+    return hidden;
+}
+
+bool TerrainHorizonCuller::getBinRange(const TerrainChunk& chunk, const glm::vec3& eye, float& first, float& last) const
+{
+    const glm::vec3 min = chunk.getMin();
+    const glm::vec3 max = chunk.getMax();
+    if (eye.x >= min.x && eye.x <= max.x && eye.z >= min.z && eye.z <= max.z) return false;
+    
+    // Corner azimuths relative to the centre's; a box the eye is outside spans less than pi
+    float centerAngle = std::atan2((min.z + max.z) * 0.5f - eye.z, (min.x + max.x) * 0.5f - eye.x);
+    float low = 0.0f;
+    float high = 0.0f;
+    for (int corner = 0; corner < 4; corner++)
+    {
+        float x = (corner & 1) ? max.x : min.x;
+        float z = (corner & 2) ? max.z : min.z;
+        float angle = std::atan2(z - eye.z, x - eye.x) - centerAngle;
+        if (angle > PI) angle -= 2.0f * PI;
+        if (angle < -PI) angle += 2.0f * PI;
+        low = std::min(low, angle);
+        high = std::max(high, angle);
+    }
+    
+    // In bins, unwrapped: first may be negative and last past AZIMUTH_BINS
+    first = (centerAngle + low + PI) * BINS_PER_RADIAN;
+    last = (centerAngle + high + PI) * BINS_PER_RADIAN;
+    return true;
+}
+
+bool TerrainHorizonCuller::isHidden(const TerrainChunk& chunk, const View& view) const
+{
+    float first, last;
+    if (!getBinRange(chunk, view.eye, first, last)) return false;
+    
+    const glm::vec3 min = chunk.getMin();
+    const glm::vec3 max = chunk.getMax();
+    float dx = std::max(std::max(min.x - view.eye.x, view.eye.x - max.x), 0.0f);
+    float dz = std::max(std::max(min.z - view.eye.z, view.eye.z - max.z), 0.0f);
+    float nearest = std::sqrt(dx * dx + dz * dz);
+    float fx = std::max(std::abs(min.x - view.eye.x), std::abs(max.x - view.eye.x));
+    float fz = std::max(std::abs(min.z - view.eye.z), std::abs(max.z - view.eye.z));
+    float farthest = std::sqrt(fx * fx + fz * fz);
+    
+    // Steepest ray to any drawn point of the chunk
+    float top = max.y + view.heightTolerance;
+    if (view.clipMode == CLIP_KEEP_BELOW) top = std::min(top, view.clipHeight);
+    float rise = top - view.eye.y;
+    float highest = rise >= 0.0f ? rise / nearest : rise / farthest;
+    
+    // Eye below a kept half-space (reflection): a ray only meets solid terrain once above the
+    // plane, so the occluders must start beyond where even the flattest ray to this chunk crosses it
+    bool belowClip = view.clipMode == CLIP_KEEP_ABOVE && view.eye.y < view.clipHeight;
+    float lowest = 0.0f;
+    if (belowClip)
+    {
+        float bottom = min.y - view.heightTolerance;
+        if (view.skirtCellSize > 0.0f) bottom -= (max.y - min.y) + view.skirtCellSize;
+        lowest = (std::max(bottom, view.clipHeight) - view.eye.y) / farthest;
+    }
+    
+    for (int bin = static_cast<int>(std::floor(first)); bin <= static_cast<int>(std::floor(last)); bin++)
+    {
+        int wrapped = wrapBin(bin);
+        if (!(highest < m_horizon[wrapped])) return false;
+        if (belowClip && lowest * m_nearest[wrapped] < view.clipHeight - view.eye.y) return false;
+    }
+    return true;
+}
+
+void TerrainHorizonCuller::addOccluder(const TerrainChunk& chunk, const View& view)
+{
+    float first, last;
+    if (!getBinRange(chunk, view.eye, first, last)) return;
+    
+    // Solid that is drawn: below the lowest point, minus what the clip plane removes
+    float solidTop = chunk.getMin().y - view.heightTolerance;
+    if (view.clipMode == CLIP_KEEP_BELOW) solidTop = std::min(solidTop, view.clipHeight);
+    if (view.clipMode == CLIP_KEEP_ABOVE && solidTop < view.clipHeight) return;
+    float rise = solidTop - view.eye.y;
+    
+    // Only bins the chunk covers completely. Within a bin (which stays inside one quadrant) the
+    // entry and exit distances are monotonic in the angle, so its two edges bound them: every
+    // ray of the bin is over the chunk between the later entry and the earlier exit
+    for (int bin = static_cast<int>(std::ceil(first)); bin + 1 <= static_cast<int>(std::floor(last)); bin++)
+    {
+        int edge0 = wrapBin(bin);
+        int edge1 = wrapBin(bin + 1);
+        float enter0, exit0, enter1, exit1;
+        if (!intersectFootprint(chunk, view.eye, m_edgeCos[edge0], m_edgeSin[edge0], enter0, exit0)) continue;
+        if (!intersectFootprint(chunk, view.eye, m_edgeCos[edge1], m_edgeSin[edge1], enter1, exit1)) continue;
+        float enter = std::max(enter0, enter1);
+        float exit = std::min(exit0, exit1);
+        if (enter <= 0.0f || enter > exit) continue;
+        
+        // A ray no steeper than this is at or below solidTop somewhere in [enter, exit]
+        float elevation = rise >= 0.0f ? rise / enter : rise / exit;
+        m_horizon[edge0] = std::max(m_horizon[edge0], elevation);
+        m_nearest[edge0] = std::min(m_nearest[edge0], enter);
+    }
+}
@@ -0,0 +1,71 @@
+/**
+ * @file TerrainHorizonCuller.h
+ * @brief CPU horizon occlusion culling for the terrain chunk grid
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_HORIZON_CULLER_H
+#define TERRAIN_HORIZON_CULLER_H
+
+#include "TerrainChunk.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Below a heightfield surface is solid: a ray that passes under a chunk's lowest point must have
+ * hit the terrain on the way. Walking the chunk grid in square rings around the eye (along any
+ * ray the ring never decreases, so every chunk of an inner ring lies in front of an outer one),
+ * each ring first tests its chunks against a per-azimuth buffer of horizon elevations, then
+ * raises the buffer with its own lowest heights. A chunk whose highest point stays below the
+ * horizon in every azimuth bin it covers is hidden.
+ *
+ * Only the AABBs are used. The view's clip plane decides which part of the solid is drawn, so
+ * the same walk serves the water reflection (eye mirrored below the water, everything under
+ * it clipped) and refraction passes.
+ */
+class TerrainHorizonCuller
+{
+public:
+    enum { CLIP_NONE, CLIP_KEEP_ABOVE, CLIP_KEEP_BELOW };
+
+    struct View
+    {
+        glm::vec3 eye;
+        int clipMode;
+        float clipHeight;
+        float heightTolerance;  // drawn heights may leave a chunk's bounds by this much (vertex quantization)
+        float skirtCellSize;    // > 0 when skirts hang (max - min) + this far below each chunk edge
+    };
+
+    // Azimuth resolution; a multiple of 4 keeps the axis directions on bin edges
+    static const int AZIMUTH_BINS = 1024;
+
+    TerrainHorizonCuller();
+
+    /**
+     * @brief Clear the visibility of chunks hidden behind nearer ones
+     *
+     * The eye must be above the drawn surface and inside the grid's footprint, unless the clip
+     * plane removes the terrain around it.
+     * @param chunks Row-major chunksPerRow x chunksPerCol grid of equal chunks (the last row and
+     *               column may be narrower)
+     * @param visible In: frustum visibility per chunk; out: also 0 for occluded chunks
+     * @return Number of chunks this cleared
+     */
+    int cull(const std::vector<TerrainChunk>& chunks, int chunksPerRow, int chunksPerCol,
+             const View& view, std::vector<uint8_t>& visible);
+
+private:
+    std::vector<float> m_horizon;   // per bin, highest elevation (dy / distance) known to be hidden below
+    std::vector<float> m_nearest;   // per bin, nearest distance at which any raising chunk starts
+    std::vector<float> m_edgeCos;   // direction of each bin's lower edge
+    std::vector<float> m_edgeSin;
+    std::vector<int> m_ring;
+
+    bool getBinRange(const TerrainChunk& chunk, const glm::vec3& eye, float& first, float& last) const;
+    bool isHidden(const TerrainChunk& chunk, const View& view) const;
+    void addOccluder(const TerrainChunk& chunk, const View& view);
+};
+
+#endif
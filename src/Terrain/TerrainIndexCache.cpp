@@ -0,0 +1,262 @@
+#include "TerrainIndexCache.h"
+#include "Core/Mesh.h"
+#include "Core/MeshOptimizer.h"
+
+TerrainIndexCache::TerrainIndexCache()
+    : m_optimizeVertexCache(true)
+    , m_triangles(0.0)
+    , m_sourceMisses(0.0)
+    , m_optimizedMisses(0.0)
+{
+}
+
+TerrainIndexCache::~TerrainIndexCache()
+{
+    clear();
+}
+
+const TerrainIndexCache::Buffer& TerrainIndexCache::get(int verticesX, int verticesZ)
+{
+    auto key = std::make_pair(verticesX, verticesZ);
+    auto it = m_buffers.find(key);
+    if (it != m_buffers.end())
+    {
+        return it->second;
+    }
+    
+    prepare(verticesX, verticesZ);
+    auto prepared = m_prepared.find(key);
+    Buffer buffer = prepared->second.buffer;
+    const std::vector<unsigned int>& indices = prepared->second.indices;
+    
+    if (!indices.empty())
+    {
+        // Bind through GL_COPY_WRITE_BUFFER so no VAO's element binding is touched
+        glGenBuffers(1, &buffer.ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.ebo);
+        if (buffer.indexType == GL_UNSIGNED_SHORT)
+        {
+            std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+            glBufferData(GL_COPY_WRITE_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    m_prepared.erase(prepared);
+    
+    return m_buffers.emplace(key, buffer).first->second;
+}
+
+void TerrainIndexCache::prepare(int verticesX, int verticesZ)
+{
+    auto key = std::make_pair(verticesX, verticesZ);
+    if (m_buffers.count(key) || m_prepared.count(key)) return;
+    
+    Prepared& prepared = m_prepared[key];
+    std::vector<unsigned int>& indices = prepared.indices;
+    Buffer& buffer = prepared.buffer;
+    buffer = {};
+    size_t vertexCount = static_cast<size_t>(verticesX) * verticesZ + getSkirtVertexCount(verticesX, verticesZ);
+    buffer.indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    
+    for (int lod = 0; lod < LOD_LEVELS; lod++)
+    {
+        auto appendRange = [&](Range& range, auto&& build)
+        {
+            range.firstIndex = static_cast<unsigned int>(indices.size());
+            build();
+            range.indexCount = static_cast<unsigned int>(indices.size()) - range.firstIndex;
+            
+            // Row-major order reloads every vertex once per row it borders
+            unsigned int* first = indices.data() + range.firstIndex;
+            double triangles = range.indexCount / 3;
+            m_triangles += triangles;
+            m_sourceMisses += MeshOptimizer::computeACMR(first, range.indexCount, vertexCount) * triangles;
+            if (m_optimizeVertexCache)
+            {
+                MeshOptimizer::optimizeVertexCache(first, range.indexCount, vertexCount);
+            }
+            m_optimizedMisses += MeshOptimizer::computeACMR(first, range.indexCount, vertexCount) * triangles;
+        };
+        
+        appendRange(buffer.lods[lod][0], [&]() { buildGridIndices(verticesX, verticesZ, lod, 0, indices); });
+        appendRange(buffer.skirts[lod], [&]() { buildSkirtIndices(verticesX, verticesZ, lod, indices); });
+        
+        // The coarsest LOD never has a coarser neighbour to stitch to
+        for (unsigned int mask = 1; mask < STITCH_VARIANTS; mask++)
+        {
+            if (lod == LOD_LEVELS - 1)
+            {
+                buffer.lods[lod][mask] = buffer.lods[lod][0];
+                continue;
+            }
+            appendRange(buffer.lods[lod][mask], [&]() { buildGridIndices(verticesX, verticesZ, lod, mask, indices); });
+        }
+    }
+    buffer.totalIndexCount = static_cast<unsigned int>(indices.size());
+}
+
+void TerrainIndexCache::clear()
+{
+    for (auto& entry : m_buffers)
+    {
+        if (entry.second.ebo != 0)
+        {
+            glDeleteBuffers(1, &entry.second.ebo);
+        }
+    }
+    m_buffers.clear();
+    m_prepared.clear();
+    m_triangles = 0.0;
+    m_sourceMisses = 0.0;
+    m_optimizedMisses = 0.0;
+}
+
+float TerrainIndexCache::getUnoptimizedACMR() const
+{
+    return m_triangles > 0.0 ? static_cast<float>(m_sourceMisses / m_triangles) : 0.0f;
+}
+
+float TerrainIndexCache::getACMR() const
+{
+    return m_triangles > 0.0 ? static_cast<float>(m_optimizedMisses / m_triangles) : 0.0f;
+}
+
+size_t TerrainIndexCache::getMemoryBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& entry : m_buffers)
+    {
+        bytes += entry.second.totalIndexCount * Mesh::getIndexSize(entry.second.indexType);
+    }
+    return bytes;
+}
+
+void TerrainIndexCache::getLODSamples(int vertices, int lodLevel, std::vector<int>& samples)
+{
+    samples.clear();
+    if (vertices < 1) return;
+    
+    int step = 1 << lodLevel;
+    for (int i = 0; i < vertices - 1; i += step)
+    {
+        samples.push_back(i);
+    }
+    // Always end on the chunk edge so coarse LODs cover the whole chunk
+    samples.push_back(vertices - 1);
+}
+
+int TerrainIndexCache::getLODVertexCount(int vertices, int lodLevel)
+{
+    if (vertices < 2) return vertices;
+    int step = 1 << lodLevel;
+    return (vertices - 2) / step + 2;
+}
+
+void TerrainIndexCache::buildGridIndices(int verticesX, int verticesZ, int lodLevel, unsigned int stitchMask,
+                                         std::vector<unsigned int>& indices)
+{
+    if (verticesX < 2 || verticesZ < 2) return;
+    
+    std::vector<int> xs, zs;
+    getLODSamples(verticesX, lodLevel, xs);
+    getLODSamples(verticesZ, lodLevel, zs);
+    
+    // For each sample, the nearest coarser-LOD sample (ties go to the earlier one).
+    // Coarse samples are a subset of ours and always include both corners, so snapping
+    // an edge vertex onto one makes this edge follow the neighbour's segments exactly.
+    // Nearest rather than always-earlier keeps the short last step of clipped chunks
+    // from folding the corner cell when two adjacent edges are stitched.
+    std::vector<int> snapX(xs), snapZ(zs);
+    if (stitchMask != 0 && lodLevel + 1 < LOD_LEVELS)
+    {
+        std::vector<int> coarse;
+        getLODSamples(verticesX, lodLevel + 1, coarse);
+        for (size_t i = 0, c = 0; i < xs.size(); i++)
+        {
+            while (c + 1 < coarse.size() && coarse[c + 1] <= xs[i]) c++;
+            bool later = c + 1 < coarse.size() && coarse[c + 1] - xs[i] < xs[i] - coarse[c];
+            snapX[i] = later ? coarse[c + 1] : coarse[c];
+        }
+        getLODSamples(verticesZ, lodLevel + 1, coarse);
+        for (size_t i = 0, c = 0; i < zs.size(); i++)
+        {
+            while (c + 1 < coarse.size() && coarse[c + 1] <= zs[i]) c++;
+            bool later = c + 1 < coarse.size() && coarse[c + 1] - zs[i] < zs[i] - coarse[c];
+            snapZ[i] = later ? coarse[c + 1] : coarse[c];
+        }
+    }
+    
+    size_t lastX = xs.size() - 1;
+    size_t lastZ = zs.size() - 1;
+    auto vertexIndex = [&](size_t ix, size_t iz) -> unsigned int
+    {
+        int x = xs[ix];
+        int z = zs[iz];
+        if ((iz == 0 && (stitchMask & EDGE_NEG_Z)) || (iz == lastZ && (stitchMask & EDGE_POS_Z))) x = snapX[ix];
+        if ((ix == 0 && (stitchMask & EDGE_NEG_X)) || (ix == lastX && (stitchMask & EDGE_POS_X))) z = snapZ[iz];
+        return static_cast<unsigned int>(z * verticesX + x);
+    };
+    auto addTriangle = [&indices](unsigned int a, unsigned int b, unsigned int c)
+    {
+        // Snapping collapses some edge triangles; skip them
+        if (a == b || b == c || a == c) return;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    };
+    
+    indices.reserve(indices.size() + lastX * lastZ * 6);
+    for (size_t z = 0; z < lastZ; z++)
+    {
+        for (size_t x = 0; x < lastX; x++)
+        {
+            unsigned int topLeft = vertexIndex(x, z);
+            unsigned int topRight = vertexIndex(x + 1, z);
+            unsigned int bottomLeft = vertexIndex(x, z + 1);
+            unsigned int bottomRight = vertexIndex(x + 1, z + 1);
+            
+            addTriangle(topLeft, bottomLeft, topRight);
+            addTriangle(topRight, bottomLeft, bottomRight);
+        }
+    }
+}
+
+void TerrainIndexCache::buildSkirtIndices(int verticesX, int verticesZ, int lodLevel, std::vector<unsigned int>& indices)
+{
+    if (verticesX < 2 || verticesZ < 2) return;
+    
+    std::vector<int> xs, zs;
+    getLODSamples(verticesX, lodLevel, xs);
+    getLODSamples(verticesZ, lodLevel, zs);
+    
+    unsigned int skirtBase = static_cast<unsigned int>(verticesX * verticesZ);
+    auto addStrip = [&](const std::vector<int>& samples, auto&& gridIndex, unsigned int skirtStart)
+    {
+        for (size_t i = 0; i + 1 < samples.size(); i++)
+        {
+            unsigned int top0 = gridIndex(samples[i]);
+            unsigned int top1 = gridIndex(samples[i + 1]);
+            unsigned int bottom0 = skirtStart + samples[i];
+            unsigned int bottom1 = skirtStart + samples[i + 1];
+            
+            indices.push_back(top0);
+            indices.push_back(bottom0);
+            indices.push_back(top1);
+            
+            indices.push_back(top1);
+            indices.push_back(bottom0);
+            indices.push_back(bottom1);
+        }
+    };
+    
+    unsigned int lastRow = static_cast<unsigned int>((verticesZ - 1) * verticesX);
+    unsigned int lastColumn = static_cast<unsigned int>(verticesX - 1);
+    addStrip(xs, [&](int x) { return static_cast<unsigned int>(x); }, skirtBase);
+    addStrip(xs, [&](int x) { return lastRow + x; }, skirtBase + verticesX);
+    addStrip(zs, [&](int z) { return static_cast<unsigned int>(z * verticesX); }, skirtBase + 2 * verticesX);
+    addStrip(zs, [&](int z) { return z * verticesX + lastColumn; }, skirtBase + 2 * verticesX + verticesZ);
+}
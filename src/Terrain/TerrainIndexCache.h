@@ -0,0 +1,112 @@
+/**
+ * @file TerrainIndexCache.h
+ * @brief Index buffers shared by all terrain chunks with the same grid shape
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_INDEX_CACHE_H
+#define TERRAIN_INDEX_CACHE_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+class TerrainIndexCache
+{
+public:
+    static const int LOD_LEVELS = 4;
+    
+    // Chunk edges, combined into a stitch mask of edges whose neighbour is one LOD coarser
+    enum Edge
+    {
+        EDGE_NEG_Z = 1 << 0,
+        EDGE_POS_Z = 1 << 1,
+        EDGE_NEG_X = 1 << 2,
+        EDGE_POS_X = 1 << 3
+    };
+    static const int STITCH_VARIANTS = 16;
+    
+    struct Range
+    {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+    };
+    
+    // One EBO per grid shape holding every LOD and stitch variant back to back.
+    // Each LOD's skirt range directly follows its unstitched range so both draw in one call.
+    struct Buffer
+    {
+        unsigned int ebo;
+        GLenum indexType;           // GL_UNSIGNED_SHORT unless the grid has over 65536 vertices
+        unsigned int totalIndexCount;
+        Range lods[LOD_LEVELS][STITCH_VARIANTS];
+        Range skirts[LOD_LEVELS];
+    };
+    
+    TerrainIndexCache();
+    ~TerrainIndexCache();
+    
+    TerrainIndexCache(const TerrainIndexCache&) = delete;
+    TerrainIndexCache& operator=(const TerrainIndexCache&) = delete;
+    
+    /**
+     * @brief Get (creating on first use) the index buffer of a full-resolution vertex grid
+     * @param verticesX Grid vertices along X
+     * @param verticesZ Grid vertices along Z
+     */
+    const Buffer& get(int verticesX, int verticesZ);
+    
+    /**
+     * @brief Build the indices of a grid shape without touching GL, so get() only uploads them
+     *
+     * For loader threads; must not run concurrently with get() or clear().
+     */
+    void prepare(int verticesX, int verticesZ);
+    
+    void clear();
+    
+    // Reorder each range's triangles for the post-transform cache; applies to buffers built afterwards
+    void setOptimizeVertexCache(bool optimize) { m_optimizeVertexCache = optimize; }
+    
+    int getBufferCount() const { return static_cast<int>(m_buffers.size()); }
+    size_t getMemoryBytes() const;
+    
+    // Average cache miss ratio (MeshOptimizer::computeACMR) over every range built, before and after reordering
+    float getUnoptimizedACMR() const;
+    float getACMR() const;
+    
+    /**
+     * @brief Grid rows/columns sampled by a LOD: every (1 << lodLevel)-th vertex plus the last one
+     */
+    static void getLODSamples(int vertices, int lodLevel, std::vector<int>& samples);
+    static int getLODVertexCount(int vertices, int lodLevel);
+    
+    /**
+     * @brief Appends the triangles of one LOD, indexing into the full-resolution grid
+     * @param stitchMask Edges (Edge bits) snapped onto the samples of the next coarser LOD
+     */
+    static void buildGridIndices(int verticesX, int verticesZ, int lodLevel, unsigned int stitchMask,
+                                 std::vector<unsigned int>& indices);
+    
+    // Skirt vertices follow the grid: -Z row, +Z row, -X column, +X column
+    static int getSkirtVertexCount(int verticesX, int verticesZ) { return 2 * (verticesX + verticesZ); }
+    static void buildSkirtIndices(int verticesX, int verticesZ, int lodLevel, std::vector<unsigned int>& indices);
+
+private:
+    struct Prepared
+    {
+        Buffer buffer;
+        std::vector<unsigned int> indices;
+    };
+    
+    std::map<std::pair<int, int>, Buffer> m_buffers;
+    std::map<std::pair<int, int>, Prepared> m_prepared;
+    bool m_optimizeVertexCache;
+    double m_triangles;         // ACMR statistics, as transformed-vertex totals
+    double m_sourceMisses;
+    double m_optimizedMisses;
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "TerrainMeshCache.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    const char MAGIC[4] = { 'R', 'M', 'S', 'H' };
+    const uint64_t BLOB_ALIGNMENT = 16;
+    
+    static_assert(sizeof(TerrainMeshCache::Header) == 32, "mesh cache header layout");
+    static_assert(sizeof(TerrainMeshCache::MeshEntry) == 64, "mesh cache entry layout");
+    
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+    
+    uint64_t rotateLeft(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+    
+    // Process id plus a per-process counter, so concurrent writers of one cache (an abandoned
+    // async rebuild and its successor, or two running instances) never share a temp file
+    std::string makeTempPath(const std::string& path)
+    {
+        static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+        unsigned long processId = GetCurrentProcessId();
+#else
+        unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+        return path + "." + std::to_string(processId) + "-" + std::to_string(counter++) + ".tmp";
+    }
+    
+    // Atomic replace; std::rename does not overwrite an existing file on Windows
+    bool replaceFile(const std::string& from, const std::string& to)
+    {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+}
+
+TerrainMeshCache::TerrainMeshCache()
+    : m_entryOffset(0)
+    , m_meshCount(0)
+    , m_output(nullptr)
+    , m_header()
+    , m_writeOffset(0)
+    , m_writeFailed(false)
+{
+}
+
+TerrainMeshCache::~TerrainMeshCache()
+{
+    close();
+}
+
+uint64_t TerrainMeshCache::hash(const void* data, size_t bytes, uint64_t seed)
+{
+    // 8 bytes per step (multiply-rotate, as in xxHash64), then a final avalanche
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = seed ^ (bytes * PRIME1);
+    
+    size_t words = bytes / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++, p += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        h ^= rotateLeft(word * PRIME2, 31) * PRIME1;
+        h = rotateLeft(h, 27) * PRIME1 + PRIME2;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < bytes; i++, p++)
+    {
+        h ^= *p * PRIME1;
+        h = rotateLeft(h, 11) * PRIME2;
+    }
+    
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME1;
+    h ^= h >> 32;
+    return h;
+}
+
+bool TerrainMeshCache::open(const std::string& path, uint64_t key, size_t meshCount, TerrainVertexFormat format)
+{
+    close();
+    
+    // No file is the normal cold start, not an error worth reporting
+    FILE* probe = std::fopen(path.c_str(), "rb");
+    if (!probe) return false;
+    std::fclose(probe);
+    if (!m_file.open(path)) return false;
+    
+    const uint8_t* base = m_file.getData();
+    uint64_t size = m_file.getSize();
+    
+    Header header;
+    if (size < sizeof(Header))
+    {
+        std::cerr << "ERROR::TERRAIN_MESH_CACHE::TRUNCATED: " << path << std::endl;
+        close();
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    
+    // Built from other inputs (or by another version): stale, rebuilt by the caller
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.key != key || header.meshCount != meshCount || header.format != static_cast<uint32_t>(format))
+    {
+        close();
+        return false;
+    }
+    
+    bool valid = header.entryOffset >= sizeof(Header) &&
+                 header.entryOffset + sizeof(MeshEntry) * static_cast<uint64_t>(header.meshCount) <= size;
+    size_t stride = TerrainChunk::getVertexStride(format);
+    for (uint32_t i = 0; valid && i < header.meshCount; i++)
+    {
+        MeshEntry entry;
+        std::memcpy(&entry, base + header.entryOffset + sizeof(MeshEntry) * i, sizeof(entry));
+        valid = entry.offset >= sizeof(Header) && entry.offset <= size && entry.vertexBytes <= size - entry.offset &&
+                entry.vertexBytes % stride == 0 && entry.verticesX > 1 && entry.verticesZ > 1 &&
+                entry.vertexBytes >= static_cast<uint64_t>(entry.verticesX) * entry.verticesZ * stride;
+    }
+    if (!valid)
+    {
+        std::cerr << "ERROR::TERRAIN_MESH_CACHE::INVALID_MESH_INDEX: " << path << std::endl;
+        close();
+        return false;
+    }
+    
+    m_header = header;
+    m_entryOffset = header.entryOffset;
+    m_meshCount = header.meshCount;
+    return true;
+}
+
+const uint8_t* TerrainMeshCache::getMesh(size_t index, TerrainChunkData& data, size_t& vertexBytes) const
+{
+    if (!m_file.isOpen() || index >= m_meshCount) return nullptr;
+    
+    MeshEntry entry;
+    std::memcpy(&entry, m_file.getData() + m_entryOffset + sizeof(MeshEntry) * index, sizeof(entry));
+    
+    data.format = static_cast<TerrainVertexFormat>(m_header.format);
+    data.vertices.clear();
+    data.verticesX = entry.verticesX;
+    data.verticesZ = entry.verticesZ;
+    std::memcpy(data.lodErrors, entry.lodErrors, sizeof(entry.lodErrors));
+    data.min = glm::vec3(entry.min[0], entry.min[1], entry.min[2]);
+    data.max = glm::vec3(entry.max[0], entry.max[1], entry.max[2]);
+    
+    vertexBytes = static_cast<size_t>(entry.vertexBytes);
+    return m_file.getData() + entry.offset;
+}
+
+bool TerrainMeshCache::beginWrite(const std::string& path, uint64_t key, size_t meshCount, TerrainVertexFormat format)
+{
+    close();
+    
+    // Written beside the old file and renamed over it at the end, so a crash never leaves half a cache
+    m_path = path;
+    m_tempPath = makeTempPath(path);
+    m_output = std::fopen(m_tempPath.c_str(), "wb");
+    if (!m_output)
+    {
+        std::cerr << "ERROR::TERRAIN_MESH_CACHE::FAILED_TO_CREATE: " << path << std::endl;
+        return false;
+    }
+    
+    std::memcpy(m_header.magic, MAGIC, sizeof(MAGIC));
+    m_header.version = VERSION;
+    m_header.key = key;
+    m_header.meshCount = static_cast<uint32_t>(meshCount);
+    m_header.format = static_cast<uint32_t>(format);
+    m_header.entryOffset = 0;   // filled in by endWrite()
+    
+    m_written.clear();
+    m_written.reserve(meshCount);
+    m_writeOffset = sizeof(Header);
+    m_writeFailed = std::fwrite(&m_header, sizeof(m_header), 1, m_output) != 1;
+    return !m_writeFailed;
+}
+
+void TerrainMeshCache::write(const TerrainChunkData& data)
+{
+    if (!m_output || m_writeFailed) return;
+    
+    static const uint8_t padding[BLOB_ALIGNMENT] = {};
+    uint64_t offset = alignUp(m_writeOffset, BLOB_ALIGNMENT);
+    size_t padBytes = static_cast<size_t>(offset - m_writeOffset);
+    
+    MeshEntry entry;
+    entry.offset = offset;
+    entry.vertexBytes = data.vertices.size();
+    entry.verticesX = data.verticesX;
+    entry.verticesZ = data.verticesZ;
+    std::memcpy(entry.lodErrors, data.lodErrors, sizeof(entry.lodErrors));
+    entry.min[0] = data.min.x; entry.min[1] = data.min.y; entry.min[2] = data.min.z;
+    entry.max[0] = data.max.x; entry.max[1] = data.max.y; entry.max[2] = data.max.z;
+    m_written.push_back(entry);
+    
+    m_writeFailed = std::fwrite(padding, 1, padBytes, m_output) != padBytes ||
+                    std::fwrite(data.vertices.data(), 1, data.vertices.size(), m_output) != data.vertices.size();
+    m_writeOffset = offset + data.vertices.size();
+}
+
+bool TerrainMeshCache::endWrite()
+{
+    if (!m_output) return false;
+    
+    bool ok = !m_writeFailed && m_written.size() == m_header.meshCount;
+    if (ok)
+    {
+        static const uint8_t padding[8] = {};
+        m_header.entryOffset = alignUp(m_writeOffset, sizeof(uint64_t));
+        size_t padBytes = static_cast<size_t>(m_header.entryOffset - m_writeOffset);
+        ok = std::fwrite(padding, 1, padBytes, m_output) == padBytes &&
+             std::fwrite(m_written.data(), sizeof(MeshEntry), m_written.size(), m_output) == m_written.size() &&
+             std::fseek(m_output, 0, SEEK_SET) == 0 &&
+             std::fwrite(&m_header, sizeof(m_header), 1, m_output) == 1;
+    }
+    ok = (std::fclose(m_output) == 0) && ok;
+    m_output = nullptr;
+    m_written.clear();
+    
+    // The old cache stays until the rename replaces it, and stays as it was if that fails
+    if (ok)
+    {
+        m_file.close();
+        ok = replaceFile(m_tempPath, m_path);
+    }
+    if (!ok)
+    {
+        std::cerr << "ERROR::TERRAIN_MESH_CACHE::FAILED_TO_WRITE: " << m_path << std::endl;
+        std::remove(m_tempPath.c_str());
+    }
+    m_tempPath.clear();
+    return ok;
+}
+
+void TerrainMeshCache::close()
+{
+    m_file.close();
+    m_entryOffset = 0;
+    m_meshCount = 0;
+    
+    if (m_output)
+    {
+        std::fclose(m_output);
+        m_output = nullptr;
+        std::remove(m_tempPath.c_str());
+        m_tempPath.clear();
+    }
+    m_written.clear();
+    m_writeFailed = false;
+}
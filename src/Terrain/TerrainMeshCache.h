@@ -0,0 +1,101 @@
+/**
+ * @file TerrainMeshCache.h
+ * @brief On-disk cache of built terrain meshes, keyed by everything that shapes them
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_MESH_CACHE_H
+#define TERRAIN_MESH_CACHE_H
+
+#include "TerrainChunk.h"
+#include "Core/MappedFile.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * File layout (.meshcache, little-endian):
+ *   Header
+ *   vertex data                   one blob per mesh, in mesh order, 16-byte aligned
+ *   MeshEntry[meshCount]          written last, once every blob is on disk
+ *
+ * Index buffers are not stored: every chunk shares them through TerrainIndexCache, which
+ * rebuilds them from the grid size alone. A file whose key, version or mesh count differs
+ * from what the caller expects is ignored and overwritten by the next build.
+ */
+class TerrainMeshCache
+{
+public:
+    // Bump whenever TerrainChunk::build() output changes
+    static const uint32_t VERSION = 2;
+
+    struct Header
+    {
+        char magic[4];          // "RMSH"
+        uint32_t version;
+        uint64_t key;
+        uint32_t meshCount;
+        uint32_t format;        // TerrainVertexFormat
+        uint64_t entryOffset;   // MeshEntry array
+    };
+
+    struct MeshEntry
+    {
+        uint64_t offset;        // byte offset of the vertex blob
+        uint64_t vertexBytes;
+        int32_t verticesX;
+        int32_t verticesZ;
+        float lodErrors[TerrainIndexCache::LOD_LEVELS];
+        float min[3];
+        float max[3];
+    };
+
+    TerrainMeshCache();
+    ~TerrainMeshCache();
+
+    TerrainMeshCache(const TerrainMeshCache&) = delete;
+    TerrainMeshCache& operator=(const TerrainMeshCache&) = delete;
+
+    // 64-bit hash of a byte range, chained through seed; for building cache keys
+    static uint64_t hash(const void* data, size_t bytes, uint64_t seed = 0);
+
+    /**
+     * @brief Map an existing cache; false (quietly) if it is missing or was built from other inputs
+     */
+    bool open(const std::string& path, uint64_t key, size_t meshCount, TerrainVertexFormat format);
+
+    // Mesh metadata into data (vertices left empty) and its vertices, still in the mapping
+    const uint8_t* getMesh(size_t index, TerrainChunkData& data, size_t& vertexBytes) const;
+
+    /**
+     * @brief Start writing a new cache next to path; meshes must then be added in order
+     */
+    bool beginWrite(const std::string& path, uint64_t key, size_t meshCount, TerrainVertexFormat format);
+    void write(const TerrainChunkData& data);
+
+    // Rename over the old file once every mesh was written; false (old file kept) otherwise
+    bool endWrite();
+
+    // Unmap, or abandon an unfinished write
+    void close();
+
+    bool isOpen() const { return m_file.isOpen(); }
+    bool isWriting() const { return m_output != nullptr; }
+    size_t getFileBytes() const { return m_file.getSize(); }
+
+private:
+    MappedFile m_file;
+    uint64_t m_entryOffset;
+    size_t m_meshCount;
+
+    FILE* m_output;
+    std::string m_path;
+    std::string m_tempPath;     // unique to this writer; the only file close() ever removes
+    Header m_header;
+    uint64_t m_writeOffset;
+    std::vector<MeshEntry> m_written;
+    bool m_writeFailed;
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include "TerrainNormalField.h"
+#include "Core/CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef ROAMING_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Below this tangent length the normal is (nearly) parallel to +X
+    const float MIN_TANGENT_LENGTH = 0.001f;
+}
+
+TerrainNormalField::TerrainNormalField()
+    : m_originX(0)
+    , m_originZ(0)
+    , m_stride(0)
+{
+}
+
+void TerrainNormalField::build(const HeightmapLoader& heightmap, float cellSize, float maxHeight,
+                               int x0, int z0, int x1, int z1, Path path)
+{
+    m_originX = x0;
+    m_originZ = z0;
+#ifndef ROAMING_SIMD_X86
+    path = Path::Scalar;
+#endif
+    
+    // Whole vectors plus a neighbour on each side, so the kernels reach every texel of the window
+    int width = x1 - x0 + 1;
+    m_stride = ((width + 7) & ~7) + 2;
+    size_t count = static_cast<size_t>(m_stride) * (z1 - z0 + 1);
+    m_nx.resize(count); m_ny.resize(count); m_nz.resize(count);
+    m_tx.resize(count); m_ty.resize(count); m_tz.resize(count);
+    
+    if (path == Path::Scalar)
+    {
+        for (int z = z0; z <= z1; z++)
+        {
+            size_t rowStart = static_cast<size_t>(z - z0) * m_stride;
+            for (int x = x0; x <= x1; x++)
+            {
+                storeTexel(rowStart + (x - x0 + 1), calculateNormal(heightmap, x, z, cellSize, maxHeight));
+            }
+        }
+        return;
+    }
+    
+    // Rolling window of three rows, each read once
+    for (std::vector<float>& row : m_rows) row.resize(m_stride);
+    loadRow(heightmap, z0 - 1, m_rows[0]);
+    loadRow(heightmap, z0, m_rows[1]);
+    for (int z = z0; z <= z1; z++)
+    {
+        loadRow(heightmap, z + 1, m_rows[2]);
+        
+        RowArgs args;
+        args.above = m_rows[0].data();
+        args.row = m_rows[1].data();
+        args.below = m_rows[2].data();
+        args.width = m_stride;
+        args.heightScale = maxHeight;
+        args.normalY = 2.0f * cellSize;
+        
+        size_t rowStart = static_cast<size_t>(z - z0) * m_stride;
+        float* nx = &m_nx[rowStart]; float* ny = &m_ny[rowStart]; float* nz = &m_nz[rowStart];
+        float* tx = &m_tx[rowStart]; float* ty = &m_ty[rowStart]; float* tz = &m_tz[rowStart];
+        if (path == Path::AVX2)
+        {
+            buildRowAVX2(args, nx, ny, nz, tx, ty, tz);
+        }
+        else
+        {
+            buildRowSSE2(args, nx, ny, nz, tx, ty, tz);
+        }
+        
+        std::swap(m_rows[0], m_rows[1]);
+        std::swap(m_rows[1], m_rows[2]);
+    }
+}
+
+void TerrainNormalField::loadRow(const HeightmapLoader& heightmap, int z, std::vector<float>& row) const
+{
+    // getHeight() clamps, so the padding and edge rows repeat the edge like calculateNormal() does
+    for (int i = 0; i < m_stride; i++)
+    {
+        row[i] = heightmap.getHeight(m_originX - 1 + i, z);
+    }
+}
+
+TerrainNormalField::Path TerrainNormalField::selectPath(bool allowSIMD)
+{
+#ifdef ROAMING_SIMD_X86
+    if (allowSIMD)
+    {
+        return CpuFeatures::get().getBestPath();
+    }
+#else
+    (void)allowSIMD;
+#endif
+    return Path::Scalar;
+}
+
+void TerrainNormalField::storeTexel(size_t index, const glm::vec3& normal)
+{
+    glm::vec3 tangent = calculateTangent(normal);
+    m_nx[index] = normal.x; m_ny[index] = normal.y; m_nz[index] = normal.z;
+    m_tx[index] = tangent.x; m_ty[index] = tangent.y; m_tz[index] = tangent.z;
+}
+
+#ifdef ROAMING_SIMD_X86
+
+void TerrainNormalField::buildRowSSE2(const RowArgs& args, float* nx, float* ny, float* nz,
+                                      float* tx, float* ty, float* tz)
+{
+    const __m128 scale = _mm_set1_ps(args.heightScale);
+    const __m128 normalY = _mm_set1_ps(args.normalY);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minLengthSq = _mm_set1_ps(MIN_TANGENT_LENGTH * MIN_TANGENT_LENGTH);
+    
+    for (int x = 1; x + 4 <= args.width - 1; x += 4)
+    {
+        __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(args.row + x - 1), _mm_loadu_ps(args.row + x + 1)), scale);
+        __m128 dz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(args.above + x), _mm_loadu_ps(args.below + x)), scale);
+        
+        __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(normalY, normalY)), _mm_mul_ps(dz, dz));
+        __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+        __m128 n0 = _mm_mul_ps(dx, invLength);
+        __m128 n1 = _mm_mul_ps(normalY, invLength);
+        __m128 n2 = _mm_mul_ps(dz, invLength);
+        
+        // Gram-Schmidt of +X against N; fall back to +Z where N is close to +X
+        __m128 t0 = _mm_sub_ps(one, _mm_mul_ps(n0, n0));
+        __m128 t1 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(n0, n1));
+        __m128 t2 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(n0, n2));
+        __m128 tLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t0, t0), _mm_mul_ps(t1, t1)), _mm_mul_ps(t2, t2));
+        
+        __m128 useZ = _mm_cmplt_ps(tLengthSq, minLengthSq);
+        if (_mm_movemask_ps(useZ) != 0)
+        {
+            __m128 a0 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(n2, n0));
+            __m128 a1 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(n2, n1));
+            __m128 a2 = _mm_sub_ps(one, _mm_mul_ps(n2, n2));
+            t0 = _mm_or_ps(_mm_and_ps(useZ, a0), _mm_andnot_ps(useZ, t0));
+            t1 = _mm_or_ps(_mm_and_ps(useZ, a1), _mm_andnot_ps(useZ, t1));
+            t2 = _mm_or_ps(_mm_and_ps(useZ, a2), _mm_andnot_ps(useZ, t2));
+            tLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t0, t0), _mm_mul_ps(t1, t1)), _mm_mul_ps(t2, t2));
+        }
+        __m128 invTLength = _mm_div_ps(one, _mm_sqrt_ps(tLengthSq));
+        
+        _mm_storeu_ps(nx + x, n0);
+        _mm_storeu_ps(ny + x, n1);
+        _mm_storeu_ps(nz + x, n2);
+        _mm_storeu_ps(tx + x, _mm_mul_ps(t0, invTLength));
+        _mm_storeu_ps(ty + x, _mm_mul_ps(t1, invTLength));
+        _mm_storeu_ps(tz + x, _mm_mul_ps(t2, invTLength));
+    }
+}
+
+ROAMING_TARGET_AVX2
+void TerrainNormalField::buildRowAVX2(const RowArgs& args, float* nx, float* ny, float* nz,
+                                      float* tx, float* ty, float* tz)
+{
+    const __m256 scale = _mm256_set1_ps(args.heightScale);
+    const __m256 normalY = _mm256_set1_ps(args.normalY);
+    const __m256 normalYSq = _mm256_mul_ps(normalY, normalY);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minLengthSq = _mm256_set1_ps(MIN_TANGENT_LENGTH * MIN_TANGENT_LENGTH);
+    
+    for (int x = 1; x + 8 <= args.width - 1; x += 8)
+    {
+        __m256 dx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(args.row + x - 1), _mm256_loadu_ps(args.row + x + 1)), scale);
+        __m256 dz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(args.above + x), _mm256_loadu_ps(args.below + x)), scale);
+        
+        __m256 lengthSq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dx, dx, normalYSq));
+        __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSq));
+        __m256 n0 = _mm256_mul_ps(dx, invLength);
+        __m256 n1 = _mm256_mul_ps(normalY, invLength);
+        __m256 n2 = _mm256_mul_ps(dz, invLength);
+        
+        // Gram-Schmidt of +X against N; fall back to +Z where N is close to +X
+        __m256 t0 = _mm256_fnmadd_ps(n0, n0, one);
+        __m256 t1 = _mm256_fnmadd_ps(n0, n1, _mm256_setzero_ps());
+        __m256 t2 = _mm256_fnmadd_ps(n0, n2, _mm256_setzero_ps());
+        __m256 tLengthSq = _mm256_fmadd_ps(t2, t2, _mm256_fmadd_ps(t1, t1, _mm256_mul_ps(t0, t0)));
+        
+        __m256 useZ = _mm256_cmp_ps(tLengthSq, minLengthSq, _CMP_LT_OQ);
+        if (_mm256_movemask_ps(useZ) != 0)
+        {
+            t0 = _mm256_blendv_ps(t0, _mm256_fnmadd_ps(n2, n0, _mm256_setzero_ps()), useZ);
+            t1 = _mm256_blendv_ps(t1, _mm256_fnmadd_ps(n2, n1, _mm256_setzero_ps()), useZ);
+            t2 = _mm256_blendv_ps(t2, _mm256_fnmadd_ps(n2, n2, one), useZ);
+            tLengthSq = _mm256_fmadd_ps(t2, t2, _mm256_fmadd_ps(t1, t1, _mm256_mul_ps(t0, t0)));
+        }
+        __m256 invTLength = _mm256_div_ps(one, _mm256_sqrt_ps(tLengthSq));
+        
+        _mm256_storeu_ps(nx + x, n0);
+        _mm256_storeu_ps(ny + x, n1);
+        _mm256_storeu_ps(nz + x, n2);
+        _mm256_storeu_ps(tx + x, _mm256_mul_ps(t0, invTLength));
+        _mm256_storeu_ps(ty + x, _mm256_mul_ps(t1, invTLength));
+        _mm256_storeu_ps(tz + x, _mm256_mul_ps(t2, invTLength));
+    }
+}
+
+#else
+
+void TerrainNormalField::buildRowSSE2(const RowArgs&, float*, float*, float*, float*, float*, float*)
+{
+}
+
+void TerrainNormalField::buildRowAVX2(const RowArgs&, float*, float*, float*, float*, float*, float*)
+{
+}
+
+#endif
+
+glm::vec3 TerrainNormalField::calculateNormal(const HeightmapLoader& heightmap,
+                                              int x, int z, float cellSize, float maxHeight)
+{
+    int width = heightmap.getWidth();
+    int height = heightmap.getGridHeight();
+    
+    float hL = heightmap.getHeight(std::max(0, x - 1), z) * maxHeight;
+    float hR = heightmap.getHeight(std::min(width - 1, x + 1), z) * maxHeight;
+    float hD = heightmap.getHeight(x, std::max(0, z - 1)) * maxHeight;
+    float hU = heightmap.getHeight(x, std::min(height - 1, z + 1)) * maxHeight;
+    
+    glm::vec3 normal(hL - hR, 2.0f * cellSize, hD - hU);
+    return glm::normalize(normal);
+}
+
+glm::vec3 TerrainNormalField::calculateTangent(const glm::vec3& normal)
+{
+    // For terrain, tangent is along +X axis (texture U direction)
+    // Then orthogonalize with respect to normal using Gram-Schmidt
+    glm::vec3 tangent(1.0f, 0.0f, 0.0f);
+    
+    // Gram-Schmidt orthogonalization
+    tangent = tangent - glm::dot(tangent, normal) * normal;
+    
+    // Handle edge case where normal is parallel to X axis
+    if (glm::length(tangent) < MIN_TANGENT_LENGTH)
+    {
+        tangent = glm::vec3(0.0f, 0.0f, 1.0f);
+        tangent = tangent - glm::dot(tangent, normal) * normal;
+    }
+    
+    return glm::normalize(tangent);
+}
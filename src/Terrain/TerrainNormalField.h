@@ -0,0 +1,94 @@
+/**
+ * @file TerrainNormalField.h
+ * @brief Per-texel normals and tangents of a heightmap window, computed with SIMD
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_NORMAL_FIELD_H
+#define TERRAIN_NORMAL_FIELD_H
+
+#include "HeightmapLoader.h"
+#include "Core/CpuFeatures.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Normals and tangents of one window of the heightmap, built with the chunk that needs them
+ *
+ * Every texel goes through the same kernel whatever window it is built in (rows are padded
+ * with clamped heights instead of falling back to the scalar path at their ends), so chunks
+ * sharing an edge agree on its normals. Nothing stays resident beyond the window.
+ */
+class TerrainNormalField
+{
+public:
+    using Path = SimdPath;
+    
+    TerrainNormalField();
+    
+    /**
+     * @brief Compute the field for texels [x0, x1] x [z0, z1]
+     * @param cellSize World distance between neighbouring texels
+     * @param path Kernel to use; must be supported by this CPU (Scalar forces the reference path)
+     */
+    void build(const HeightmapLoader& heightmap, float cellSize, float maxHeight,
+               int x0, int z0, int x1, int z1, Path path);
+    
+    // Heightmap coordinates, inside the window last built
+    glm::vec3 getNormal(int x, int z) const
+    {
+        size_t i = getIndex(x, z);
+        return glm::vec3(m_nx[i], m_ny[i], m_nz[i]);
+    }
+    
+    glm::vec3 getTangent(int x, int z) const
+    {
+        size_t i = getIndex(x, z);
+        return glm::vec3(m_tx[i], m_ty[i], m_tz[i]);
+    }
+    
+    // Best path allowed on this CPU; allowSIMD false gives Scalar
+    static Path selectPath(bool allowSIMD);
+    
+    // Reference implementation used by the scalar path and for single texels
+    static glm::vec3 calculateNormal(const HeightmapLoader& heightmap,
+                                     int x, int z, float cellSize, float maxHeight);
+    static glm::vec3 calculateTangent(const glm::vec3& normal);
+
+private:
+    // Structure of arrays so rows load straight into SIMD registers; each row holds
+    // m_stride texels starting one left of the window
+    std::vector<float> m_nx, m_ny, m_nz;
+    std::vector<float> m_tx, m_ty, m_tz;
+    std::vector<float> m_rows[3];   // padded heights above, at and below the row being built
+    int m_originX;
+    int m_originZ;
+    int m_stride;
+    
+    struct RowArgs
+    {
+        const float* above;
+        const float* row;
+        const float* below;
+        int width;
+        float heightScale;
+        float normalY;
+    };
+    
+    size_t getIndex(int x, int z) const
+    {
+        return static_cast<size_t>(z - m_originZ) * m_stride + (x - m_originX + 1);
+    }
+    
+    void loadRow(const HeightmapLoader& heightmap, int z, std::vector<float>& row) const;
+    void storeTexel(size_t index, const glm::vec3& normal);
+    
+    // SIMD kernels fill texels [1, width - 1) of padded rows, which always hold whole vectors
+    static void buildRowSSE2(const RowArgs& args, float* nx, float* ny, float* nz,
+                             float* tx, float* ty, float* tz);
+    static void buildRowAVX2(const RowArgs& args, float* nx, float* ny, float* nz,
+                             float* tx, float* ty, float* tz);
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "TerrainQuadtree.h"
+#include <algorithm>
+
+TerrainQuadtree::TerrainQuadtree()
+    : m_root(-1)
+{
+}
+
+void TerrainQuadtree::clear()
+{
+    m_nodes.clear();
+    m_root = -1;
+}
+
+std::vector<int> TerrainQuadtree::build(int chunksPerRow, int chunksPerCol, int chunkSize,
+                                        int gridWidth, int gridHeight)
+{
+    clear();
+    std::vector<int> interiorNodes;
+    if (chunksPerRow <= 0 || chunksPerCol <= 0) return interiorNodes;
+    
+    // Smallest power-of-two square of chunks covering the grid
+    int rootLevel = 0;
+    while ((1 << rootLevel) < std::max(chunksPerRow, chunksPerCol)) rootLevel++;
+    
+    m_root = buildNode(0, 0, rootLevel, chunksPerRow, chunksPerCol,
+                       chunkSize, gridWidth, gridHeight, interiorNodes);
+    return interiorNodes;
+}
+
+int TerrainQuadtree::buildNode(int chunkX, int chunkZ, int level, int chunksPerRow, int chunksPerCol,
+                               int chunkSize, int gridWidth, int gridHeight, std::vector<int>& interiorNodes)
+{
+    if (chunkX >= chunksPerRow || chunkZ >= chunksPerCol) return -1;
+    
+    Node node;
+    node.min = glm::vec3(0.0f);
+    node.max = glm::vec3(0.0f);
+    node.chunk = -1;
+    node.mesh = -1;
+    node.level = level;
+    node.startX = chunkX * chunkSize;
+    node.startZ = chunkZ * chunkSize;
+    node.sizeX = std::min(chunkSize << level, gridWidth - 1 - node.startX);
+    node.sizeZ = std::min(chunkSize << level, gridHeight - 1 - node.startZ);
+    for (int i = 0; i < 4; i++) node.children[i] = -1;
+    
+    int index = static_cast<int>(m_nodes.size());
+    m_nodes.push_back(node);
+    
+    if (level == 0)
+    {
+        m_nodes[index].chunk = chunkZ * chunksPerRow + chunkX;
+        return index;
+    }
+    
+    int half = 1 << (level - 1);
+    for (int i = 0; i < 4; i++)
+    {
+        int child = buildNode(chunkX + (i & 1) * half, chunkZ + (i >> 1) * half, level - 1,
+                              chunksPerRow, chunksPerCol, chunkSize, gridWidth, gridHeight, interiorNodes);
+        m_nodes[index].children[i] = child;
+    }
+    
+    m_nodes[index].mesh = static_cast<int>(interiorNodes.size());
+    interiorNodes.push_back(index);
+    return index;
+}
+
+void TerrainQuadtree::updateBounds(const std::vector<TerrainChunk>& chunks, const std::vector<TerrainChunk>& nodeMeshes)
+{
+    if (m_root >= 0)
+    {
+        updateNodeBounds(m_root, chunks, nodeMeshes);
+    }
+}
+
+void TerrainQuadtree::updateNodeBounds(int index, const std::vector<TerrainChunk>& chunks,
+                                       const std::vector<TerrainChunk>& nodeMeshes)
+{
+    Node& node = m_nodes[index];
+    if (node.chunk >= 0)
+    {
+        node.min = chunks[node.chunk].getMin();
+        node.max = chunks[node.chunk].getMax();
+        return;
+    }
+    
+    // The coarse mesh samples a subset of the children's texels, so it lies inside their union
+    node.min = nodeMeshes[node.mesh].getMin();
+    node.max = nodeMeshes[node.mesh].getMax();
+    for (int child : node.children)
+    {
+        if (child < 0) continue;
+        updateNodeBounds(child, chunks, nodeMeshes);
+        node.min = glm::min(node.min, m_nodes[child].min);
+        node.max = glm::max(node.max, m_nodes[child].max);
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file TerrainQuadtree.h
+ * @brief Quadtree over the terrain chunk grid; interior nodes carry coarse meshes
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_QUADTREE_H
+#define TERRAIN_QUADTREE_H
+
+#include "TerrainChunk.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class TerrainQuadtree
+{
+public:
+    struct Node
+    {
+        glm::vec3 min, max;
+        int children[4];    // -1 where the quadrant lies outside the map
+        int chunk;          // leaf: index into the chunk grid, otherwise -1
+        int mesh;           // interior: index into the coarse node meshes, otherwise -1
+        int level;          // 0 for leaves; node covers (1 << level)^2 chunks
+        
+        // Heightmap region covered
+        int startX, startZ;
+        int sizeX, sizeZ;
+    };
+    
+    TerrainQuadtree();
+    
+    /**
+     * @brief Build the node hierarchy for a row-major chunk grid
+     * @return Interior node indices, in the order their coarse meshes should be built
+     */
+    std::vector<int> build(int chunksPerRow, int chunksPerCol, int chunkSize, int gridWidth, int gridHeight);
+    
+    // Bounds are known once leaf and node meshes exist
+    void updateBounds(const std::vector<TerrainChunk>& chunks, const std::vector<TerrainChunk>& nodeMeshes);
+    
+    void clear();
+    
+    bool isBuilt() const { return !m_nodes.empty(); }
+    int getRoot() const { return m_root; }
+    int getNodeCount() const { return static_cast<int>(m_nodes.size()); }
+    const Node& getNode(int index) const { return m_nodes[index]; }
+    Node& getNode(int index) { return m_nodes[index]; }
+
+private:
+    std::vector<Node> m_nodes;
+    int m_root;
+    
+    int buildNode(int chunkX, int chunkZ, int level, int chunksPerRow, int chunksPerCol,
+                  int chunkSize, int gridWidth, int gridHeight, std::vector<int>& interiorNodes);
+    void updateNodeBounds(int index, const std::vector<TerrainChunk>& chunks,
+                          const std::vector<TerrainChunk>& nodeMeshes);
+};
+
+#endif
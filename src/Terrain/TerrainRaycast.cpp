@@ -0,0 +1,170 @@
+#include "TerrainRaycast.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    const float EPSILON = 1e-7f;
+    
+    // Moller-Trumbore; updates tBest if the triangle is hit closer
+    bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+                           const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& tBest)
+    {
+        glm::vec3 e1 = b - a;
+        glm::vec3 e2 = c - a;
+        glm::vec3 p = glm::cross(direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < EPSILON) return false;
+        
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+        
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+        
+        float t = glm::dot(e2, q) * invDet;
+        if (t < 0.0f || t >= tBest) return false;
+        
+        tBest = t;
+        return true;
+    }
+}
+
+TerrainRaycast::TerrainRaycast(const HeightmapLoader& heightmap, float terrainSize, float maxHeight)
+    : m_heightmap(heightmap)
+    , m_pyramid(heightmap.getRangePyramid())
+    , m_cellSize(terrainSize / static_cast<float>(std::max(heightmap.getWidth() - 1, 1)))
+    , m_halfSize(terrainSize * 0.5f)
+    , m_heightScale(maxHeight / m_cellSize)
+{
+}
+
+bool TerrainRaycast::cast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                          TerrainRayHit& hit) const
+{
+    float length = glm::length(direction);
+    if (!m_pyramid.isBuilt() || length <= 0.0f || maxDistance <= 0.0f) return false;
+    
+    // Uniform scale to grid space keeps t in world units
+    Ray ray;
+    ray.origin = glm::vec3(origin.x + m_halfSize, origin.y, origin.z + m_halfSize) / m_cellSize;
+    ray.direction = direction / (length * m_cellSize);
+    for (int i = 0; i < 3; i++)
+    {
+        ray.invDirection[i] = ray.direction[i] != 0.0f ? 1.0f / ray.direction[i] : std::numeric_limits<float>::infinity();
+    }
+    
+    float tBest = maxDistance;
+    glm::vec3 normal(0.0f, 1.0f, 0.0f);
+    int top = m_pyramid.getLevelCount() - 1;
+    if (!visit(ray, top, 0, 0, tBest, normal)) return false;
+    
+    hit.distance = tBest;
+    hit.position = origin + direction / length * tBest;
+    hit.normal = normal;
+    return true;
+}
+
+bool TerrainRaycast::intersectBox(const Ray& ray, const glm::vec3& boxMin, const glm::vec3& boxMax,
+                                  float tMax, float& tEnter) const
+{
+    float t0 = 0.0f;
+    float t1 = tMax;
+    for (int i = 0; i < 3; i++)
+    {
+        if (ray.direction[i] == 0.0f)
+        {
+            // Parallel to the slab: inside it or never
+            if (ray.origin[i] < boxMin[i] || ray.origin[i] > boxMax[i]) return false;
+            continue;
+        }
+        float tNear = (boxMin[i] - ray.origin[i]) * ray.invDirection[i];
+        float tFar = (boxMax[i] - ray.origin[i]) * ray.invDirection[i];
+        if (tNear > tFar) std::swap(tNear, tFar);
+        t0 = std::max(t0, tNear);
+        t1 = std::min(t1, tFar);
+        if (t0 > t1) return false;
+    }
+    tEnter = t0;
+    return true;
+}
+
+bool TerrainRaycast::visit(const Ray& ray, int level, int nodeX, int nodeZ, float& tBest, glm::vec3& normal) const
+{
+    if (level == 0)
+    {
+        return intersectCell(ray, nodeX, nodeZ, tBest, normal);
+    }
+    
+    // Children in entry order; later ones are skipped once a closer hit exists
+    struct Child
+    {
+        int x, z;
+        float tEnter;
+    };
+    Child children[4];
+    int count = 0;
+    
+    int childLevel = level - 1;
+    int childSize = 1 << childLevel;
+    for (int i = 0; i < 4; i++)
+    {
+        int cx = nodeX * 2 + (i & 1);
+        int cz = nodeZ * 2 + (i >> 1);
+        if (cx >= m_pyramid.getNodesX(childLevel) || cz >= m_pyramid.getNodesZ(childLevel)) continue;
+        
+        float minH, maxH;
+        m_pyramid.getNodeRange(childLevel, cx, cz, minH, maxH);
+        glm::vec3 boxMin(static_cast<float>(cx * childSize), minH * m_heightScale, static_cast<float>(cz * childSize));
+        glm::vec3 boxMax(static_cast<float>((cx + 1) * childSize), maxH * m_heightScale, static_cast<float>((cz + 1) * childSize));
+        
+        float tEnter;
+        if (intersectBox(ray, boxMin, boxMax, tBest, tEnter))
+        {
+            children[count++] = { cx, cz, tEnter };
+        }
+    }
+    std::sort(children, children + count, [](const Child& a, const Child& b) { return a.tEnter < b.tEnter; });
+    
+    bool found = false;
+    for (int i = 0; i < count; i++)
+    {
+        if (children[i].tEnter > tBest) break;
+        found |= visit(ray, childLevel, children[i].x, children[i].z, tBest, normal);
+    }
+    return found;
+}
+
+bool TerrainRaycast::intersectCell(const Ray& ray, int cellX, int cellZ, float& tBest, glm::vec3& normal) const
+{
+    float x0 = static_cast<float>(cellX), x1 = x0 + 1.0f;
+    float z0 = static_cast<float>(cellZ), z1 = z0 + 1.0f;
+    glm::vec3 topLeft(x0, m_heightmap.getHeight(cellX, cellZ) * m_heightScale, z0);
+    glm::vec3 topRight(x1, m_heightmap.getHeight(cellX + 1, cellZ) * m_heightScale, z0);
+    glm::vec3 bottomLeft(x0, m_heightmap.getHeight(cellX, cellZ + 1) * m_heightScale, z1);
+    glm::vec3 bottomRight(x1, m_heightmap.getHeight(cellX + 1, cellZ + 1) * m_heightScale, z1);
+    
+    // Same split as TerrainIndexCache::buildGridIndices
+    bool found = false;
+    if (intersectTriangle(ray.origin, ray.direction, topLeft, bottomLeft, topRight, tBest))
+    {
+        normal = glm::cross(bottomLeft - topLeft, topRight - topLeft);
+        found = true;
+    }
+    if (intersectTriangle(ray.origin, ray.direction, topRight, bottomLeft, bottomRight, tBest))
+    {
+        normal = glm::cross(bottomLeft - topRight, bottomRight - topRight);
+        found = true;
+    }
+    
+    // Grid space is a uniform scale of world space, so the normal carries over
+    if (found)
+    {
+        normal = glm::normalize(normal);
+        if (normal.y < 0.0f) normal = -normal;
+    }
+    return found;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file TerrainRaycast.h
+ * @brief Ray vs. heightmap intersection over the min/max height pyramid
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_RAYCAST_H
+#define TERRAIN_RAYCAST_H
+
+#include "HeightmapLoader.h"
+#include <glm/glm.hpp>
+
+struct TerrainRayHit
+{
+    float distance;         // along the normalized ray direction
+    glm::vec3 position;
+    glm::vec3 normal;       // of the hit triangle
+};
+
+/**
+ * @brief Casts rays against the triangles the terrain renders at LOD 0
+ *
+ * Pyramid nodes whose height range the ray passes over or under are skipped whole;
+ * the rest are visited front to back, so the first cell hit ends the search.
+ * Thread-safe: only reads the heightmap.
+ */
+class TerrainRaycast
+{
+public:
+    TerrainRaycast(const HeightmapLoader& heightmap, float terrainSize, float maxHeight);
+
+    bool cast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TerrainRayHit& hit) const;
+
+private:
+    struct Ray
+    {
+        glm::vec3 origin;       // grid space: texels in XZ, cell sizes in Y
+        glm::vec3 direction;
+        glm::vec3 invDirection;
+    };
+
+    const HeightmapLoader& m_heightmap;
+    const HeightRangePyramid& m_pyramid;
+    float m_cellSize;
+    float m_halfSize;
+    float m_heightScale;    // normalized height to grid Y
+
+    bool intersectBox(const Ray& ray, const glm::vec3& boxMin, const glm::vec3& boxMax,
+                      float tMax, float& tEnter) const;
+    bool intersectCell(const Ray& ray, int cellX, int cellZ, float& tBest, glm::vec3& normal) const;
+    bool visit(const Ray& ray, int level, int nodeX, int nodeZ, float& tBest, glm::vec3& normal) const;
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include "TerrainSampler.h"
+#include "Core/CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef ROAMING_SIMD_X86
+#include <immintrin.h>
+#endif
+
+TerrainSampler::TerrainSampler(const HeightmapLoader& heightmap, float terrainSize, float maxHeight, bool allowSIMD)
+    : m_heightmap(heightmap)
+    , m_samples(heightmap.getSamples())
+    , m_storage(heightmap.getStorage())
+    , m_sampleScale(heightmap.getSampleScale())
+    , m_width(heightmap.getWidth())
+    , m_height(heightmap.getGridHeight())
+    , m_halfSize(terrainSize * 0.5f)
+    , m_scaleX(static_cast<float>(heightmap.getWidth() - 1) / terrainSize)
+    , m_scaleZ(static_cast<float>(heightmap.getGridHeight() - 1) / terrainSize)
+    , m_maxHeight(maxHeight)
+    , m_cellSize(terrainSize / static_cast<float>(heightmap.getWidth() - 1))
+    , m_path(Path::Scalar)
+{
+#ifdef ROAMING_SIMD_X86
+    // Gathers need the row-major sample array; int32 indices cap the texel count
+    bool gatherable = m_samples && static_cast<double>(m_width) * m_height < 2147483647.0;
+    if (allowSIMD && gatherable)
+    {
+        m_path = CpuFeatures::get().getBestPath();
+    }
+#else
+    (void)allowSIMD;
+#endif
+}
+
+const char* TerrainSampler::getPathName() const
+{
+    return CpuFeatures::getPathName(m_path);
+}
+
+void TerrainSampler::sample(const float* worldX, const float* worldZ, size_t count,
+                            float* heights, glm::vec3* normals) const
+{
+    if (!m_heightmap.isLoaded() || count == 0) return;
+    
+    Args args = { worldX, worldZ, heights, normals, count };
+    size_t done = 0;
+    if (m_path == Path::AVX2) done = sampleAVX2(args);
+    else if (m_path == Path::SSE2) done = sampleSSE2(args);
+    sampleScalar(args, done);
+}
+
+glm::vec3 TerrainSampler::interpolateNormal(int x0, int z0, int x1, int z1, float fx, float fz) const
+{
+    glm::vec3 n00 = TerrainNormalField::calculateNormal(m_heightmap, x0, z0, m_cellSize, m_maxHeight);
+    glm::vec3 n10 = TerrainNormalField::calculateNormal(m_heightmap, x1, z0, m_cellSize, m_maxHeight);
+    glm::vec3 n01 = TerrainNormalField::calculateNormal(m_heightmap, x0, z1, m_cellSize, m_maxHeight);
+    glm::vec3 n11 = TerrainNormalField::calculateNormal(m_heightmap, x1, z1, m_cellSize, m_maxHeight);
+    glm::vec3 n0 = n00 + (n10 - n00) * fx;
+    glm::vec3 n1 = n01 + (n11 - n01) * fx;
+    return glm::normalize(n0 + (n1 - n0) * fz);
+}
+
+void TerrainSampler::sampleScalar(const Args& args, size_t first) const
+{
+    float maxX = static_cast<float>(m_width - 1);
+    float maxZ = static_cast<float>(m_height - 1);
+    
+    for (size_t i = first; i < args.count; i++)
+    {
+        // Same mapping and clamping as ChunkedTerrain::getHeightAt
+        float px = std::max(0.0f, std::min((args.worldX[i] + m_halfSize) * m_scaleX, maxX));
+        float pz = std::max(0.0f, std::min((args.worldZ[i] + m_halfSize) * m_scaleZ, maxZ));
+        int x0 = static_cast<int>(px);
+        int z0 = static_cast<int>(pz);
+        int x1 = std::min(x0 + 1, m_width - 1);
+        int z1 = std::min(z0 + 1, m_height - 1);
+        float fx = px - static_cast<float>(x0);
+        float fz = pz - static_cast<float>(z0);
+        
+        float h00, h10, h01, h11;
+        if (m_samples)
+        {
+            size_t row0 = static_cast<size_t>(z0) * m_width;
+            size_t row1 = static_cast<size_t>(z1) * m_width;
+            h00 = loadHeight(row0 + x0);
+            h10 = loadHeight(row0 + x1);
+            h01 = loadHeight(row1 + x0);
+            h11 = loadHeight(row1 + x1);
+        }
+        else
+        {
+            h00 = m_heightmap.getHeight(x0, z0);
+            h10 = m_heightmap.getHeight(x1, z0);
+            h01 = m_heightmap.getHeight(x0, z1);
+            h11 = m_heightmap.getHeight(x1, z1);
+        }
+        float h0 = h00 + (h10 - h00) * fx;
+        float h1 = h01 + (h11 - h01) * fx;
+        args.heights[i] = (h0 + (h1 - h0) * fz) * m_maxHeight;
+        
+        if (args.normals)
+        {
+            args.normals[i] = interpolateNormal(x0, z0, x1, z1, fx, fz);
+        }
+    }
+}
+
+#ifdef ROAMING_SIMD_X86
+
+size_t TerrainSampler::sampleSSE2(const Args& args) const
+{
+    // SSE2 has no gather: indices and weights are vectorized, loads stay scalar
+    const __m128 half = _mm_set1_ps(m_halfSize);
+    const __m128 scaleX = _mm_set1_ps(m_scaleX);
+    const __m128 scaleZ = _mm_set1_ps(m_scaleZ);
+    const __m128 maxX = _mm_set1_ps(static_cast<float>(m_width - 1));
+    const __m128 maxZ = _mm_set1_ps(static_cast<float>(m_height - 1));
+    const __m128 maxHeight = _mm_set1_ps(m_maxHeight);
+    const __m128i lastX = _mm_set1_epi32(m_width - 1);
+    const __m128i lastZ = _mm_set1_epi32(m_height - 1);
+    
+    alignas(16) int i00[4], i10[4], i01[4], i11[4];
+    alignas(16) float fxs[4], fzs[4];
+    
+    size_t i = 0;
+    for (; i + 4 <= args.count; i += 4)
+    {
+        __m128 px = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(args.worldX + i), half), scaleX), _mm_setzero_ps()), maxX);
+        __m128 pz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(args.worldZ + i), half), scaleZ), _mm_setzero_ps()), maxZ);
+        
+        // Non-negative after clamping, so truncation is floor
+        __m128i x0 = _mm_cvttps_epi32(px);
+        __m128i z0 = _mm_cvttps_epi32(pz);
+        __m128 fx = _mm_sub_ps(px, _mm_cvtepi32_ps(x0));
+        __m128 fz = _mm_sub_ps(pz, _mm_cvtepi32_ps(z0));
+        
+        // +1 except on the last column/row (compare mask is -1 where below the edge)
+        __m128i x1 = _mm_sub_epi32(x0, _mm_cmplt_epi32(x0, lastX));
+        __m128i z1 = _mm_sub_epi32(z0, _mm_cmplt_epi32(z0, lastZ));
+        
+        // Row offsets via 16-bit multiplies would overflow; do them per lane
+        alignas(16) int xs0[4], xs1[4], zs0[4], zs1[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(xs0), x0);
+        _mm_store_si128(reinterpret_cast<__m128i*>(xs1), x1);
+        _mm_store_si128(reinterpret_cast<__m128i*>(zs0), z0);
+        _mm_store_si128(reinterpret_cast<__m128i*>(zs1), z1);
+        for (int k = 0; k < 4; k++)
+        {
+            int row0 = zs0[k] * m_width;
+            int row1 = zs1[k] * m_width;
+            i00[k] = row0 + xs0[k]; i10[k] = row0 + xs1[k];
+            i01[k] = row1 + xs0[k]; i11[k] = row1 + xs1[k];
+        }
+        
+        __m128 h00 = _mm_setr_ps(loadHeight(i00[0]), loadHeight(i00[1]), loadHeight(i00[2]), loadHeight(i00[3]));
+        __m128 h10 = _mm_setr_ps(loadHeight(i10[0]), loadHeight(i10[1]), loadHeight(i10[2]), loadHeight(i10[3]));
+        __m128 h01 = _mm_setr_ps(loadHeight(i01[0]), loadHeight(i01[1]), loadHeight(i01[2]), loadHeight(i01[3]));
+        __m128 h11 = _mm_setr_ps(loadHeight(i11[0]), loadHeight(i11[1]), loadHeight(i11[2]), loadHeight(i11[3]));
+        
+        __m128 h0 = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(h10, h00), fx));
+        __m128 h1 = _mm_add_ps(h01, _mm_mul_ps(_mm_sub_ps(h11, h01), fx));
+        __m128 h = _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), fz));
+        _mm_storeu_ps(args.heights + i, _mm_mul_ps(h, maxHeight));
+        
+        // Normals need 16 texels per point; without gathers they go through the scalar helper
+        if (args.normals)
+        {
+            _mm_store_ps(fxs, fx);
+            _mm_store_ps(fzs, fz);
+            for (int k = 0; k < 4; k++)
+            {
+                args.normals[i + k] = interpolateNormal(xs0[k], zs0[k], xs1[k], zs1[k], fxs[k], fzs[k]);
+            }
+        }
+    }
+    return i;
+}
+
+namespace
+{
+    /**
+     * Normalized heights of 8 texels. Narrow samples are fetched as 32-bit words at their
+     * byte offset and masked; the loader pads its arrays so the last one stays in bounds.
+     */
+    ROAMING_TARGET_AVX2
+    __m256 gatherHeights(const void* samples, HeightStorage storage, __m256i indices, float scale)
+    {
+        switch (storage)
+        {
+        case HeightStorage::UInt8:
+        {
+            __m256i words = _mm256_i32gather_epi32(static_cast<const int*>(samples), indices, 1);
+            __m256i values = _mm256_and_si256(words, _mm256_set1_epi32(0xFF));
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(values), _mm256_set1_ps(scale));
+        }
+        case HeightStorage::UInt16:
+        {
+            __m256i words = _mm256_i32gather_epi32(static_cast<const int*>(samples), indices, 2);
+            __m256i values = _mm256_and_si256(words, _mm256_set1_epi32(0xFFFF));
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(values), _mm256_set1_ps(scale));
+        }
+        default:
+            return _mm256_i32gather_ps(static_cast<const float*>(samples), indices, 4);
+        }
+    }
+    
+    /**
+     * Unit normals of texels (x, z) from central differences, computed as TerrainNormalField
+     * does. left/right are the clamped columns beside x, down/up the clamped rows beside z.
+     */
+    ROAMING_TARGET_AVX2
+    void texelNormals(const void* samples, HeightStorage storage, float sampleScale, __m256i width,
+                      __m256i x, __m256i z, __m256i left, __m256i right, __m256i down, __m256i up,
+                      __m256 heightScale, __m256 normalY, __m256 normal[3])
+    {
+        __m256i row = _mm256_mullo_epi32(z, width);
+        __m256 hL = gatherHeights(samples, storage, _mm256_add_epi32(row, left), sampleScale);
+        __m256 hR = gatherHeights(samples, storage, _mm256_add_epi32(row, right), sampleScale);
+        __m256 hD = gatherHeights(samples, storage, _mm256_add_epi32(_mm256_mullo_epi32(down, width), x), sampleScale);
+        __m256 hU = gatherHeights(samples, storage, _mm256_add_epi32(_mm256_mullo_epi32(up, width), x), sampleScale);
+        
+        __m256 dx = _mm256_mul_ps(_mm256_sub_ps(hL, hR), heightScale);
+        __m256 dz = _mm256_mul_ps(_mm256_sub_ps(hD, hU), heightScale);
+        __m256 lengthSq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(normalY, normalY)));
+        __m256 invLength = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lengthSq));
+        normal[0] = _mm256_mul_ps(dx, invLength);
+        normal[1] = _mm256_mul_ps(normalY, invLength);
+        normal[2] = _mm256_mul_ps(dz, invLength);
+    }
+}
+
+ROAMING_TARGET_AVX2
+size_t TerrainSampler::sampleAVX2(const Args& args) const
+{
+    const __m256 half = _mm256_set1_ps(m_halfSize);
+    const __m256 scaleX = _mm256_set1_ps(m_scaleX);
+    const __m256 scaleZ = _mm256_set1_ps(m_scaleZ);
+    const __m256 maxX = _mm256_set1_ps(static_cast<float>(m_width - 1));
+    const __m256 maxZ = _mm256_set1_ps(static_cast<float>(m_height - 1));
+    const __m256 maxHeight = _mm256_set1_ps(m_maxHeight);
+    const __m256i lastX = _mm256_set1_epi32(m_width - 1);
+    const __m256i lastZ = _mm256_set1_epi32(m_height - 1);
+    const __m256i width = _mm256_set1_epi32(m_width);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256 normalY = _mm256_set1_ps(2.0f * m_cellSize);
+    
+    size_t i = 0;
+    for (; i + 8 <= args.count; i += 8)
+    {
+        __m256 px = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(args.worldX + i), half), scaleX), _mm256_setzero_ps()), maxX);
+        __m256 pz = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(args.worldZ + i), half), scaleZ), _mm256_setzero_ps()), maxZ);
+        
+        __m256i x0 = _mm256_cvttps_epi32(px);
+        __m256i z0 = _mm256_cvttps_epi32(pz);
+        __m256 fx = _mm256_sub_ps(px, _mm256_cvtepi32_ps(x0));
+        __m256 fz = _mm256_sub_ps(pz, _mm256_cvtepi32_ps(z0));
+        __m256i x1 = _mm256_sub_epi32(x0, _mm256_cmpgt_epi32(lastX, x0));
+        __m256i z1 = _mm256_sub_epi32(z0, _mm256_cmpgt_epi32(lastZ, z0));
+        
+        __m256i row0 = _mm256_mullo_epi32(z0, width);
+        __m256i row1 = _mm256_mullo_epi32(z1, width);
+        __m256i i00 = _mm256_add_epi32(row0, x0);
+        __m256i i10 = _mm256_add_epi32(row0, x1);
+        __m256i i01 = _mm256_add_epi32(row1, x0);
+        __m256i i11 = _mm256_add_epi32(row1, x1);
+        
+        __m256 h00 = gatherHeights(m_samples, m_storage, i00, m_sampleScale);
+        __m256 h10 = gatherHeights(m_samples, m_storage, i10, m_sampleScale);
+        __m256 h01 = gatherHeights(m_samples, m_storage, i01, m_sampleScale);
+        __m256 h11 = gatherHeights(m_samples, m_storage, i11, m_sampleScale);
+        
+        __m256 h0 = _mm256_fmadd_ps(_mm256_sub_ps(h10, h00), fx, h00);
+        __m256 h1 = _mm256_fmadd_ps(_mm256_sub_ps(h11, h01), fx, h01);
+        __m256 h = _mm256_fmadd_ps(_mm256_sub_ps(h1, h0), fz, h0);
+        _mm256_storeu_ps(args.heights + i, _mm256_mul_ps(h, maxHeight));
+        
+        if (args.normals)
+        {
+            // Neighbours of the corners, clamped like getHeight(); right of x0 is x1 and above z0 is z1
+            __m256i left0 = _mm256_max_epi32(_mm256_sub_epi32(x0, one), zero);
+            __m256i left1 = _mm256_max_epi32(_mm256_sub_epi32(x1, one), zero);
+            __m256i right1 = _mm256_min_epi32(_mm256_add_epi32(x1, one), lastX);
+            __m256i down0 = _mm256_max_epi32(_mm256_sub_epi32(z0, one), zero);
+            __m256i down1 = _mm256_max_epi32(_mm256_sub_epi32(z1, one), zero);
+            __m256i up1 = _mm256_min_epi32(_mm256_add_epi32(z1, one), lastZ);
+            
+            __m256 n00[3], n10[3], n01[3], n11[3];
+            texelNormals(m_samples, m_storage, m_sampleScale, width, x0, z0, left0, x1, down0, z1, maxHeight, normalY, n00);
+            texelNormals(m_samples, m_storage, m_sampleScale, width, x1, z0, left1, right1, down0, z1, maxHeight, normalY, n10);
+            texelNormals(m_samples, m_storage, m_sampleScale, width, x0, z1, left0, x1, down1, up1, maxHeight, normalY, n01);
+            texelNormals(m_samples, m_storage, m_sampleScale, width, x1, z1, left1, right1, down1, up1, maxHeight, normalY, n11);
+            
+            __m256 n[3];
+            for (int a = 0; a < 3; a++)
+            {
+                __m256 n0 = _mm256_fmadd_ps(_mm256_sub_ps(n10[a], n00[a]), fx, n00[a]);
+                __m256 n1 = _mm256_fmadd_ps(_mm256_sub_ps(n11[a], n01[a]), fx, n01[a]);
+                n[a] = _mm256_fmadd_ps(_mm256_sub_ps(n1, n0), fz, n0);
+            }
+            __m256 lengthSq = _mm256_fmadd_ps(n[2], n[2], _mm256_fmadd_ps(n[1], n[1], _mm256_mul_ps(n[0], n[0])));
+            __m256 invLength = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lengthSq));
+            
+            alignas(32) float nx[8], ny[8], nz[8];
+            _mm256_store_ps(nx, _mm256_mul_ps(n[0], invLength));
+            _mm256_store_ps(ny, _mm256_mul_ps(n[1], invLength));
+            _mm256_store_ps(nz, _mm256_mul_ps(n[2], invLength));
+            for (int k = 0; k < 8; k++)
+            {
+                args.normals[i + k] = glm::vec3(nx[k], ny[k], nz[k]);
+            }
+        }
+    }
+    return i;
+}
+
+#else
+
+size_t TerrainSampler::sampleSSE2(const Args&) const
+{
+    return 0;
+}
+
+size_t TerrainSampler::sampleAVX2(const Args&) const
+{
+    return 0;
+}
+
+#endif
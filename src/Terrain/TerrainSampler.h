@@ -0,0 +1,83 @@
+/**
+ * @file TerrainSampler.h
+ * @brief Batched bilinear height (and normal) sampling with SSE2/AVX2 gathers
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_SAMPLER_H
+#define TERRAIN_SAMPLER_H
+
+#include "HeightmapLoader.h"
+#include "TerrainNormalField.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+
+/**
+ * @brief Samples many world XZ positions at once, matching ChunkedTerrain::getHeightAt
+ *
+ * Construction is cheap; build one per batch. Thread-safe: only reads its sources.
+ */
+class TerrainSampler
+{
+public:
+    using Path = SimdPath;
+
+    /**
+     * @param allowSIMD false forces the scalar path (for comparison)
+     */
+    TerrainSampler(const HeightmapLoader& heightmap, float terrainSize, float maxHeight, bool allowSIMD = true);
+
+    /**
+     * @brief Bilinear heights at (worldX[i], worldZ[i]), clamped to the terrain
+     * @param normals Optional output, bilinearly interpolated from the texel normals the chunk
+     *        meshes use (central differences, see TerrainNormalField)
+     */
+    void sample(const float* worldX, const float* worldZ, size_t count,
+                float* heights, glm::vec3* normals = nullptr) const;
+
+    Path getPath() const { return m_path; }
+    const char* getPathName() const;
+
+private:
+    const HeightmapLoader& m_heightmap;
+    const void* m_samples;      // null for tiled heightmaps, which take the scalar path
+    HeightStorage m_storage;
+    float m_sampleScale;        // samples to normalized heights
+    int m_width;
+    int m_height;
+    float m_halfSize;
+    float m_scaleX;             // world units to texels
+    float m_scaleZ;
+    float m_maxHeight;
+    float m_cellSize;           // world distance between texels, as the chunk builds use
+    Path m_path;
+
+    struct Args
+    {
+        const float* worldX;
+        const float* worldZ;
+        float* heights;
+        glm::vec3* normals;
+        size_t count;
+    };
+
+    // Normalized height of row-major texel i (m_samples must be set)
+    float loadHeight(size_t i) const
+    {
+        switch (m_storage)
+        {
+        case HeightStorage::UInt8:  return static_cast<const uint8_t*>(m_samples)[i] * m_sampleScale;
+        case HeightStorage::UInt16: return static_cast<const uint16_t*>(m_samples)[i] * m_sampleScale;
+        default:                    return static_cast<const float*>(m_samples)[i];
+        }
+    }
+
+    // Texel normals at the corners (x0, z0) .. (x1, z1), blended with the bilinear weights
+    glm::vec3 interpolateNormal(int x0, int z0, int x1, int z1, float fx, float fz) const;
+
+    void sampleScalar(const Args& args, size_t first) const;
+    size_t sampleSSE2(const Args& args) const;
+    size_t sampleAVX2(const Args& args) const;
+};
+
+#endif
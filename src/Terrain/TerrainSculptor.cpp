@@ -0,0 +1,121 @@
+#include "TerrainSculptor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // 1 inside (1 - falloff) of the radius, easing to 0 at the rim
+    float brushWeight(float distance, float radius, float falloff)
+    {
+        float r = distance / radius;
+        if (r >= 1.0f) return 0.0f;
+        
+        float edge = std::max(falloff, 1e-4f);
+        if (r <= 1.0f - edge) return 1.0f;
+        float t = (1.0f - r) / edge;
+        return t * t * (3.0f - 2.0f * t);
+    }
+}
+
+TerrainSculptor::TerrainSculptor(HeightmapLoader& heightmap, float terrainSize, float maxHeight)
+    : m_heightmap(heightmap)
+    , m_halfSize(terrainSize * 0.5f)
+    , m_scaleX(static_cast<float>(heightmap.getWidth() - 1) / terrainSize)
+    , m_scaleZ(static_cast<float>(heightmap.getGridHeight() - 1) / terrainSize)
+    , m_maxHeight(maxHeight)
+{
+}
+
+bool TerrainSculptor::getFootprint(const TerrainBrush& brush, float centerX, float centerZ,
+                                   TerrainTexelRect& footprint) const
+{
+    if (!m_heightmap.isEditable() || brush.radius <= 0.0f) return false;
+    
+    // Brush centre and radius in texels
+    float cx = (centerX + m_halfSize) * m_scaleX;
+    float cz = (centerZ + m_halfSize) * m_scaleZ;
+    float rx = brush.radius * m_scaleX;
+    float rz = brush.radius * m_scaleZ;
+    
+    footprint.x0 = std::max(0, static_cast<int>(std::ceil(cx - rx)));
+    footprint.z0 = std::max(0, static_cast<int>(std::ceil(cz - rz)));
+    footprint.x1 = std::min(m_heightmap.getWidth() - 1, static_cast<int>(std::floor(cx + rx)));
+    footprint.z1 = std::min(m_heightmap.getGridHeight() - 1, static_cast<int>(std::floor(cz + rz)));
+    return footprint.x0 <= footprint.x1 && footprint.z0 <= footprint.z1;
+}
+
+bool TerrainSculptor::apply(const TerrainBrush& brush, float centerX, float centerZ, float deltaTime,
+                            TerrainTexelRect& changed)
+{
+    if (deltaTime <= 0.0f || !getFootprint(brush, centerX, centerZ, changed)) return false;
+    
+    int width = m_heightmap.getWidth();
+    int height = m_heightmap.getGridHeight();
+    float cx = (centerX + m_halfSize) * m_scaleX;
+    float cz = (centerZ + m_halfSize) * m_scaleZ;
+    
+    // Smoothing reads neighbours, which must not see this step's writes
+    int bx0 = std::max(0, changed.x0 - 1), bz0 = std::max(0, changed.z0 - 1);
+    int bx1 = std::min(width - 1, changed.x1 + 1), bz1 = std::min(height - 1, changed.z1 + 1);
+    int beforeWidth = bx1 - bx0 + 1;
+    if (brush.mode == TerrainBrushMode::Smooth)
+    {
+        m_before.resize(static_cast<size_t>(beforeWidth) * (bz1 - bz0 + 1));
+        for (int z = bz0; z <= bz1; z++)
+        {
+            for (int x = bx0; x <= bx1; x++)
+            {
+                m_before[static_cast<size_t>(z - bz0) * beforeWidth + (x - bx0)] = m_heightmap.getEditedHeight(x, z);
+            }
+        }
+    }
+    auto before = [&](int x, int z)
+    {
+        x = std::max(bx0, std::min(x, bx1));
+        z = std::max(bz0, std::min(z, bz1));
+        return m_before[static_cast<size_t>(z - bz0) * beforeWidth + (x - bx0)];
+    };
+    
+    float step = brush.strength * deltaTime;
+    float blend = std::min(step, 1.0f);
+    float target = brush.targetHeight / m_maxHeight;
+    
+    for (int z = changed.z0; z <= changed.z1; z++)
+    {
+        for (int x = changed.x0; x <= changed.x1; x++)
+        {
+            // Distance measured in world units so the footprint stays round on non-square maps
+            float dx = (x - cx) / m_scaleX;
+            float dz = (z - cz) / m_scaleZ;
+            float weight = brushWeight(std::sqrt(dx * dx + dz * dz), brush.radius, brush.falloff);
+            if (weight <= 0.0f) continue;
+            
+            float h = m_heightmap.getEditedHeight(x, z);
+            switch (brush.mode)
+            {
+            case TerrainBrushMode::Raise:
+                h += step * weight / m_maxHeight;
+                break;
+            case TerrainBrushMode::Lower:
+                h -= step * weight / m_maxHeight;
+                break;
+            case TerrainBrushMode::Smooth:
+            {
+                float sum = 0.0f;
+                for (int oz = -1; oz <= 1; oz++)
+                {
+                    for (int ox = -1; ox <= 1; ox++) sum += before(x + ox, z + oz);
+                }
+                h += (sum / 9.0f - h) * blend * weight;
+                break;
+            }
+            case TerrainBrushMode::Flatten:
+                h += (target - h) * blend * weight;
+                break;
+            }
+            m_heightmap.setHeight(x, z, h);
+        }
+    }
+    
+    m_heightmap.updateHeightRange(changed.x0, changed.z0, changed.x1, changed.z1);
+    return true;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file TerrainSculptor.h
+ * @brief Brush edits (raise, lower, smooth, flatten) applied to the heightmap in place
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_SCULPTOR_H
+#define TERRAIN_SCULPTOR_H
+
+#include "HeightmapLoader.h"
+#include <vector>
+
+enum class TerrainBrushMode
+{
+    Raise,
+    Lower,
+    Smooth,     // towards the 3x3 average
+    Flatten     // towards targetHeight
+};
+
+struct TerrainBrush
+{
+    TerrainBrushMode mode = TerrainBrushMode::Raise;
+    float radius = 8.0f;            // world units
+    float strength = 5.0f;          // Raise/Lower: world units per second; Smooth/Flatten: blend rate per second
+    float falloff = 0.5f;           // outer fraction of the radius over which the weight fades out
+    float targetHeight = 0.0f;      // Flatten: world height
+};
+
+// Inclusive heightmap texel rectangle
+struct TerrainTexelRect
+{
+    int x0, z0, x1, z1;
+};
+
+/**
+ * @brief Writes brush steps into an editable heightmap and keeps its range pyramid current
+ *
+ * Meshes and normals are not touched; the caller refreshes whatever covers the changed texels.
+ */
+class TerrainSculptor
+{
+public:
+    TerrainSculptor(HeightmapLoader& heightmap, float terrainSize, float maxHeight);
+
+    /**
+     * @brief One step of the brush centred on world (centerX, centerZ), scaled by deltaTime
+     * @param changed Texels that may have changed
+     * @return false if the brush misses the terrain or the heightmap is read-only
+     */
+    bool apply(const TerrainBrush& brush, float centerX, float centerZ, float deltaTime,
+               TerrainTexelRect& changed);
+    
+    // Texels apply() may write for this brush position; false if it misses the terrain
+    bool getFootprint(const TerrainBrush& brush, float centerX, float centerZ, TerrainTexelRect& footprint) const;
+
+private:
+    HeightmapLoader& m_heightmap;
+    float m_halfSize;
+    float m_scaleX;             // world units to texels
+    float m_scaleZ;
+    float m_maxHeight;
+    std::vector<float> m_before;    // heights around the brush before this step, for Smooth
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "TerrainStreamer.h"
+#include <algorithm>
+#include <iterator>
+
+TerrainStreamer::TerrainStreamer()
+    : m_frame(0)
+    , m_workers(nullptr)
+    , m_inFlight(0)
+    , m_building(0)
+    , m_residentBytes(0)
+    , m_evictions(0)
+    , m_uploads(0)
+{
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+    clear();
+}
+
+void TerrainStreamer::reset(int chunkCount, ThreadPool* workers, BuildFunc build)
+{
+    clear();
+    m_states.assign(chunkCount, State::Absent);
+    m_lastUsed.assign(chunkCount, 0);
+    m_lruPos.assign(chunkCount, m_lru.end());
+    m_workers = workers;
+    m_build = std::move(build);
+}
+
+void TerrainStreamer::clear()
+{
+    {
+        // Builds reference the caller's heightmap, so none may outlive it
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_inFlight == 0; });
+        m_completed.clear();
+    }
+    
+    m_states.clear();
+    m_lastUsed.clear();
+    m_lru.clear();
+    m_lruPos.clear();
+    m_requests.clear();
+    m_build = nullptr;
+    m_workers = nullptr;
+    m_frame = 0;
+    m_building = 0;
+    m_residentBytes = 0;
+    m_evictions = 0;
+    m_uploads = 0;
+}
+
+void TerrainStreamer::request(int chunkIndex, float priority)
+{
+    if (m_states[chunkIndex] != State::Absent) return;
+    m_requests.push_back({ priority, chunkIndex });
+}
+
+void TerrainStreamer::touch(int chunkIndex)
+{
+    if (m_states[chunkIndex] != State::Resident) return;
+    m_lastUsed[chunkIndex] = m_frame;
+    m_lru.splice(m_lru.begin(), m_lru, m_lruPos[chunkIndex]);
+}
+
+void TerrainStreamer::invalidate(const std::vector<int>& chunkIndices)
+{
+    if (!m_build) return;
+    
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_inFlight == 0; });
+    
+    // Built from the old data; the chunks go back to Absent and are requested again
+    auto stale = [&](const std::pair<int, TerrainChunkData>& item)
+    {
+        return std::find(chunkIndices.begin(), chunkIndices.end(), item.first) != chunkIndices.end();
+    };
+    for (const auto& item : m_completed)
+    {
+        if (stale(item))
+        {
+            m_states[item.first] = State::Absent;
+            m_building--;
+        }
+    }
+    m_completed.erase(std::remove_if(m_completed.begin(), m_completed.end(), stale), m_completed.end());
+}
+
+void TerrainStreamer::update(std::vector<TerrainChunk>& chunks, TerrainIndexCache& indexCache)
+{
+    if (!m_build) return;
+    
+    startBuilds();
+    uploadCompleted(chunks, indexCache);
+    evictOverBudget(chunks);
+    m_frame++;
+}
+
+void TerrainStreamer::startBuilds()
+{
+    // Several passes may request the same chunk; the nearest request wins
+    std::sort(m_requests.begin(), m_requests.end());
+    
+    for (const auto& request : m_requests)
+    {
+        if (m_building >= m_maxBuildsInFlight) break;
+        
+        int index = request.second;
+        if (m_states[index] != State::Absent) continue;
+        m_states[index] = State::Building;
+        m_building++;
+        
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_inFlight++;
+        }
+        
+        auto job = [this, index]()
+        {
+            TerrainChunkData data;
+            m_build(index, data);
+            
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completed.emplace_back(index, std::move(data));
+            m_inFlight--;
+            m_idle.notify_all();
+        };
+        
+        if (m_workers)
+        {
+            m_workers->submit(job);
+        }
+        else
+        {
+            job();
+        }
+    }
+    
+    // Unserved requests are dropped; chunks still needed are requested again next frame
+    m_requests.clear();
+}
+
+void TerrainStreamer::uploadCompleted(std::vector<TerrainChunk>& chunks, TerrainIndexCache& indexCache)
+{
+    std::vector<std::pair<int, TerrainChunkData>> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t count = std::min(m_completed.size(), static_cast<size_t>(std::max(m_maxUploadsPerFrame, 1)));
+        std::move(m_completed.begin(), m_completed.begin() + count, std::back_inserter(ready));
+        m_completed.erase(m_completed.begin(), m_completed.begin() + count);
+    }
+    
+    for (auto& item : ready)
+    {
+        int index = item.first;
+        chunks[index].upload(item.second, indexCache);
+        
+        m_states[index] = State::Resident;
+        m_lastUsed[index] = m_frame;
+        m_lru.push_front(index);
+        m_lruPos[index] = m_lru.begin();
+        m_residentBytes += chunks[index].getVertexMemoryBytes();
+        m_building--;
+        m_uploads++;
+    }
+}
+
+void TerrainStreamer::evictOverBudget(std::vector<TerrainChunk>& chunks)
+{
+    // Chunks used this frame stay, even if that leaves the cache over budget
+    while (m_residentBytes > m_memoryBudgetBytes && !m_lru.empty())
+    {
+        int index = m_lru.back();
+        if (m_lastUsed[index] == m_frame) break;
+        
+        m_lru.pop_back();
+        m_lruPos[index] = m_lru.end();
+        m_residentBytes -= chunks[index].getVertexMemoryBytes();
+        chunks[index].release();
+        m_states[index] = State::Absent;
+        m_evictions++;
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * @file TerrainStreamer.h
+ * @brief Background chunk mesh streaming with an LRU cache under a memory budget
+ * @author LuNingfang
+ */
+
+#ifndef TERRAIN_STREAMER_H
+#define TERRAIN_STREAMER_H
+
+#include "TerrainChunk.h"
+#include "TerrainIndexCache.h"
+#include "Core/ThreadPool.h"
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class TerrainStreamer
+{
+public:
+    using BuildFunc = std::function<void(int chunkIndex, TerrainChunkData& data)>;
+    
+    TerrainStreamer();
+    ~TerrainStreamer();
+    
+    TerrainStreamer(const TerrainStreamer&) = delete;
+    TerrainStreamer& operator=(const TerrainStreamer&) = delete;
+    
+    /**
+     * @brief Start tracking chunkCount absent chunks
+     * @param build Called on worker threads; must only read shared data
+     * @param workers Null builds on the calling thread during update()
+     */
+    void reset(int chunkCount, ThreadPool* workers, BuildFunc build);
+    
+    // Waits for builds in flight, then forgets every chunk (GPU meshes are owned by the caller)
+    void clear();
+    
+    // Ask for a chunk this frame; lower priority values are built first
+    void request(int chunkIndex, float priority);
+    
+    // Mark a resident chunk as used this frame
+    void touch(int chunkIndex);
+    
+    /**
+     * @brief Before the shared data of these chunks changes: waits for builds in flight and
+     *        drops finished builds of them not yet uploaded. Resident meshes are the caller's to update.
+     */
+    void invalidate(const std::vector<int>& chunkIndices);
+    
+    /**
+     * @brief Start the most urgent builds, upload finished ones and evict the
+     *        least recently used chunks over budget. Once per frame, GL thread.
+     */
+    void update(std::vector<TerrainChunk>& chunks, TerrainIndexCache& indexCache);
+    
+    bool isResident(int chunkIndex) const { return m_states[chunkIndex] == State::Resident; }
+    int getResidentCount() const { return static_cast<int>(m_lru.size()); }
+    int getBuildingCount() const { return m_building; }
+    size_t getResidentBytes() const { return m_residentBytes; }
+    int getEvictionCount() const { return m_evictions; }
+    int getUploadCount() const { return m_uploads; }
+    
+    size_t m_memoryBudgetBytes = 256u << 20;
+    int m_maxBuildsInFlight = 8;
+    int m_maxUploadsPerFrame = 4;       // bounds the per-frame GL upload stall
+
+private:
+    enum class State
+    {
+        Absent,
+        Building,
+        Resident
+    };
+    
+    std::vector<State> m_states;
+    std::vector<unsigned int> m_lastUsed;               // frame of the last touch()
+    std::list<int> m_lru;                               // resident chunks, most recent first
+    std::vector<std::list<int>::iterator> m_lruPos;
+    std::vector<std::pair<float, int>> m_requests;      // this frame's (priority, chunk)
+    unsigned int m_frame;
+    
+    ThreadPool* m_workers;
+    BuildFunc m_build;
+    
+    // Shared with the workers
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::vector<std::pair<int, TerrainChunkData>> m_completed;
+    int m_inFlight;
+    
+    int m_building;     // chunks in State::Building, main thread only
+    
+    size_t m_residentBytes;
+    int m_evictions;
+    int m_uploads;
+    
+    void startBuilds();
+    void uploadCompleted(std::vector<TerrainChunk>& chunks, TerrainIndexCache& indexCache);
+    void evictOverBudget(std::vector<TerrainChunk>& chunks);
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "TiledHeightmap.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char MAGIC[4] = { 'R', 'H', 'M', 'T' };
+    
+    static_assert(sizeof(TiledHeightmap::Header) == 40, "tiled heightmap header layout");
+    static_assert(sizeof(TiledHeightmap::LevelEntry) == 24, "tiled heightmap level layout");
+    static_assert(sizeof(TiledHeightmap::TileEntry) == 8, "tiled heightmap tile layout");
+    
+    struct MipLevel
+    {
+        int width;
+        int height;
+        std::vector<uint16_t> samples;
+    };
+    
+    void runRows(ThreadPool* workers, size_t count, const std::function<void(size_t)>& func)
+    {
+        if (workers)
+        {
+            workers->parallelFor(count, func);
+        }
+        else
+        {
+            for (size_t i = 0; i < count; i++) func(i);
+        }
+    }
+    
+    // [1 2 1] tent around the aligned texel, clamped at the borders
+    void downsample(const MipLevel& src, MipLevel& dst, ThreadPool* workers)
+    {
+        dst.width = src.width / 2 + 1;
+        dst.height = src.height / 2 + 1;
+        dst.samples.resize(static_cast<size_t>(dst.width) * dst.height);
+        
+        static const int weights[3] = { 1, 2, 1 };
+        runRows(workers, dst.height, [&](size_t row)
+        {
+            int z = static_cast<int>(row);
+            for (int x = 0; x < dst.width; x++)
+            {
+                uint32_t sum = 0;
+                for (int dz = -1; dz <= 1; dz++)
+                {
+                    int sz = std::max(0, std::min(2 * z + dz, src.height - 1));
+                    for (int dx = -1; dx <= 1; dx++)
+                    {
+                        int sx = std::max(0, std::min(2 * x + dx, src.width - 1));
+                        sum += src.samples[static_cast<size_t>(sz) * src.width + sx] * weights[dx + 1] * weights[dz + 1];
+                    }
+                }
+                dst.samples[row * dst.width + x] = static_cast<uint16_t>((sum + 8) / 16);
+            }
+        });
+    }
+}
+
+TiledHeightmap::TiledHeightmap()
+    : m_tileShift(0)
+    , m_tileMask(0)
+{
+}
+
+bool TiledHeightmap::write(const std::string& path, const std::vector<uint16_t>& samples, int width, int height,
+                           int tileSize, ThreadPool* workers)
+{
+    if (width <= 0 || height <= 0 || samples.size() != static_cast<size_t>(width) * height ||
+        tileSize < 16 || (tileSize & (tileSize - 1)) != 0)
+    {
+        std::cerr << "ERROR::TILED_HEIGHTMAP::INVALID_INPUT" << std::endl;
+        return false;
+    }
+    
+    // Halve until one tile covers the level
+    std::vector<MipLevel> levels(1);
+    levels[0] = { width, height, samples };
+    while (std::max(levels.back().width, levels.back().height) > tileSize)
+    {
+        MipLevel next;
+        downsample(levels.back(), next, workers);
+        levels.push_back(std::move(next));
+    }
+    
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.tileSize = static_cast<uint32_t>(tileSize);
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.levelOffset = sizeof(Header);
+    header.indexOffset = header.levelOffset + sizeof(LevelEntry) * levels.size();
+    
+    std::vector<LevelEntry> levelEntries(levels.size());
+    uint64_t tileCount = 0;
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        LevelEntry& entry = levelEntries[i];
+        entry.width = static_cast<uint32_t>(levels[i].width);
+        entry.height = static_cast<uint32_t>(levels[i].height);
+        entry.tilesX = (entry.width + tileSize - 1) / tileSize;
+        entry.tilesZ = (entry.height + tileSize - 1) / tileSize;
+        entry.firstTile = tileCount;
+        tileCount += static_cast<uint64_t>(entry.tilesX) * entry.tilesZ;
+    }
+    
+    // Tile data starts page-aligned after the index
+    const uint64_t tileBytes = static_cast<uint64_t>(tileSize) * tileSize * sizeof(uint16_t);
+    uint64_t dataOffset = header.indexOffset + sizeof(TileEntry) * tileCount;
+    dataOffset = (dataOffset + 4095) & ~static_cast<uint64_t>(4095);
+    
+    std::vector<TileEntry> index(tileCount);
+    for (uint64_t i = 0; i < tileCount; i++)
+    {
+        index[i].offset = dataOffset + i * tileBytes;
+    }
+    
+    std::vector<uint16_t> tileData(tileCount * tileSize * tileSize);
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        const MipLevel& level = levels[i];
+        const LevelEntry& entry = levelEntries[i];
+        runRows(workers, static_cast<size_t>(entry.tilesX) * entry.tilesZ, [&](size_t t)
+        {
+            int tileX = static_cast<int>(t % entry.tilesX) * tileSize;
+            int tileZ = static_cast<int>(t / entry.tilesX) * tileSize;
+            uint16_t* dst = &tileData[(entry.firstTile + t) * tileSize * tileSize];
+            for (int z = 0; z < tileSize; z++)
+            {
+                int sz = std::min(tileZ + z, level.height - 1);
+                for (int x = 0; x < tileSize; x++)
+                {
+                    int sx = std::min(tileX + x, level.width - 1);
+                    dst[z * tileSize + x] = level.samples[static_cast<size_t>(sz) * level.width + sx];
+                }
+            }
+        });
+    }
+    
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "ERROR::TILED_HEIGHTMAP::FAILED_TO_CREATE: " << path << std::endl;
+        return false;
+    }
+    
+    std::vector<uint8_t> padding(dataOffset - header.indexOffset - sizeof(TileEntry) * tileCount, 0);
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(levelEntries.data(), sizeof(LevelEntry), levelEntries.size(), file) == levelEntries.size() &&
+              std::fwrite(index.data(), sizeof(TileEntry), index.size(), file) == index.size() &&
+              std::fwrite(padding.data(), 1, padding.size(), file) == padding.size() &&
+              std::fwrite(tileData.data(), sizeof(uint16_t), tileData.size(), file) == tileData.size();
+    ok = (std::fclose(file) == 0) && ok;
+    
+    if (!ok)
+    {
+        std::cerr << "ERROR::TILED_HEIGHTMAP::FAILED_TO_WRITE: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TiledHeightmap::open(const std::string& path)
+{
+    close();
+    if (!m_file.open(path)) return false;
+    
+    const uint8_t* base = m_file.getData();
+    uint64_t size = m_file.getSize();
+    
+    Header header;
+    if (size < sizeof(Header))
+    {
+        std::cerr << "ERROR::TILED_HEIGHTMAP::TRUNCATED: " << path << std::endl;
+        close();
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.tileSize < 16 || (header.tileSize & (header.tileSize - 1)) != 0 ||
+        header.levelCount == 0 || header.width == 0 || header.height == 0 ||
+        header.levelOffset + sizeof(LevelEntry) * static_cast<uint64_t>(header.levelCount) > size)
+    {
+        std::cerr << "ERROR::TILED_HEIGHTMAP::INVALID_HEADER: " << path << std::endl;
+        close();
+        return false;
+    }
+    
+    m_tileShift = 0;
+    while ((1u << m_tileShift) < header.tileSize) m_tileShift++;
+    m_tileMask = static_cast<int>(header.tileSize) - 1;
+    const uint64_t tileBytes = static_cast<uint64_t>(header.tileSize) * header.tileSize * sizeof(uint16_t);
+    
+    // Resolve every tile pointer once, checking it lies inside the file
+    m_levels.resize(header.levelCount);
+    for (uint32_t i = 0; i < header.levelCount; i++)
+    {
+        LevelEntry entry;
+        std::memcpy(&entry, base + header.levelOffset + sizeof(LevelEntry) * i, sizeof(entry));
+        
+        uint64_t tiles = static_cast<uint64_t>(entry.tilesX) * entry.tilesZ;
+        bool valid = entry.width > 0 && entry.height > 0 &&
+                     entry.tilesX == (entry.width + header.tileSize - 1) / header.tileSize &&
+                     entry.tilesZ == (entry.height + header.tileSize - 1) / header.tileSize &&
+                     header.indexOffset + sizeof(TileEntry) * (entry.firstTile + tiles) <= size;
+        
+        Level& level = m_levels[i];
+        level.width = entry.width;
+        level.height = entry.height;
+        level.tilesX = entry.tilesX;
+        level.tiles.resize(valid ? tiles : 0);
+        for (uint64_t t = 0; valid && t < tiles; t++)
+        {
+            TileEntry tile;
+            std::memcpy(&tile, base + header.indexOffset + sizeof(TileEntry) * (entry.firstTile + t), sizeof(tile));
+            valid = tile.offset % sizeof(uint16_t) == 0 && tile.offset + tileBytes <= size;
+            level.tiles[t] = reinterpret_cast<const uint16_t*>(base + tile.offset);
+        }
+        
+        if (!valid || (i == 0 && (entry.width != header.width || entry.height != header.height)))
+        {
+            std::cerr << "ERROR::TILED_HEIGHTMAP::INVALID_TILE_INDEX: " << path << std::endl;
+            close();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void TiledHeightmap::close()
+{
+    m_file.close();
+    m_levels.clear();
+    m_tileShift = 0;
+    m_tileMask = 0;
+}
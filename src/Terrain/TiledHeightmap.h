@@ -0,0 +1,98 @@
+/**
+ * @file TiledHeightmap.h
+ * @brief Tiled 16-bit heightmap file with a mip pyramid, read through a memory mapping
+ * @author LuNingfang
+ */
+
+#ifndef TILED_HEIGHTMAP_H
+#define TILED_HEIGHTMAP_H
+
+#include "Core/MappedFile.h"
+#include "Core/ThreadPool.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * File layout (.rhm, little-endian):
+ *   Header
+ *   LevelEntry[levelCount]        level 0 is full resolution
+ *   TileEntry[sum of tile counts] row-major tiles of each level in turn
+ *   tile data                     tileSize^2 uint16 samples per tile, edge tiles padded by clamping
+ *
+ * Mip texel i of level L lies on level 0 texel i * 2^L, so coarse levels line up with the vertex grid.
+ */
+class TiledHeightmap
+{
+public:
+    static const uint32_t VERSION = 1;
+    static const int DEFAULT_TILE_SIZE = 256;
+
+    struct Header
+    {
+        char magic[4];          // "RHMT"
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t tileSize;      // power of two
+        uint32_t levelCount;
+        uint64_t levelOffset;   // LevelEntry array
+        uint64_t indexOffset;   // TileEntry array
+    };
+
+    struct LevelEntry
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t tilesX;
+        uint32_t tilesZ;
+        uint64_t firstTile;     // into the tile index
+    };
+
+    struct TileEntry
+    {
+        uint64_t offset;        // byte offset of the tile samples
+    };
+
+    TiledHeightmap();
+
+    /**
+     * @brief Write a tiled file from row-major 16-bit samples; mips and tiles are built on the workers
+     */
+    static bool write(const std::string& path, const std::vector<uint16_t>& samples, int width, int height,
+                      int tileSize = DEFAULT_TILE_SIZE, ThreadPool* workers = nullptr);
+
+    // Map an existing file; samples are read in place, never copied
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+    int getWidth(int level = 0) const { return static_cast<int>(m_levels[level].width); }
+    int getHeight(int level = 0) const { return static_cast<int>(m_levels[level].height); }
+    int getLevelCount() const { return static_cast<int>(m_levels.size()); }
+    int getTileSize() const { return 1 << m_tileShift; }
+
+    // Coordinates must be in range for the level
+    uint16_t getSample(int level, int x, int z) const
+    {
+        const Level& l = m_levels[level];
+        const uint16_t* tile = l.tiles[(z >> m_tileShift) * l.tilesX + (x >> m_tileShift)];
+        return tile[((z & m_tileMask) << m_tileShift) + (x & m_tileMask)];
+    }
+
+private:
+    struct Level
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t tilesX;
+        std::vector<const uint16_t*> tiles;     // into the mapping
+    };
+
+    MappedFile m_file;
+    std::vector<Level> m_levels;
+    int m_tileShift;
+    int m_tileMask;
+};
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file HeightmapFixture.h
+ * @brief Writes generated heightmaps for the tools, so every run sees the same terrain
+ * @author LuNingfang
+ */
+
+#ifndef TOOLS_HEIGHTMAP_FIXTURE_H
+#define TOOLS_HEIGHTMAP_FIXTURE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Write a size x size RAW16 heightmap (headerless, loaded by extension as .r16)
+ * @param height Called as height(u, v, x, z) with u, v in [0, 1] across the map and x, z the
+ *        texel; the result is clamped to [0, 1]
+ */
+template <typename HeightFunction>
+bool writeHeightmapFixture(const std::string& path, int size, HeightFunction height)
+{
+    std::vector<uint16_t> samples(static_cast<size_t>(size) * size);
+    for (int z = 0; z < size; z++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            float u = static_cast<float>(x) / (size - 1);
+            float v = static_cast<float>(z) / (size - 1);
+            float h = std::max(0.0f, std::min(height(u, v, x, z), 1.0f));
+            samples[static_cast<size_t>(z) * size + x] = static_cast<uint16_t>(std::lround(h * 65535.0f));
+        }
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    size_t written = std::fwrite(samples.data(), sizeof(uint16_t), samples.size(), file);
+    std::fclose(file);
+    return written == samples.size();
+}
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * @file main.cpp
+ * @brief Micro-benchmark of chunk frustum culling: per-chunk Frustum tests vs SoA batches, and
+ *        the rejecting-plane cache under a smoothly moving camera
+ * @author LuNingfang
+ */
+
+#include "Terrain/Frustum.h"
+#include "Terrain/TerrainChunkBounds.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const float CHUNK_WIDTH = 64.0f;
+    const float MAX_HEIGHT = 400.0f;
+    const int VIEW_COUNT = 16;
+    const int PATH_FRAMES = 240;    // a slow turn and walk, as the fly camera produces
+    const size_t CHUNK_BYTES = 672; // sizeof(TerrainChunk) in an x64 build
+
+    // The old loop's access pattern: six floats read out of an object the size of TerrainChunk
+    struct ChunkRecord
+    {
+        unsigned char payload[CHUNK_BYTES - 3 * sizeof(glm::vec3)];
+        glm::vec3 min;
+        glm::vec3 max;
+        glm::vec3 center;
+    };
+
+    struct Scene
+    {
+        std::vector<ChunkRecord> records;
+        TerrainChunkBounds bounds;
+        Frustum views[VIEW_COUNT];
+        Frustum path[PATH_FRAMES];
+    };
+
+    // side x side grid of chunks with random heights, viewed from random points inside it
+    void buildScene(int side, Scene& scene)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        size_t count = static_cast<size_t>(side) * side;
+        scene.records.resize(count);
+        scene.bounds.resize(count, side);
+        float half = side * CHUNK_WIDTH * 0.5f;
+        for (size_t i = 0; i < count; i++)
+        {
+            float x = (i % side) * CHUNK_WIDTH - half;
+            float z = (i / side) * CHUNK_WIDTH - half;
+            float low = unit(random) * MAX_HEIGHT * 0.5f;
+            float high = low + unit(random) * MAX_HEIGHT * 0.5f;
+
+            ChunkRecord& record = scene.records[i];
+            record.min = glm::vec3(x, low, z);
+            record.max = glm::vec3(x + CHUNK_WIDTH, high, z + CHUNK_WIDTH);
+            record.center = (record.min + record.max) * 0.5f;
+            scene.bounds.set(i, record.min, record.max);
+        }
+
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.5f, half * 2.0f);
+        for (Frustum& view : scene.views)
+        {
+            glm::vec3 eye((unit(random) - 0.5f) * half, MAX_HEIGHT * 0.6f, (unit(random) - 0.5f) * half);
+            float yaw = unit(random) * 6.2831853f;
+            glm::vec3 target = eye + glm::vec3(std::cos(yaw), -0.2f, std::sin(yaw));
+            view.update(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+        }
+
+        // Half a degree of yaw and a few units forward per frame
+        for (int frame = 0; frame < PATH_FRAMES; frame++)
+        {
+            float yaw = frame * 0.0087f;
+            glm::vec3 forward(std::cos(yaw), -0.2f, std::sin(yaw));
+            glm::vec3 eye = glm::vec3(0.0f, MAX_HEIGHT * 0.6f, 0.0f) + glm::vec3(forward.x, 0.0f, forward.z) * (frame * 2.0f);
+            scene.path[frame].update(projection * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        }
+    }
+
+    size_t cullRecords(const std::vector<ChunkRecord>& records, const Frustum& frustum, std::vector<uint8_t>& visible)
+    {
+        visible.assign((records.size() + 7) / 8, 0);
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            if (frustum.isBoxVisible(records[i].min, records[i].max))
+            {
+                visible[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+                visibleCount++;
+            }
+        }
+        return visibleCount;
+    }
+
+    // Average nanoseconds per chunk over views 0..views-1, repeated until about 0.2 s have passed
+    template <typename Cull>
+    double measure(size_t count, Cull cull, int views = VIEW_COUNT)
+    {
+        using Clock = std::chrono::steady_clock;
+        size_t culled = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        do
+        {
+            for (int view = 0; view < views; view++)
+            {
+                cull(view);
+                culled += count;
+            }
+            elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        } while (elapsed < 2e8);
+        return elapsed / static_cast<double>(culled);
+    }
+}
+
+int main()
+{
+    using Path = TerrainChunkBounds::Path;
+    std::cout << "Chunk frustum culling, " << VIEW_COUNT << " views, best path "
+              << TerrainChunkBounds::getPathName(TerrainChunkBounds::getBestPath()) << "\n"
+              << "  ns per chunk; AoS records are " << sizeof(ChunkRecord) << " bytes" << std::endl;
+
+    const Path paths[] = { Path::Scalar, Path::SSE2, Path::AVX2 };
+    int mismatches = 0;
+    for (int side : { 32, 128, 256 })
+    {
+        Scene scene;
+        buildScene(side, scene);
+        size_t count = scene.records.size();
+
+        // Every path must agree with Frustum::isBoxVisible bit for bit
+        std::vector<uint8_t> expected, visible;
+        size_t visibleTotal = 0;
+        for (const Frustum& view : scene.views)
+        {
+            visibleTotal += cullRecords(scene.records, view, expected);
+            for (Path path : paths)
+            {
+                scene.bounds.cull(view, visible, path);
+                if (visible != expected) mismatches++;
+            }
+        }
+
+        double perChunk = measure(count, [&](int view) { cullRecords(scene.records, scene.views[view], visible); });
+        std::printf("%6zu chunks (%4.1f%% visible): per-chunk AoS %6.2f", count,
+                    100.0 * visibleTotal / (static_cast<double>(count) * VIEW_COUNT), perChunk);
+        for (Path path : paths)
+        {
+            if (path > TerrainChunkBounds::getBestPath()) continue;
+            double batch = measure(count, [&](int view) { scene.bounds.cull(scene.views[view], visible, path); });
+            std::printf(" | %s %5.2f (%4.1fx)", TerrainChunkBounds::getPathName(path), batch, perChunk / batch);
+        }
+        std::printf("\n");
+
+        // Smooth camera path, as the fly camera produces: the blocks decide most chunks, so the
+        // SIMD kernels see only the planes of the blocks that cross the frustum
+        Path best = TerrainChunkBounds::getBestPath();
+        size_t tests = 0;
+        for (const Frustum& view : scene.path)
+        {
+            cullRecords(scene.records, view, expected);
+            for (Path path : paths)
+            {
+                scene.bounds.cull(view, visible, path);
+                if (visible != expected) mismatches++;
+            }
+            tests += scene.bounds.getPlaneTests();
+        }
+
+        double moving = measure(count, [&](int frame) { scene.bounds.cull(scene.path[frame], visible, best); }, PATH_FRAMES);
+        std::printf("       moving camera, %s: %.2f plane tests per chunk (up to 6 without blocks), %5.2f ns\n",
+                    TerrainChunkBounds::getPathName(best), tests / (static_cast<double>(count) * PATH_FRAMES), moving);
+    }
+
+    if (mismatches > 0)
+    {
+        std::cerr << "ERROR::CULLING_BENCHMARK::MISMATCH: " << mismatches << " masks differ from Frustum::isBoxVisible" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file main.cpp
+ * @brief Renders generated terrains from scripted views with the GPU culler (verified against the
+ *        CPU path) and without it, and fails on any draw or pixel difference
+ * @author LuNingfang
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "Core/Shader.h"
+#include "Terrain/ChunkedTerrain.h"
+#include "../Common/HeightmapFixture.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const int VIEWPORT_WIDTH = 320;
+    const int VIEWPORT_HEIGHT = 180;
+    const float FOV_Y = 0.8f;
+    const float TERRAIN_SIZE = 1024.0f;
+    const float MAX_HEIGHT = 120.0f;
+    const int VIEWS = 40;
+    const int SCULPT_EVERY = 5;     // every fifth view also sculpts both terrains
+
+    struct CheckConfig
+    {
+        const char* name;
+        TerrainSeamMode seamMode;
+        bool screenSpaceError;
+        bool lod;
+        bool frustumCulling;
+        bool packedVertices;
+        int chunkSize;
+        int mapSize;
+    };
+
+    // Every option the culling shader branches on, plus 32-bit indices and a partial last chunk
+    const CheckConfig CONFIGS[] =
+    {
+        { "stitch/sse",   TerrainSeamMode::Stitch, true,  true,  true,  false, 64,  1025 },
+        { "skirt/sse",    TerrainSeamMode::Skirt,  true,  true,  true,  false, 64,  1025 },
+        { "none/dist",    TerrainSeamMode::None,   false, true,  true,  false, 64,  1025 },
+        { "stitch/dist",  TerrainSeamMode::Stitch, false, true,  true,  true,  32,  1025 },
+        { "no lod",       TerrainSeamMode::Stitch, true,  false, true,  false, 64,  1025 },
+        { "no frustum",   TerrainSeamMode::Stitch, true,  true,  false, false, 64,  1025 },
+        { "32-bit index", TerrainSeamMode::Stitch, true,  true,  true,  false, 256, 1000 },
+        { "partial/skirt", TerrainSeamMode::Skirt, true,  true,  true,  false, 64,  700 },
+    };
+
+    // Broad hills and valleys, so views look both over ridges and down onto slopes
+    float hillsAndValleys(float u, float v, int, int)
+    {
+        return 0.4f + 0.3f * std::sin(u * 9.0f) * std::cos(v * 7.0f) + 0.1f * std::sin((u + v) * 41.0f);
+    }
+
+    // GL 4.5 core context on a window that is never shown
+    GLFWwindow* createHiddenContext()
+    {
+        if (!glfwInit())
+        {
+            std::cerr << "ERROR::GLFW::INIT_FAILED" << std::endl;
+            return nullptr;
+        }
+
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        GLFWwindow* window = glfwCreateWindow(VIEWPORT_WIDTH, VIEWPORT_HEIGHT, "GPUCullingCheck", nullptr, nullptr);
+        if (!window)
+        {
+            std::cerr << "ERROR::GLFW::WINDOW_CREATION_FAILED" << std::endl;
+            glfwTerminate();
+            return nullptr;
+        }
+        glfwMakeContextCurrent(window);
+
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cerr << "ERROR::GLAD::INIT_FAILED" << std::endl;
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return nullptr;
+        }
+        return window;
+    }
+
+    // Off-screen target, so the result does not depend on the hidden window's default framebuffer
+    struct RenderTarget
+    {
+        GLuint framebuffer = 0;
+        GLuint renderbuffers[2] = { 0, 0 };
+
+        bool create()
+        {
+            glGenFramebuffers(1, &framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glGenRenderbuffers(2, renderbuffers);
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+            glViewport(0, 0, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+            return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+
+        void destroy()
+        {
+            glDeleteRenderbuffers(2, renderbuffers);
+            glDeleteFramebuffers(1, &framebuffer);
+        }
+    };
+
+    // The terrain uniforms RoamingApp sets, with fixed lighting and no textures
+    std::vector<unsigned char> renderView(ChunkedTerrain& terrain, Shader& shader, const glm::vec3& cameraPos,
+                                          const glm::mat4& projection, const glm::mat4& view)
+    {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use();
+        shader.setMat4("uProjection", projection);
+        shader.setMat4("uView", view);
+        shader.setMat4("uModel", glm::mat4(1.0f));
+        shader.setVec4("uClipPlane", glm::vec4(0.0f, 1.0f, 0.0f, 100000.0f));
+        shader.setFloat("uMaxHeight", terrain.getMaxHeight());
+        shader.setBool("uUseTextures", false);
+        shader.setVec3("uLightDir", glm::vec3(-0.3f, -1.0f, -0.2f));
+        shader.setVec3("uLightColor", glm::vec3(1.0f));
+        shader.setVec3("uAmbientColor", glm::vec3(0.3f));
+        shader.setFloat("uLightIntensity", 1.0f);
+        shader.setVec3("uCameraPos", cameraPos);
+        shader.setFloat("uGrassMaxHeight", 0.3f);
+        shader.setFloat("uRockMaxHeight", 0.7f);
+        shader.setFloat("uSlopeThreshold", 0.5f);
+        terrain.render(shader, cameraPos, projection * view);
+
+        std::vector<unsigned char> pixels(static_cast<size_t>(VIEWPORT_WIDTH) * VIEWPORT_HEIGHT * 4);
+        glReadPixels(0, 0, VIEWPORT_WIDTH, VIEWPORT_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        return pixels;
+    }
+
+    // Returns the number of failed views, or -1 if the terrains could not be set up
+    int checkConfig(const CheckConfig& config, const std::string& heightmapPath, Shader& shader)
+    {
+        ChunkedTerrain cpuTerrain, gpuTerrain;
+        ChunkedTerrain* terrains[] = { &cpuTerrain, &gpuTerrain };
+        for (ChunkedTerrain* terrain : terrains)
+        {
+            terrain->m_enableMeshCache = false;
+            terrain->m_seamMode = config.seamMode;
+            terrain->m_useScreenSpaceError = config.screenSpaceError;
+            terrain->m_enableLOD = config.lod;
+            terrain->m_enableFrustumCulling = config.frustumCulling;
+            terrain->m_usePackedVertices = config.packedVertices;
+            terrain->setViewParameters(FOV_Y, VIEWPORT_HEIGHT);
+            if (!terrain->generate(heightmapPath, TERRAIN_SIZE, MAX_HEIGHT, config.chunkSize)) return -1;
+        }
+        gpuTerrain.m_enableGPUCulling = true;
+        gpuTerrain.m_verifyGPUCulling = true;
+
+        // Views from low over the ground to well above it, looking anywhere on the map
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> coordinate(-TERRAIN_SIZE * 0.5f, TERRAIN_SIZE * 0.5f);
+        glm::mat4 projection = glm::perspective(FOV_Y, static_cast<float>(VIEWPORT_WIDTH) / VIEWPORT_HEIGHT, 0.5f, 3000.0f);
+
+        int failedViews = 0, pixelViews = 0, notCulled = 0;
+        long visibleChunks = 0, drawCalls = 0;
+        for (int i = 0; i < VIEWS; i++)
+        {
+            glm::vec3 cameraPos(coordinate(random), 20.0f + std::fabs(coordinate(random)) * 0.3f, coordinate(random));
+            glm::vec3 target(coordinate(random), 0.0f, coordinate(random));
+            glm::mat4 view = glm::lookAt(cameraPos, target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+            // Sculpting re-uploads the culler's chunk bounds, which the next view must pick up
+            if (i % SCULPT_EVERY == SCULPT_EVERY - 1)
+            {
+                TerrainBrush brush;
+                brush.radius = 40.0f;
+                brush.strength = 40.0f;
+                glm::vec3 center(coordinate(random), 0.0f, coordinate(random));
+                cpuTerrain.sculpt(center, brush, 0.2f);
+                gpuTerrain.sculpt(center, brush, 0.2f);
+            }
+
+            cpuTerrain.update();
+            gpuTerrain.update();
+            int mismatchesBefore = gpuTerrain.getGPUCullingMismatches();
+            std::vector<unsigned char> expected = renderView(cpuTerrain, shader, cameraPos, projection, view);
+            std::vector<unsigned char> actual = renderView(gpuTerrain, shader, cameraPos, projection, view);
+
+            bool culledOnGPU = gpuTerrain.isGPUCulling();
+            bool drawsDiffer = gpuTerrain.getGPUCullingMismatches() != mismatchesBefore;
+            bool pixelsDiffer = expected != actual;
+            notCulled += culledOnGPU ? 0 : 1;
+            pixelViews += pixelsDiffer ? 1 : 0;
+            failedViews += (!culledOnGPU || drawsDiffer || pixelsDiffer) ? 1 : 0;
+            visibleChunks += gpuTerrain.getVisibleChunks();
+            drawCalls += gpuTerrain.getDrawCalls();
+        }
+
+        std::printf("%-13s %4d chunks, %d views: draw mismatches %d, pixel-different views %d, CPU-culled views %d"
+                    " | avg visible %ld, draw calls %.1f%s\n",
+                    config.name, gpuTerrain.getTotalChunks(), VIEWS, gpuTerrain.getGPUCullingMismatches(), pixelViews,
+                    notCulled, visibleChunks / VIEWS, static_cast<double>(drawCalls) / VIEWS,
+                    failedViews > 0 ? "  MISMATCH" : "");
+        return failedViews;
+    }
+}
+
+int main()
+{
+    GLFWwindow* window = createHiddenContext();
+    if (!window) return EXIT_FAILURE;
+    std::printf("GL %s / %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+
+    // Shaders are loaded relative to the working directory, as in the application
+    int failures = 0;
+    bool setUp = false;
+    {
+        RenderTarget target;
+        Shader shader;
+        if (target.create() && shader.load("shaders/terrain.vert", "shaders/terrain.frag"))
+        {
+            setUp = true;
+            glEnable(GL_DEPTH_TEST);
+
+            for (const CheckConfig& config : CONFIGS)
+            {
+                std::string path = "gpu_culling_check_" + std::to_string(config.mapSize) + ".r16";
+                if (!writeHeightmapFixture(path, config.mapSize, hillsAndValleys))
+                {
+                    std::cerr << "ERROR::GPU_CULLING_CHECK::FAILED_TO_WRITE: " << path << std::endl;
+                    setUp = false;
+                    break;
+                }
+                int failed = checkConfig(config, path, shader);
+                std::remove(path.c_str());
+                if (failed < 0)
+                {
+                    setUp = false;
+                    break;
+                }
+                failures += failed;
+            }
+        }
+        target.destroy();
+    }
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    if (!setUp)
+    {
+        std::cerr << "ERROR::GPU_CULLING_CHECK::SETUP_FAILED: run from the repository root so shaders/ is found" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (failures > 0)
+    {
+        std::cerr << "ERROR::GPU_CULLING_CHECK::MISMATCH: " << failures << " views differ from the CPU path" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file main.cpp
+ * @brief Offline converter from PNG / RAW16 heightmaps to the tiled .rhm format
+ * @author LuNingfang
+ */
+
+#include "Terrain/TiledHeightmap.h"
+#include "Core/ThreadPool.h"
+#include <stb_image.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: HeightmapConverter <input.png|input.raw> <output.rhm> [options]\n"
+                  << "  --size WxH   dimensions of a .raw input (little-endian 16-bit samples)\n"
+                  << "  --tile N     tile size, a power of two >= 16 (default "
+                  << TiledHeightmap::DEFAULT_TILE_SIZE << ")" << std::endl;
+    }
+
+    bool hasExtension(const std::string& path, const char* extension)
+    {
+        size_t length = std::strlen(extension);
+        return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+    }
+
+    // 8-bit images are widened to 16 bits so every input ends up on the same scale
+    bool loadImage(const std::string& path, std::vector<uint16_t>& samples, int& width, int& height)
+    {
+        int channels;
+        stbi_us* data = stbi_load_16(path.c_str(), &width, &height, &channels, 1);
+        if (!data)
+        {
+            std::cerr << "ERROR::HEIGHTMAP_CONVERTER::FAILED_TO_LOAD: " << path << std::endl;
+            return false;
+        }
+        samples.assign(data, data + static_cast<size_t>(width) * height);
+        stbi_image_free(data);
+        return true;
+    }
+
+    bool loadRaw16(const std::string& path, std::vector<uint16_t>& samples, int width, int height)
+    {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            std::cerr << "ERROR::HEIGHTMAP_CONVERTER::FAILED_TO_LOAD: " << path << std::endl;
+            return false;
+        }
+
+        samples.resize(static_cast<size_t>(width) * height);
+        size_t read = std::fread(samples.data(), sizeof(uint16_t), samples.size(), file);
+        std::fclose(file);
+        if (read != samples.size())
+        {
+            std::cerr << "ERROR::HEIGHTMAP_CONVERTER::RAW_SIZE_MISMATCH: expected "
+                      << samples.size() << " samples, read " << read << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::string input = argv[1];
+    std::string output = argv[2];
+    int width = 0;
+    int height = 0;
+    int tileSize = TiledHeightmap::DEFAULT_TILE_SIZE;
+
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--size") == 0)
+        {
+            std::sscanf(argv[i + 1], "%dx%d", &width, &height);
+        }
+        else if (std::strcmp(argv[i], "--tile") == 0)
+        {
+            tileSize = std::atoi(argv[i + 1]);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint16_t> samples;
+    bool loaded;
+    if (hasExtension(input, ".raw") || hasExtension(input, ".r16"))
+    {
+        if (width <= 0 || height <= 0)
+        {
+            std::cerr << "ERROR::HEIGHTMAP_CONVERTER::RAW_NEEDS_SIZE" << std::endl;
+            printUsage();
+            return 1;
+        }
+        loaded = loadRaw16(input, samples, width, height);
+    }
+    else
+    {
+        loaded = loadImage(input, samples, width, height);
+    }
+    if (!loaded) return 1;
+
+    ThreadPool workers;
+    if (!TiledHeightmap::write(output, samples, width, height, tileSize, &workers))
+    {
+        return 1;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Converted " << input << " (" << width << "x" << height << ") -> " << output
+              << " in " << ms << " ms (" << workers.getConcurrency() << " threads)" << std::endl;
+    return 0;
+}
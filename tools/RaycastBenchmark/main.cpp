@@ -0,0 +1,250 @@
+/**
+ * @file main.cpp
+ * @brief Checks TerrainRaycast against brute force over every cell and times it against a
+ *        fixed-step ray march, on generated heightmaps so every run sees the same rays
+ * @author LuNingfang
+ */
+
+#include "Terrain/HeightmapLoader.h"
+#include "Terrain/TerrainRaycast.h"
+#include "../Common/HeightmapFixture.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const int CHECK_SIZE = 257;     // small enough to test every cell for every ray
+    const int CHECK_RAYS = 1000;
+    const int TIMING_SIZE = 4097;
+    const int TIMING_RAYS = 20000;
+    const float MAX_HEIGHT = 200.0f;
+    const float CELL_SIZE = 1.0f;
+    const float EPSILON = 1e-7f;
+    const float DISTANCE_TOLERANCE = 1e-3f;
+
+    // Rolling hills plus one-texel ridges every 97 texels, which a half-cell march can step over
+    float ridgedHills(float u, float v, int x, int)
+    {
+        float h = 0.45f + 0.2f * std::sin(u * 17.0f) * std::cos(v * 13.0f) + 0.1f * std::sin((u + v) * 61.0f);
+        return x % 97 == 0 ? h + 0.2f : h;
+    }
+
+    struct RaySet
+    {
+        std::vector<glm::vec3> origins;
+        std::vector<glm::vec3> directions;
+    };
+
+    // Steep, grazing, shallow and rising rays from above and beside the map, from a fixed seed
+    void makeRays(float terrainSize, int count, RaySet& rays)
+    {
+        std::mt19937 random(4321);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float half = terrainSize * 0.5f;
+
+        rays.origins.resize(count);
+        rays.directions.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            glm::vec3 origin((unit(random) - 0.5f) * 2.4f * half, MAX_HEIGHT * (0.3f + unit(random)),
+                             (unit(random) - 0.5f) * 2.4f * half);
+            float angle = unit(random) * 6.2831853f;
+            glm::vec3 direction;
+            switch (i % 4)
+            {
+            case 0:  direction = glm::vec3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f); break;
+            case 1:  direction = glm::vec3(std::cos(angle), -0.02f - 0.08f * unit(random), std::sin(angle)); break;
+            case 2:  direction = glm::vec3(std::cos(angle), -0.3f * unit(random), std::sin(angle)); break;
+            default: direction = glm::vec3(std::cos(angle), 0.2f * unit(random), std::sin(angle)); break;
+            }
+            rays.origins[i] = origin;
+            rays.directions[i] = direction;
+        }
+    }
+
+    // Same test as TerrainRaycast, so agreeing rays agree to the last bit or close to it
+    bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+                           const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& tBest)
+    {
+        glm::vec3 e1 = b - a;
+        glm::vec3 e2 = c - a;
+        glm::vec3 p = glm::cross(direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < EPSILON) return false;
+
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        float t = glm::dot(e2, q) * invDet;
+        if (t < 0.0f || t >= tBest) return false;
+
+        tBest = t;
+        return true;
+    }
+
+    // Both LOD 0 triangles of every cell, split like TerrainIndexCache::buildGridIndices
+    bool castEveryCell(const HeightmapLoader& heightmap, float terrainSize, const glm::vec3& origin,
+                       const glm::vec3& direction, float maxDistance, float& distance)
+    {
+        float half = terrainSize * 0.5f;
+        float heightScale = MAX_HEIGHT / CELL_SIZE;
+        glm::vec3 gridOrigin = glm::vec3(origin.x + half, origin.y, origin.z + half) / CELL_SIZE;
+        glm::vec3 gridDirection = direction / (glm::length(direction) * CELL_SIZE);
+
+        float tBest = maxDistance;
+        bool found = false;
+        for (int z = 0; z + 1 < heightmap.getGridHeight(); z++)
+        {
+            for (int x = 0; x + 1 < heightmap.getWidth(); x++)
+            {
+                glm::vec3 topLeft(x, heightmap.getHeight(x, z) * heightScale, z);
+                glm::vec3 topRight(x + 1, heightmap.getHeight(x + 1, z) * heightScale, z);
+                glm::vec3 bottomLeft(x, heightmap.getHeight(x, z + 1) * heightScale, z + 1);
+                glm::vec3 bottomRight(x + 1, heightmap.getHeight(x + 1, z + 1) * heightScale, z + 1);
+                found |= intersectTriangle(gridOrigin, gridDirection, topLeft, bottomLeft, topRight, tBest);
+                found |= intersectTriangle(gridOrigin, gridDirection, topRight, bottomLeft, bottomRight, tBest);
+            }
+        }
+        distance = tBest;
+        return found;
+    }
+
+    // The usual brute-force ray march: getHeightInterpolated every half cell, then bisection
+    bool castMarch(const HeightmapLoader& heightmap, float terrainSize, const glm::vec3& origin,
+                   const glm::vec3& direction, float maxDistance, float& distance)
+    {
+        float half = terrainSize * 0.5f;
+        glm::vec3 unitDirection = glm::normalize(direction);
+        float step = CELL_SIZE * 0.5f;
+        auto above = [&](float t)
+        {
+            glm::vec3 p = origin + unitDirection * t;
+            float x = (p.x + half) / CELL_SIZE;
+            float z = (p.z + half) / CELL_SIZE;
+            if (x < 0.0f || z < 0.0f || x > heightmap.getWidth() - 1 || z > heightmap.getGridHeight() - 1) return true;
+            return p.y > heightmap.getHeightInterpolated(x, z) * MAX_HEIGHT;
+        };
+
+        if (!above(0.0f)) return false;
+        for (float t = step; t <= maxDistance; t += step)
+        {
+            if (above(t)) continue;
+
+            float low = t - step, high = t;
+            for (int i = 0; i < 16; i++)
+            {
+                float middle = (low + high) * 0.5f;
+                if (above(middle)) low = middle;
+                else high = middle;
+            }
+            distance = high;
+            return true;
+        }
+        return false;
+    }
+
+    bool loadGenerated(HeightmapLoader& heightmap, const std::string& path, int size)
+    {
+        if (!writeHeightmapFixture(path, size, ridgedHills))
+        {
+            std::cerr << "ERROR::RAYCAST_BENCHMARK::FAILED_TO_WRITE: " << path << std::endl;
+            return false;
+        }
+        bool loaded = heightmap.load(path);
+        std::remove(path.c_str());
+        return loaded;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Exactness: the pyramid walk must find the same nearest triangle as testing all of them
+    HeightmapLoader small;
+    if (!loadGenerated(small, "raycast_check.r16", CHECK_SIZE)) return EXIT_FAILURE;
+    float smallSize = (CHECK_SIZE - 1) * CELL_SIZE;
+    RaySet checkRays;
+    makeRays(smallSize, CHECK_RAYS, checkRays);
+
+    TerrainRaycast smallCaster(small, smallSize, MAX_HEIGHT);
+    int mismatches = 0, hits = 0;
+    for (int i = 0; i < CHECK_RAYS; i++)
+    {
+        TerrainRayHit hit;
+        float expected = 0.0f;
+        bool fast = smallCaster.cast(checkRays.origins[i], checkRays.directions[i], smallSize * 2.0f, hit);
+        bool slow = castEveryCell(small, smallSize, checkRays.origins[i], checkRays.directions[i], smallSize * 2.0f, expected);
+        if (fast != slow || (fast && std::fabs(hit.distance - expected) > DISTANCE_TOLERANCE))
+        {
+            if (mismatches < 8)
+            {
+                std::printf("  mismatch ray %d: pyramid %s %.4f, every cell %s %.4f\n", i,
+                            fast ? "hit" : "miss", fast ? hit.distance : 0.0f, slow ? "hit" : "miss", expected);
+            }
+            mismatches++;
+        }
+        hits += fast ? 1 : 0;
+    }
+    std::printf("%dx%d map, %d rays (%d hit): %d differ from the every-cell test\n",
+                CHECK_SIZE, CHECK_SIZE, CHECK_RAYS, hits, mismatches);
+
+    // Speed against the march on a large map (or the one given on the command line)
+    HeightmapLoader large;
+    bool loaded = argc > 1 ? large.load(argv[1]) : loadGenerated(large, "raycast_timing.r16", TIMING_SIZE);
+    if (!loaded) return EXIT_FAILURE;
+    float largeSize = (large.getWidth() - 1) * CELL_SIZE;
+    RaySet timingRays;
+    makeRays(largeSize, TIMING_RAYS, timingRays);
+
+    TerrainRaycast largeCaster(large, largeSize, MAX_HEIGHT);
+    std::vector<float> pyramidDistances(TIMING_RAYS, -1.0f), marchDistances(TIMING_RAYS, -1.0f);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < TIMING_RAYS; i++)
+    {
+        TerrainRayHit hit;
+        if (largeCaster.cast(timingRays.origins[i], timingRays.directions[i], largeSize * 2.0f, hit))
+        {
+            pyramidDistances[i] = hit.distance;
+        }
+    }
+    double pyramidUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / TIMING_RAYS;
+
+    start = Clock::now();
+    for (int i = 0; i < TIMING_RAYS; i++)
+    {
+        castMarch(large, largeSize, timingRays.origins[i], timingRays.directions[i], largeSize * 2.0f, marchDistances[i]);
+    }
+    double marchUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / TIMING_RAYS;
+
+    // The march samples bilinear heights, not the triangles, so only gross differences count
+    int marchMissed = 0, marchFar = 0;
+    for (int i = 0; i < TIMING_RAYS; i++)
+    {
+        if (pyramidDistances[i] < 0.0f) continue;
+        if (marchDistances[i] < 0.0f) marchMissed++;
+        else if (std::fabs(marchDistances[i] - pyramidDistances[i]) > CELL_SIZE) marchFar++;
+    }
+    std::printf("%dx%d map, %d rays: pyramid %.2f us/ray, half-cell march %.2f us/ray (%.1fx)\n",
+                large.getWidth(), large.getGridHeight(), TIMING_RAYS, pyramidUs, marchUs, marchUs / pyramidUs);
+    std::printf("  the march missed %d pyramid hits and was more than a cell off on %d\n", marchMissed, marchFar);
+
+    if (mismatches > 0)
+    {
+        std::cerr << "ERROR::RAYCAST_BENCHMARK::MISMATCH: " << mismatches << " rays differ from the every-cell test" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
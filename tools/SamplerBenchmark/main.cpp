@@ -0,0 +1,131 @@
+/**
+ * @file main.cpp
+ * @brief Checks the batched TerrainSampler against per-point sampling and times both, for each
+ *        height storage type, on a generated heightmap
+ * @author LuNingfang
+ */
+
+#include "Terrain/HeightmapLoader.h"
+#include "Terrain/TerrainSampler.h"
+#include "../Common/HeightmapFixture.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const int MAP_SIZE = 2049;
+    const size_t POINT_COUNT = 1 << 20;
+    const float TERRAIN_SIZE = 2048.0f;
+    const float MAX_HEIGHT = 200.0f;
+    const float HEIGHT_TOLERANCE = 1e-3f;  // world units; the paths round differently, not more
+    const float NORMAL_TOLERANCE = 1e-4f;
+
+    float rollingHills(float u, float v, int, int)
+    {
+        return 0.5f + 0.25f * std::sin(u * 23.0f) * std::cos(v * 19.0f) + 0.1f * std::sin((u - v) * 97.0f);
+    }
+
+    // What ChunkedTerrain::getHeightAt does for one point
+    float heightAt(const HeightmapLoader& heightmap, float worldX, float worldZ)
+    {
+        float halfSize = TERRAIN_SIZE * 0.5f;
+        float pixelX = (worldX + halfSize) / TERRAIN_SIZE * static_cast<float>(heightmap.getWidth() - 1);
+        float pixelZ = (worldZ + halfSize) / TERRAIN_SIZE * static_cast<float>(heightmap.getGridHeight() - 1);
+        return heightmap.getHeightInterpolated(pixelX, pixelZ) * MAX_HEIGHT;
+    }
+
+    template <typename Function>
+    double measureMs(Function function)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main()
+{
+    const std::string path = "sampler_benchmark.r16";
+    if (!writeHeightmapFixture(path, MAP_SIZE, rollingHills))
+    {
+        std::cerr << "ERROR::SAMPLER_BENCHMARK::FAILED_TO_WRITE: " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Random points, a few percent of them off the map to exercise the clamping
+    std::mt19937 random(2024);
+    std::uniform_real_distribution<float> coordinate(-TERRAIN_SIZE * 0.52f, TERRAIN_SIZE * 0.52f);
+    std::vector<float> xs(POINT_COUNT), zs(POINT_COUNT);
+    for (size_t i = 0; i < POINT_COUNT; i++)
+    {
+        xs[i] = coordinate(random);
+        zs[i] = coordinate(random);
+    }
+
+    std::vector<float> expected(POINT_COUNT), scalarHeights(POINT_COUNT), batchHeights(POINT_COUNT);
+    std::vector<glm::vec3> scalarNormals(POINT_COUNT), batchNormals(POINT_COUNT);
+    int failures = 0;
+
+    std::printf("%zu random points on a %dx%d map, ms\n", POINT_COUNT, MAP_SIZE, MAP_SIZE);
+    const HeightStorage storages[] = { HeightStorage::UInt8, HeightStorage::UInt16, HeightStorage::Float };
+    for (HeightStorage storage : storages)
+    {
+        HeightmapLoader heightmap;
+        heightmap.setStorage(storage);
+        if (!heightmap.load(path))
+        {
+            std::remove(path.c_str());
+            return EXIT_FAILURE;
+        }
+
+        TerrainSampler scalar(heightmap, TERRAIN_SIZE, MAX_HEIGHT, false);
+        TerrainSampler batch(heightmap, TERRAIN_SIZE, MAX_HEIGHT, true);
+
+        double perPointMs = measureMs([&]()
+        {
+            for (size_t i = 0; i < POINT_COUNT; i++) expected[i] = heightAt(heightmap, xs[i], zs[i]);
+        });
+        double scalarMs = measureMs([&]() { scalar.sample(xs.data(), zs.data(), POINT_COUNT, scalarHeights.data()); });
+        double batchMs = measureMs([&]() { batch.sample(xs.data(), zs.data(), POINT_COUNT, batchHeights.data()); });
+        double scalarNormalMs = measureMs([&]()
+        {
+            scalar.sample(xs.data(), zs.data(), POINT_COUNT, scalarHeights.data(), scalarNormals.data());
+        });
+        double batchNormalMs = measureMs([&]()
+        {
+            batch.sample(xs.data(), zs.data(), POINT_COUNT, batchHeights.data(), batchNormals.data());
+        });
+
+        // Heights against the per-point path, normals between the two batched paths
+        float heightError = 0.0f, normalError = 0.0f;
+        for (size_t i = 0; i < POINT_COUNT; i++)
+        {
+            heightError = std::max(heightError, std::fabs(scalarHeights[i] - expected[i]));
+            heightError = std::max(heightError, std::fabs(batchHeights[i] - expected[i]));
+            normalError = std::max(normalError, glm::length(batchNormals[i] - scalarNormals[i]));
+        }
+        bool ok = heightError <= HEIGHT_TOLERANCE && normalError <= NORMAL_TOLERANCE;
+        failures += ok ? 0 : 1;
+
+        std::printf("%-6s per point %6.1f | batched scalar %6.1f, %s %6.1f (%4.1fx) | with normals scalar %6.1f, %s %6.1f (%4.1fx)"
+                    " | max error height %.2g, normal %.2g%s\n",
+                    heightmap.getStorageName(), perPointMs, scalarMs, batch.getPathName(), batchMs, scalarMs / batchMs,
+                    scalarNormalMs, batch.getPathName(), batchNormalMs, scalarNormalMs / batchNormalMs,
+                    heightError, normalError, ok ? "" : "  MISMATCH");
+    }
+    std::remove(path.c_str());
+
+    if (failures > 0)
+    {
+        std::cerr << "ERROR::SAMPLER_BENCHMARK::MISMATCH: " << failures << " storage types differ beyond tolerance" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file main.cpp
+ * @brief Times ChunkedTerrain::sculpt() per brush step on a generated 8193 x 8193 heightmap and
+ *        fails if a step no longer fits in a 60 FPS frame
+ * @author LuNingfang
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "Terrain/ChunkedTerrain.h"
+#include "../Common/HeightmapFixture.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const int MAP_SIZE = 8193;
+    const float TERRAIN_SIZE = 8192.0f;     // one texel per world unit
+    const float MAX_HEIGHT = 400.0f;
+    const int CHUNK_SIZE = 64;
+    const float BRUSH_RADII[] = { 8.0f, 32.0f, 128.0f };   // 128 is the largest the UI offers
+    const int STROKES = 20;
+    const int STEPS_PER_STROKE = 6;
+    const float STEP_SECONDS = 1.0f / 60.0f;
+    const double FRAME_BUDGET_MS = 1000.0 / 60.0;
+
+    struct BenchmarkConfig
+    {
+        const char* name;
+        bool quadtree;
+    };
+
+    const BenchmarkConfig CONFIGS[] =
+    {
+        { "chunks",   false },
+        { "quadtree", true  },
+    };
+
+    // Smooth hills with some finer relief, so coarse LOD errors come from more than one texel
+    float rollingHills(float u, float v, int, int)
+    {
+        return 0.45f + 0.25f * std::sin(u * 23.0f) * std::cos(v * 19.0f) + 0.05f * std::sin((u - v) * 211.0f);
+    }
+
+    // GL 4.5 core context on a window that is never shown; sculpt() uploads to the meshes
+    GLFWwindow* createHiddenContext()
+    {
+        if (!glfwInit())
+        {
+            std::cerr << "ERROR::GLFW::INIT_FAILED" << std::endl;
+            return nullptr;
+        }
+
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        GLFWwindow* window = glfwCreateWindow(64, 64, "SculptBenchmark", nullptr, nullptr);
+        if (!window)
+        {
+            std::cerr << "ERROR::GLFW::WINDOW_CREATION_FAILED" << std::endl;
+            glfwTerminate();
+            return nullptr;
+        }
+        glfwMakeContextCurrent(window);
+
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cerr << "ERROR::GLAD::INIT_FAILED" << std::endl;
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return nullptr;
+        }
+        return window;
+    }
+
+    double percentile(std::vector<double> values, double fraction)
+    {
+        std::sort(values.begin(), values.end());
+        size_t index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+        return values[index];
+    }
+
+    // Returns the number of brush radii whose p95 step exceeds the frame budget, or -1 if the
+    // terrain could not be generated
+    int runConfig(const BenchmarkConfig& config, const std::string& heightmapPath)
+    {
+        ChunkedTerrain terrain;
+        terrain.m_enableMeshCache = false;
+        terrain.m_usePackedVertices = true;     // standard vertices would need 3 GB for this map
+        terrain.m_useQuadtree = config.quadtree;
+
+        auto generateStart = std::chrono::steady_clock::now();
+        if (!terrain.generate(heightmapPath, TERRAIN_SIZE, MAX_HEIGHT, CHUNK_SIZE)) return -1;
+        double generateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - generateStart).count();
+        std::printf("%s: %d chunks, generated in %.1f s\n", config.name, terrain.getTotalChunks(), generateSeconds);
+
+        // Every brush mode, in short strokes anywhere on the map away from its edges
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> coordinate(-TERRAIN_SIZE * 0.45f, TERRAIN_SIZE * 0.45f);
+        int overBudget = 0;
+        for (float radius : BRUSH_RADII)
+        {
+            std::vector<double> stepMs;
+            long meshes = 0;
+            for (int stroke = 0; stroke < STROKES; stroke++)
+            {
+                TerrainBrush brush;
+                brush.mode = static_cast<TerrainBrushMode>(stroke % 4);
+                brush.radius = radius;
+                brush.strength = 20.0f;
+                brush.targetHeight = MAX_HEIGHT * 0.5f;
+                glm::vec3 center(coordinate(random), 0.0f, coordinate(random));
+                for (int step = 0; step < STEPS_PER_STROKE; step++)
+                {
+                    center.x += radius * 0.25f;
+                    if (!terrain.sculpt(center, brush, STEP_SECONDS)) continue;
+                    stepMs.push_back(terrain.getSculptTimeMs());
+                    meshes += terrain.getSculptedMeshes();
+                }
+            }
+
+            double p95 = percentile(stepMs, 0.95);
+            bool fits = p95 <= FRAME_BUDGET_MS;
+            overBudget += fits ? 0 : 1;
+            std::printf("  radius %5.0f: %zu steps, median %6.2f ms, p95 %6.2f ms, max %6.2f ms, %5.1f meshes/step%s\n",
+                        radius, stepMs.size(), percentile(stepMs, 0.5), p95, percentile(stepMs, 1.0),
+                        static_cast<double>(meshes) / stepMs.size(), fits ? "" : "  OVER BUDGET");
+        }
+        return overBudget;
+    }
+}
+
+int main()
+{
+    GLFWwindow* window = createHiddenContext();
+    if (!window) return EXIT_FAILURE;
+    std::printf("GL %s / %s, budget %.1f ms per step\n", glGetString(GL_VERSION), glGetString(GL_RENDERER),
+                FRAME_BUDGET_MS);
+
+    std::string path = "sculpt_benchmark_" + std::to_string(MAP_SIZE) + ".r16";
+    int overBudget = 0;
+    bool setUp = writeHeightmapFixture(path, MAP_SIZE, rollingHills);
+    if (!setUp)
+    {
+        std::cerr << "ERROR::SCULPT_BENCHMARK::FAILED_TO_WRITE: " << path << std::endl;
+    }
+    for (const BenchmarkConfig& config : CONFIGS)
+    {
+        if (!setUp) break;
+        int result = runConfig(config, path);
+        if (result < 0)
+        {
+            std::cerr << "ERROR::SCULPT_BENCHMARK::GENERATE_FAILED: " << config.name << std::endl;
+            setUp = false;
+            break;
+        }
+        overBudget += result;
+    }
+    std::remove(path.c_str());
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    if (!setUp) return EXIT_FAILURE;
+    if (overBudget > 0)
+    {
+        std::cerr << "ERROR::SCULPT_BENCHMARK::OVER_BUDGET: " << overBudget << " brush sizes above "
+                  << FRAME_BUDGET_MS << " ms per step" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}